@@ -0,0 +1,777 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <strings.h>
+#include <time.h>
+#include <pthread.h>
+#include "simulated.h"
+#include "launchpad_common.h"
+#include "uart_frame.h"
+#include "mailbox.h"
+#include "file_proxy.h"
+
+#define SIM_DEFAULT_CORES 16
+#define SIM_DEFAULT_DDR_BANKS 2
+#define SIM_DEFAULT_INSTRUCTION_MB 4
+#define SIM_DEFAULT_DATA_MB 4
+#define SIM_DEFAULT_SHARED_KB 256
+#define SIM_DEFAULT_UART_RATE 100
+#define SIM_CLOCK_FREQUENCY_MHZ 100
+// Delays shorter than this are busy waited, as sleeping is far less precise than the latencies being modelled
+#define SIM_SPIN_THRESHOLD_NS 100000
+#define SIM_LINE_SIZE 64
+#define SIM_FILE_PROXY_CHUNK 4096
+
+/**
+ * A software stand-in for an FPGA board, so the host side can be exercised and load tested without hardware. It is
+ * configured by environment variables:
+ *
+ * LP_SIM_BOARDS         number of boards, each an independent device with the configuration below (default 1)
+ * LP_SIM_CORES          number of cores on each board (default 16)
+ * LP_SIM_ARCH           shared_nothing, shared_instr, shared_data or shared_everything (default shared_nothing)
+ * LP_SIM_DDR_BANKS      number of DDR banks, cores are divided into contiguous blocks across them (default 2)
+ * LP_SIM_LOCK           global, bank or core, the lock granularity reported to launchpad (default core)
+ * LP_SIM_INSTRUCTION_MB, LP_SIM_DATA_MB, LP_SIM_SHARED_KB  memory space sizes (defaults 4MB, 4MB and 256KB)
+ * LP_SIM_LATENCY_US     latency of each memory transfer call (default 0)
+ * LP_SIM_BANDWIDTH_MBPS bandwidth of each DDR bank, transfers to the same bank queue behind each other (default 0,
+ *                       unlimited)
+ * LP_SIM_UART_LATENCY_US latency of each UART and control call (default 0)
+ * LP_SIM_UART_RATE      bytes per second of UART output generated by each running core, 0 is unlimited (default 100)
+ * LP_SIM_UART_LINES     number of lines each core prints before halting, 0 runs until stopped (default 0)
+ * LP_SIM_UART_FRAMES    send every nth line as a binary frame of type 1 holding the line number (uint64_t) rather
+ *                       than as text, 0 sends only text (default 0)
+ * LP_SIM_MAILBOX        payload bytes of a record of type 1, holding the line number (uint64_t) and then filler, that
+ *                       each core posts to its mailbox for every line it prints, 0 disables the mailbox (default 0)
+ * LP_SIM_FILE_PROXY     path of a file, relative to the -fileproxy directory, that each core copies through the file
+ *                       proxy a chunk at a time to path.b.c (b the board and c the core) when started (default none)
+ *
+ * Memory is allocated on first use, under a lock as transfer threads can touch it together, and shared memory lives
+ * in DDR bank 0. Core set writes are multicast, the data crosses each DDR bank that holds a target core once rather
+ * than once per core
+ */
+
+struct simulated_core {
+  char * instructions, * data;
+  bool running;
+  uint64_t start_time_ns, uart_bytes_read, lines_printed, mailbox_posted;
+  char line[SIM_LINE_SIZE];
+  int line_length, line_position, file_proxy_step;
+  int64_t file_proxy_in_fd, file_proxy_out_fd;
+};
+
+struct simulated_bank {
+  pthread_mutex_t mutex;
+  uint64_t free_time_ns;
+};
+
+// The state of one simulated board, every board has the same configuration
+struct simulated_board {
+  struct simulated_core * cores;
+  struct simulated_bank * banks;
+  char * shared_instructions, * shared_data;
+  int * ddr_bank_mapping;
+  uint64_t * ddr_base_addr_mapping;
+  uint64_t initialise_time_ns;
+};
+
+static struct simulated_board * boards=NULL;
+static int number_boards=0, number_cores=0, number_banks=0;
+// Each thread's calls are directed to the board that it last selected
+static _Thread_local int selected_board=0;
+// Guards the allocation of memory on first use
+static pthread_mutex_t memory_mutex=PTHREAD_MUTEX_INITIALIZER;
+static unsigned int instruction_space_mb, data_space_mb, shared_data_kb;
+static enum LP_DEVICE_ARCHITECTURE_TYPE architecture_type;
+static enum LP_DEVICE_LOCK_GRANULARITY lock_granularity;
+static char * file_proxy_path=NULL;
+static uint64_t transfer_latency_ns, uart_latency_ns, bank_bandwidth_bytes, uart_rate, uart_lines, uart_frames, mailbox_payload;
+
+static LP_STATUS_CODE simulated_initialise(void);
+static LP_STATUS_CODE simulated_finalise(void);
+static LP_STATUS_CODE simulated_reset(void);
+static LP_STATUS_CODE simulated_get_configuration(struct device_configuration*);
+static LP_STATUS_CODE simulated_get_host_board_status(struct host_board_status*);
+static LP_STATUS_CODE simulated_start_core(int);
+static LP_STATUS_CODE simulated_start_allcores(void);
+static LP_STATUS_CODE simulated_stop_core(int);
+static LP_STATUS_CODE simulated_stop_allcores(void);
+static LP_STATUS_CODE simulated_write_instructions(uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE simulated_write_data(uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE simulated_read_data(uint64_t, char*, uint64_t);
+static LP_STATUS_CODE simulated_write_core_instructions(int, uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE simulated_write_core_data(int, uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE simulated_read_core_data(int, uint64_t, char*, uint64_t);
+static LP_STATUS_CODE simulated_read_gpio(int, int, char*);
+static LP_STATUS_CODE simulated_write_gpio(int, int, char);
+static LP_STATUS_CODE simulated_uart_has_data(int, int*);
+static LP_STATUS_CODE simulated_read_uart(int, char*);
+static LP_STATUS_CODE simulated_read_uart_bulk(int, char*, unsigned int, unsigned int*);
+static LP_STATUS_CODE simulated_write_uart(int, char);
+static LP_STATUS_CODE simulated_raise_interrupt(int, int);
+static LP_STATUS_CODE simulated_get_core_running(int, int*);
+static LP_STATUS_CODE simulated_write_core_set_instructions(const uint64_t*, uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE simulated_write_core_set_data(const uint64_t*, uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE simulated_start_core_set(const uint64_t*);
+static LP_STATUS_CODE simulated_stop_core_set(const uint64_t*);
+static LP_STATUS_CODE simulated_get_number_boards(int*);
+static LP_STATUS_CODE simulated_select_board(int);
+static struct simulated_board * get_selected_board(void);
+static LP_STATUS_CODE copy_to_core_set(const uint64_t*, bool, uint64_t, const char*, uint64_t);
+static void reset_core_output(int, uint64_t);
+static void read_simulation_settings(void);
+static uint64_t get_setting(char*, uint64_t);
+static char * get_core_memory(int, bool);
+static char * get_allocated_memory(char**, uint64_t);
+static LP_STATUS_CODE copy_to_memory(char*, uint64_t, uint64_t, const char*, uint64_t, int);
+static LP_STATUS_CODE copy_from_memory(char*, uint64_t, uint64_t, char*, uint64_t, int);
+static void model_transfer(int, uint64_t);
+static uint64_t reserve_bank_bandwidth(int, uint64_t, uint64_t);
+static void wait_until(uint64_t);
+static uint64_t get_available_uart_bytes(struct simulated_core*);
+static char next_uart_byte(int);
+static int encode_uart_frame(char*, uint8_t, const char*, uint16_t);
+static char * get_mailbox_region(int);
+static bool is_shared_mailbox(void);
+static void initialise_mailbox(int);
+static void post_mailbox_records(int);
+static void run_file_proxy_program(int, bool);
+static void issue_file_request(int, uint32_t, int64_t, int32_t, uint64_t, uint64_t);
+static bool is_valid_core(int);
+static uint64_t get_time_ns(void);
+
+struct device_drivers setup_simulated_device_drivers() {
+  struct device_drivers drivers;
+  memset(&drivers, 0, sizeof(struct device_drivers));
+  drivers.device_initialise=simulated_initialise;
+  drivers.device_finalise=simulated_finalise;
+  drivers.device_reset=simulated_reset;
+  drivers.device_get_configuration=simulated_get_configuration;
+  drivers.device_get_host_board_status=simulated_get_host_board_status;
+  drivers.device_start_core=simulated_start_core;
+  drivers.device_start_allcores=simulated_start_allcores;
+  drivers.device_stop_core=simulated_stop_core;
+  drivers.device_stop_allcores=simulated_stop_allcores;
+  drivers.device_write_instructions=simulated_write_instructions;
+  drivers.device_write_data=simulated_write_data;
+  drivers.device_read_data=simulated_read_data;
+  drivers.device_write_core_instructions=simulated_write_core_instructions;
+  drivers.device_write_core_data=simulated_write_core_data;
+  drivers.device_read_core_data=simulated_read_core_data;
+  drivers.device_read_gpio=simulated_read_gpio;
+  drivers.device_write_gpio=simulated_write_gpio;
+  drivers.device_uart_has_data=simulated_uart_has_data;
+  drivers.device_read_uart=simulated_read_uart;
+  drivers.device_read_uart_bulk=simulated_read_uart_bulk;
+  drivers.device_write_uart=simulated_write_uart;
+  drivers.device_raise_interrupt=simulated_raise_interrupt;
+  drivers.device_get_core_running=simulated_get_core_running;
+  drivers.device_write_core_set_instructions=simulated_write_core_set_instructions;
+  drivers.device_write_core_set_data=simulated_write_core_set_data;
+  drivers.device_start_core_set=simulated_start_core_set;
+  drivers.device_stop_core_set=simulated_stop_core_set;
+  drivers.device_get_number_boards=simulated_get_number_boards;
+  drivers.device_select_board=simulated_select_board;
+  return drivers;
+}
+
+static LP_STATUS_CODE simulated_initialise() {
+  struct simulated_board * board=get_selected_board();
+  // Initialisation is repeated after a reset, the simulated device keeps its configuration
+  if (board->cores != NULL) return LP_SUCCESS;
+  board->initialise_time_ns=get_time_ns();
+  board->cores=(struct simulated_core*) calloc(number_cores, sizeof(struct simulated_core));
+  board->ddr_bank_mapping=(int*) malloc(sizeof(int) * number_cores);
+  board->ddr_base_addr_mapping=(uint64_t*) malloc(sizeof(uint64_t) * number_cores);
+  for (int i=0;i<number_cores;i++) {
+    board->ddr_bank_mapping[i]=(int) (((int64_t) i * number_banks) / number_cores);
+    board->ddr_base_addr_mapping[i]=(uint64_t) i * data_space_mb * 1024 * 1024;
+  }
+  board->banks=(struct simulated_bank*) malloc(sizeof(struct simulated_bank) * number_banks);
+  for (int i=0;i<number_banks;i++) {
+    pthread_mutex_init(&board->banks[i].mutex, NULL);
+    board->banks[i].free_time_ns=0;
+  }
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_finalise() {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_NOT_INITIALISED;
+  for (int i=0;i<number_cores;i++) {
+    if (board->cores[i].instructions != NULL) free(board->cores[i].instructions);
+    if (board->cores[i].data != NULL) free(board->cores[i].data);
+  }
+  free(board->cores);
+  board->cores=NULL;
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_reset() {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_SUCCESS;
+  for (int i=0;i<number_cores;i++) {
+    board->cores[i].running=false;
+    if (board->cores[i].instructions != NULL) memset(board->cores[i].instructions, 0, (uint64_t) instruction_space_mb * 1024 * 1024);
+    if (board->cores[i].data != NULL) memset(board->cores[i].data, 0, (uint64_t) data_space_mb * 1024 * 1024);
+  }
+  if (board->shared_instructions != NULL) memset(board->shared_instructions, 0, (uint64_t) instruction_space_mb * 1024 * 1024);
+  if (board->shared_data != NULL) memset(board->shared_data, 0, (uint64_t) shared_data_kb * 1024);
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_get_configuration(struct device_configuration * device_config) {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_NOT_INITIALISED;
+  device_config->device_name="Simulated";
+  device_config->cpu_name="simulated cores";
+  device_config->number_cores=number_cores;
+  device_config->clock_frequency_mhz=SIM_CLOCK_FREQUENCY_MHZ;
+  device_config->pcie_bar_ctrl_window_index=0;
+  device_config->revision=0;
+  device_config->version=1;
+  device_config->ddr_bank_mapping=board->ddr_bank_mapping;
+  device_config->ddr_base_addr_mapping=board->ddr_base_addr_mapping;
+  device_config->instruction_space_size_mb=instruction_space_mb;
+  device_config->per_core_data_space_mb=data_space_mb;
+  device_config->shared_data_space_kb=shared_data_kb;
+  device_config->architecture_type=architecture_type;
+  device_config->communication_type=LP_DEVICE_COMM_UART;
+  device_config->lock_granularity=lock_granularity;
+  return LP_SUCCESS;
+}
+
+/**
+ * Temperature and power draw rise with the number of running cores, so there is something to monitor
+ */
+static LP_STATUS_CODE simulated_get_host_board_status(struct host_board_status * board_status) {
+  struct simulated_board * board=get_selected_board();
+  int running_cores=0;
+  for (int i=0;i<number_cores;i++) {
+    if (board->cores != NULL && board->cores[i].running) running_cores++;
+  }
+  board_status->temp=35.0 + (20.0 * running_cores / (number_cores > 0 ? number_cores : 1));
+  board_status->power_draw=10.0 + (0.05 * running_cores);
+  board_status->time_alive_sec=(get_time_ns() - board->initialise_time_ns) / 1000000000;
+  board_status->num_power_cycles=1;
+  board_status->board_serial_number=selected_board;
+  board_status->board_type=LP_BOARD_UNKNOWN;
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_start_core(int core_id) {
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  wait_until(get_time_ns() + uart_latency_ns);
+  reset_core_output(core_id, get_time_ns());
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_start_allcores() {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_NOT_INITIALISED;
+  for (int i=0;i<number_cores;i++) simulated_start_core(i);
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_stop_core(int core_id) {
+  struct simulated_board * board=get_selected_board();
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  wait_until(get_time_ns() + uart_latency_ns);
+  board->cores[core_id].running=false;
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_stop_allcores() {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_NOT_INITIALISED;
+  for (int i=0;i<number_cores;i++) board->cores[i].running=false;
+  return LP_SUCCESS;
+}
+
+/**
+ * A single control transaction, so every core in the set starts at the same instant
+ */
+static LP_STATUS_CODE simulated_start_core_set(const uint64_t * core_mask) {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_NOT_INITIALISED;
+  wait_until(get_time_ns() + uart_latency_ns);
+  uint64_t start_time=get_time_ns();
+  for (int i=0;i<number_cores;i++) {
+    if (core_mask[i / 64] & (1ULL << (i % 64))) reset_core_output(i, start_time);
+  }
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_stop_core_set(const uint64_t * core_mask) {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_NOT_INITIALISED;
+  wait_until(get_time_ns() + uart_latency_ns);
+  for (int i=0;i<number_cores;i++) {
+    if (core_mask[i / 64] & (1ULL << (i % 64))) board->cores[i].running=false;
+  }
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_get_number_boards(int * boards_available) {
+  get_selected_board();
+  *boards_available=number_boards;
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_select_board(int board_id) {
+  get_selected_board();
+  if (board_id < 0 || board_id >= number_boards) return LP_ERROR;
+  selected_board=board_id;
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_write_instructions(uint64_t address, const char * data, uint64_t size) {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_NOT_INITIALISED;
+  return copy_to_memory(get_allocated_memory(&board->shared_instructions, (uint64_t) instruction_space_mb * 1024 * 1024), (uint64_t) instruction_space_mb * 1024 * 1024, address, data, size, 0);
+}
+
+static LP_STATUS_CODE simulated_write_data(uint64_t address, const char * data, uint64_t size) {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_NOT_INITIALISED;
+  return copy_to_memory(get_allocated_memory(&board->shared_data, (uint64_t) shared_data_kb * 1024), (uint64_t) shared_data_kb * 1024, address, data, size, 0);
+}
+
+static LP_STATUS_CODE simulated_read_data(uint64_t address, char * data, uint64_t size) {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_NOT_INITIALISED;
+  char * shared_data=get_allocated_memory(&board->shared_data, (uint64_t) shared_data_kb * 1024);
+  uint64_t shared_size=(uint64_t) shared_data_kb * 1024;
+  if (mailbox_payload > 0 && is_shared_mailbox() && address < shared_size && (shared_size - address) % MAILBOX_REGION_SIZE == 0) {
+    int core_id=(int) ((shared_size - address) / MAILBOX_REGION_SIZE) - 1;
+    if (core_id < number_cores) post_mailbox_records(core_id);
+  }
+  return copy_from_memory(shared_data, (uint64_t) shared_data_kb * 1024, address, data, size, 0);
+}
+
+static LP_STATUS_CODE simulated_write_core_instructions(int core_id, uint64_t address, const char * data, uint64_t size) {
+  struct simulated_board * board=get_selected_board();
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  return copy_to_memory(get_core_memory(core_id, true), (uint64_t) instruction_space_mb * 1024 * 1024, address, data, size, board->ddr_bank_mapping[core_id]);
+}
+
+static LP_STATUS_CODE simulated_write_core_data(int core_id, uint64_t address, const char * data, uint64_t size) {
+  struct simulated_board * board=get_selected_board();
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  return copy_to_memory(get_core_memory(core_id, false), (uint64_t) data_space_mb * 1024 * 1024, address, data, size, board->ddr_bank_mapping[core_id]);
+}
+
+static LP_STATUS_CODE simulated_write_core_set_instructions(const uint64_t * core_mask, uint64_t address, const char * data, uint64_t size) {
+  return copy_to_core_set(core_mask, true, address, data, size);
+}
+
+static LP_STATUS_CODE simulated_write_core_set_data(const uint64_t * core_mask, uint64_t address, const char * data, uint64_t size) {
+  return copy_to_core_set(core_mask, false, address, data, size);
+}
+
+static LP_STATUS_CODE simulated_read_core_data(int core_id, uint64_t address, char * data, uint64_t size) {
+  struct simulated_board * board=get_selected_board();
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  // The core posts whatever it has to by the time its mailbox header is read
+  if (mailbox_payload > 0 && !is_shared_mailbox() && address == (uint64_t) data_space_mb * 1024 * 1024 - MAILBOX_REGION_SIZE) post_mailbox_records(core_id);
+  return copy_from_memory(get_core_memory(core_id, false), (uint64_t) data_space_mb * 1024 * 1024, address, data, size, board->ddr_bank_mapping[core_id]);
+}
+
+static LP_STATUS_CODE simulated_read_gpio(int core_id, int pin, char * value) {
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  *value=0;
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_write_gpio(int core_id, int pin, char value) {
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_uart_has_data(int core_id, int * has_data) {
+  struct simulated_board * board=get_selected_board();
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  wait_until(get_time_ns() + uart_latency_ns);
+  *has_data=get_available_uart_bytes(&board->cores[core_id]) > 0;
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_read_uart(int core_id, char * data) {
+  struct simulated_board * board=get_selected_board();
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  wait_until(get_time_ns() + uart_latency_ns);
+  if (get_available_uart_bytes(&board->cores[core_id]) == 0) return LP_ERROR;
+  *data=next_uart_byte(core_id);
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_read_uart_bulk(int core_id, char * buffer, unsigned int max_bytes, unsigned int * bytes_read) {
+  struct simulated_board * board=get_selected_board();
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  wait_until(get_time_ns() + uart_latency_ns);
+  uint64_t available=get_available_uart_bytes(&board->cores[core_id]);
+  *bytes_read=0;
+  while (*bytes_read < max_bytes && *bytes_read < available && board->cores[core_id].running) {
+    buffer[(*bytes_read)++]=next_uart_byte(core_id);
+  }
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_write_uart(int core_id, char data) {
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  wait_until(get_time_ns() + uart_latency_ns);
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_raise_interrupt(int core_id, int interrupt_id) {
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  wait_until(get_time_ns() + uart_latency_ns);
+  // The doorbell wakes a core waiting on a full mailbox
+  if (mailbox_payload > 0 && interrupt_id == MAILBOX_DOORBELL_INTERRUPT) post_mailbox_records(core_id);
+  if (file_proxy_path != NULL && interrupt_id == FILE_PROXY_COMPLETION_INTERRUPT) run_file_proxy_program(core_id, false);
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE simulated_get_core_running(int core_id, int * running) {
+  struct simulated_board * board=get_selected_board();
+  if (!is_valid_core(core_id)) return LP_UNKNOWN_CORE;
+  *running=board->cores[core_id].running;
+  return LP_SUCCESS;
+}
+
+static void read_simulation_settings() {
+  number_boards=(int) get_setting("LP_SIM_BOARDS", 1);
+  if (number_boards < 1) number_boards=1;
+  boards=(struct simulated_board*) calloc(number_boards, sizeof(struct simulated_board));
+  number_cores=(int) get_setting("LP_SIM_CORES", SIM_DEFAULT_CORES);
+  number_banks=(int) get_setting("LP_SIM_DDR_BANKS", SIM_DEFAULT_DDR_BANKS);
+  if (number_cores < 1) number_cores=1;
+  if (number_banks < 1) number_banks=1;
+  instruction_space_mb=(unsigned int) get_setting("LP_SIM_INSTRUCTION_MB", SIM_DEFAULT_INSTRUCTION_MB);
+  data_space_mb=(unsigned int) get_setting("LP_SIM_DATA_MB", SIM_DEFAULT_DATA_MB);
+  shared_data_kb=(unsigned int) get_setting("LP_SIM_SHARED_KB", SIM_DEFAULT_SHARED_KB);
+  transfer_latency_ns=get_setting("LP_SIM_LATENCY_US", 0) * 1000;
+  bank_bandwidth_bytes=get_setting("LP_SIM_BANDWIDTH_MBPS", 0) * 1024 * 1024;
+  uart_latency_ns=get_setting("LP_SIM_UART_LATENCY_US", 0) * 1000;
+  uart_rate=get_setting("LP_SIM_UART_RATE", SIM_DEFAULT_UART_RATE);
+  uart_lines=get_setting("LP_SIM_UART_LINES", 0);
+  uart_frames=get_setting("LP_SIM_UART_FRAMES", 0);
+  mailbox_payload=get_setting("LP_SIM_MAILBOX", 0);
+  file_proxy_path=getenv("LP_SIM_FILE_PROXY");
+  if (mailbox_payload > MAILBOX_REGION_SIZE - MAILBOX_HEADER_SIZE - MAILBOX_SLOT_HEADER_SIZE) {
+    mailbox_payload=MAILBOX_REGION_SIZE - MAILBOX_HEADER_SIZE - MAILBOX_SLOT_HEADER_SIZE;
+  }
+
+  char * architecture=getenv("LP_SIM_ARCH");
+  architecture_type=LP_ARCH_TYPE_SHARED_NOTHING;
+  if (architecture != NULL && strcasecmp(architecture, "shared_instr") == 0) architecture_type=LP_ARCH_TYPE_SHARED_INSTR_ONLY;
+  if (architecture != NULL && strcasecmp(architecture, "shared_data") == 0) architecture_type=LP_ARCH_TYPE_SHARED_DATA_ONLY;
+  if (architecture != NULL && strcasecmp(architecture, "shared_everything") == 0) architecture_type=LP_ARCH_TYPE_SHARED_EVERYTHING;
+  char * lock=getenv("LP_SIM_LOCK");
+  lock_granularity=LP_LOCK_PER_CORE;
+  if (lock != NULL && strcasecmp(lock, "global") == 0) lock_granularity=LP_LOCK_GLOBAL;
+  if (lock != NULL && strcasecmp(lock, "bank") == 0) lock_granularity=LP_LOCK_PER_DDR_BANK;
+}
+
+static uint64_t get_setting(char * name, uint64_t default_value) {
+  char * value=getenv(name);
+  if (value == NULL || strlen(value) == 0) return default_value;
+  return strtoull(value, NULL, 0);
+}
+
+static char * get_core_memory(int core_id, bool instructions) {
+  struct simulated_board * board=get_selected_board();
+  if (instructions) return get_allocated_memory(&board->cores[core_id].instructions, (uint64_t) instruction_space_mb * 1024 * 1024);
+  return get_allocated_memory(&board->cores[core_id].data, (uint64_t) data_space_mb * 1024 * 1024);
+}
+
+/**
+ * Returns the memory, allocating it zeroed on first use. Transfer threads can touch the same memory for the first time
+ * together, so the allocation is made under a lock
+ */
+static char * get_allocated_memory(char ** memory, uint64_t size) {
+  pthread_mutex_lock(&memory_mutex);
+  if (*memory == NULL) *memory=(char*) calloc(size, sizeof(char));
+  char * allocated=*memory;
+  pthread_mutex_unlock(&memory_mutex);
+  return allocated;
+}
+
+static LP_STATUS_CODE copy_to_memory(char * memory, uint64_t memory_size, uint64_t address, const char * data, uint64_t size, int bank) {
+  if (memory == NULL || address + size > memory_size) return LP_ERROR;
+  model_transfer(bank, size);
+  memcpy(&memory[address], data, size);
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE copy_from_memory(char * memory, uint64_t memory_size, uint64_t address, char * data, uint64_t size, int bank) {
+  if (memory == NULL || address + size > memory_size) return LP_ERROR;
+  model_transfer(bank, size);
+  memcpy(data, &memory[address], size);
+  return LP_SUCCESS;
+}
+
+/**
+ * Each DDR bank is a channel that transfers queue on, so concurrent transfers to one bank share its bandwidth whilst
+ * transfers to different banks proceed in parallel. The per call latency is on top of this
+ */
+static void model_transfer(int bank, uint64_t size) {
+  wait_until(reserve_bank_bandwidth(bank, size, get_time_ns()) + transfer_latency_ns);
+}
+
+/**
+ * Queues the transfer behind any others on the bank, returning when it will complete
+ */
+static uint64_t reserve_bank_bandwidth(int bank, uint64_t size, uint64_t now) {
+  struct simulated_board * board=get_selected_board();
+  if (bank_bandwidth_bytes == 0) return now;
+  pthread_mutex_lock(&board->banks[bank].mutex);
+  uint64_t start_time=board->banks[bank].free_time_ns > now ? board->banks[bank].free_time_ns : now;
+  board->banks[bank].free_time_ns=start_time + ((size * 1000000000) / bank_bandwidth_bytes);
+  uint64_t completion_time=board->banks[bank].free_time_ns;
+  pthread_mutex_unlock(&board->banks[bank].mutex);
+  return completion_time;
+}
+
+/**
+ * Writes the same data to every core in the set, the transfer occupies each bank holding a target core once and the
+ * banks proceed in parallel
+ */
+static LP_STATUS_CODE copy_to_core_set(const uint64_t * core_mask, bool instructions, uint64_t address, const char * data, uint64_t size) {
+  struct simulated_board * board=get_selected_board();
+  if (board->cores == NULL) return LP_NOT_INITIALISED;
+  uint64_t memory_size=(uint64_t) (instructions ? instruction_space_mb : data_space_mb) * 1024 * 1024;
+  if (address + size > memory_size) return LP_ERROR;
+  bool bank_used[number_banks];
+  memset(bank_used, 0, sizeof(bool) * number_banks);
+  for (int i=0;i<number_cores;i++) {
+    if (core_mask[i / 64] & (1ULL << (i % 64))) bank_used[board->ddr_bank_mapping[i]]=true;
+  }
+  uint64_t now=get_time_ns(), completion_time=now;
+  for (int i=0;i<number_banks;i++) {
+    if (!bank_used[i]) continue;
+    uint64_t bank_completion=reserve_bank_bandwidth(i, size, now);
+    if (bank_completion > completion_time) completion_time=bank_completion;
+  }
+  wait_until(completion_time + transfer_latency_ns);
+  for (int i=0;i<number_cores;i++) {
+    if (core_mask[i / 64] & (1ULL << (i % 64))) memcpy(&get_core_memory(i, instructions)[address], data, size);
+  }
+  return LP_SUCCESS;
+}
+
+// Each start runs the program afresh, so the synthetic output begins again
+static void reset_core_output(int core_id, uint64_t start_time) {
+  struct simulated_board * board=get_selected_board();
+  board->cores[core_id].running=true;
+  board->cores[core_id].start_time_ns=start_time;
+  board->cores[core_id].uart_bytes_read=0;
+  board->cores[core_id].lines_printed=0;
+  board->cores[core_id].line_length=0;
+  board->cores[core_id].line_position=0;
+  if (mailbox_payload > 0) initialise_mailbox(core_id);
+  if (file_proxy_path != NULL) run_file_proxy_program(core_id, true);
+}
+
+static void wait_until(uint64_t deadline_ns) {
+  uint64_t now=get_time_ns();
+  if (deadline_ns <= now) return;
+  if (deadline_ns - now > SIM_SPIN_THRESHOLD_NS) {
+    uint64_t sleep_ns=deadline_ns - now - SIM_SPIN_THRESHOLD_NS;
+    struct timespec sleep_time={.tv_sec=sleep_ns / 1000000000, .tv_nsec=sleep_ns % 1000000000};
+    nanosleep(&sleep_time, NULL);
+  }
+  while (get_time_ns() < deadline_ns);
+}
+
+/**
+ * Output is generated at the programmed rate from when the core started, so bytes not read yet accumulate as they
+ * would in the device's UART buffer. Cores with a line limit halt once they have printed it
+ */
+static uint64_t get_available_uart_bytes(struct simulated_core * core) {
+  if (!core->running) return 0;
+  if (uart_rate == 0) return UINT64_MAX;
+  uint64_t generated=((get_time_ns() - core->start_time_ns) * uart_rate) / 1000000000;
+  return generated > core->uart_bytes_read ? generated - core->uart_bytes_read : 0;
+}
+
+static char next_uart_byte(int core_id) {
+  struct simulated_board * board=get_selected_board();
+  struct simulated_core * core=&board->cores[core_id];
+  if (core->line_position == core->line_length) {
+    if (uart_frames > 0 && core->lines_printed % uart_frames == uart_frames - 1) {
+      core->line_length=encode_uart_frame(core->line, 1, (char*) &core->lines_printed, sizeof(uint64_t));
+    } else if (number_boards > 1) {
+      core->line_length=snprintf(core->line, SIM_LINE_SIZE, "Board %d core %d line %ld\n", selected_board, core_id, core->lines_printed);
+    } else {
+      core->line_length=snprintf(core->line, SIM_LINE_SIZE, "Core %d line %ld\n", core_id, core->lines_printed);
+    }
+    core->line_position=0;
+  }
+  char value=core->line[core->line_position++];
+  core->uart_bytes_read++;
+  if (core->line_position == core->line_length) {
+    core->lines_printed++;
+    if (uart_lines > 0 && core->lines_printed >= uart_lines) core->running=false;
+  }
+  return value;
+}
+
+/**
+ * Encodes a frame as the core side would, returning its length on the wire
+ */
+static int encode_uart_frame(char * target, uint8_t type, const char * payload, uint16_t payload_length) {
+  target[0]=(char) UART_FRAME_SYNC_0;
+  target[1]=(char) UART_FRAME_SYNC_1;
+  target[2]=(char) type;
+  target[3]=(char) (payload_length & 0xff);
+  target[4]=(char) (payload_length >> 8);
+  memcpy(&target[UART_FRAME_HEADER_SIZE], payload, payload_length);
+  unsigned int sum1=0, sum2=0;
+  for (int i=2;i<UART_FRAME_HEADER_SIZE + payload_length;i++) {
+    sum1=(sum1 + (unsigned char) target[i]) % 255;
+    sum2=(sum2 + sum1) % 255;
+  }
+  target[UART_FRAME_HEADER_SIZE + payload_length]=(char) sum1;
+  target[UART_FRAME_HEADER_SIZE + payload_length + 1]=(char) sum2;
+  return UART_FRAME_HEADER_SIZE + payload_length + UART_FRAME_CHECKSUM_SIZE;
+}
+
+/**
+ * The mailbox is at the top of the core's data space, or of the shared data space on shared data architectures, NULL
+ * if the space is too small to hold it
+ */
+static char * get_mailbox_region(int core_id) {
+  struct simulated_board * board=get_selected_board();
+  if (is_shared_mailbox()) {
+    uint64_t shared_size=(uint64_t) shared_data_kb * 1024;
+    if ((uint64_t) (core_id + 1) * MAILBOX_REGION_SIZE > shared_size) return NULL;
+    return &get_allocated_memory(&board->shared_data, shared_size)[shared_size - ((uint64_t) (core_id + 1) * MAILBOX_REGION_SIZE)];
+  }
+  uint64_t data_size=(uint64_t) data_space_mb * 1024 * 1024;
+  if (data_size < MAILBOX_REGION_SIZE) return NULL;
+  return &get_core_memory(core_id, false)[data_size - MAILBOX_REGION_SIZE];
+}
+
+static bool is_shared_mailbox() {
+  return architecture_type == LP_ARCH_TYPE_SHARED_DATA_ONLY || architecture_type == LP_ARCH_TYPE_SHARED_EVERYTHING;
+}
+
+// Set up as the core's program would on starting
+static void initialise_mailbox(int core_id) {
+  get_selected_board()->cores[core_id].mailbox_posted=0;
+  char * region=get_mailbox_region(core_id);
+  if (region == NULL) return;
+  struct mailbox_header header;
+  memset(&header, 0, sizeof(struct mailbox_header));
+  header.magic=MAILBOX_MAGIC;
+  header.slot_size=(uint32_t) (((MAILBOX_SLOT_HEADER_SIZE + mailbox_payload + 7) / 8) * 8);
+  header.number_slots=(MAILBOX_REGION_SIZE - MAILBOX_HEADER_SIZE) / header.slot_size;
+  memcpy(region, &header, sizeof(struct mailbox_header));
+}
+
+/**
+ * Posts a record for each line printed since the last post, for as long as the ring has free slots
+ */
+static void post_mailbox_records(int core_id) {
+  struct simulated_core * core=&get_selected_board()->cores[core_id];
+  char * region=get_mailbox_region(core_id);
+  if (region == NULL) return;
+  struct mailbox_header * header=(struct mailbox_header*) region;
+  if (header->magic != MAILBOX_MAGIC) return;
+  while (core->mailbox_posted < core->lines_printed && header->head - header->tail < header->number_slots) {
+    char * slot=&region[MAILBOX_HEADER_SIZE + ((header->head % header->number_slots) * header->slot_size)];
+    uint32_t type=1, length=(uint32_t) mailbox_payload;
+    memcpy(slot, &type, sizeof(uint32_t));
+    memcpy(&slot[sizeof(uint32_t)], &length, sizeof(uint32_t));
+    for (uint32_t i=0;i<length;i++) slot[MAILBOX_SLOT_HEADER_SIZE + i]=(char) i;
+    memcpy(&slot[MAILBOX_SLOT_HEADER_SIZE], &core->mailbox_posted, length < sizeof(uint64_t) ? length : sizeof(uint64_t));
+    core->mailbox_posted++;
+    header->head++;
+  }
+}
+
+/**
+ * The program that each core runs with LP_SIM_FILE_PROXY, copying the file through the file proxy a chunk at a time.
+ * It is started with the core and then takes a step on each completion interrupt, each step taking the result of the
+ * last request and making the next
+ */
+static void run_file_proxy_program(int core_id, bool starting) {
+  struct simulated_core * core=&get_selected_board()->cores[core_id];
+  uint64_t data_size=(uint64_t) data_space_mb * 1024 * 1024;
+  if (data_size < MAILBOX_REGION_SIZE + FILE_PROXY_REQUEST_SIZE + SIM_FILE_PROXY_CHUNK + FILE_PROXY_MAX_PATH) return;
+  uint64_t request_address=data_size - MAILBOX_REGION_SIZE - FILE_PROXY_REQUEST_SIZE;
+  uint64_t buffer_address=request_address - SIM_FILE_PROXY_CHUNK, path_address=buffer_address - FILE_PROXY_MAX_PATH;
+  char * memory=get_core_memory(core_id, false);
+  struct file_proxy_request * request=(struct file_proxy_request*) &memory[request_address];
+  if (starting) {
+    core->file_proxy_step=0;
+  } else if (request->magic != FILE_PROXY_MAGIC || request->state != FILE_PROXY_COMPLETED) {
+    return;
+  }
+  int64_t result=request->result;
+  int path_length;
+  switch (core->file_proxy_step++) {
+    case 0:
+      path_length=snprintf(&memory[path_address], FILE_PROXY_MAX_PATH, "%s", file_proxy_path);
+      issue_file_request(core_id, FILE_PROXY_OPEN, 0, FILE_PROXY_OPEN_READ, path_address, path_length);
+      break;
+    case 1:
+      core->file_proxy_in_fd=result;
+      if (result < 0) break;
+      path_length=snprintf(&memory[path_address], FILE_PROXY_MAX_PATH, "%s.%d.%d", file_proxy_path, selected_board, core_id);
+      issue_file_request(core_id, FILE_PROXY_OPEN, 0, FILE_PROXY_OPEN_WRITE | FILE_PROXY_OPEN_CREATE | FILE_PROXY_OPEN_TRUNCATE, path_address, path_length);
+      break;
+    case 2:
+      core->file_proxy_out_fd=result;
+      if (result < 0) break;
+      issue_file_request(core_id, FILE_PROXY_READ, core->file_proxy_in_fd, 0, buffer_address, SIM_FILE_PROXY_CHUNK);
+      break;
+    case 3:
+      if (result > 0) {
+        issue_file_request(core_id, FILE_PROXY_WRITE, core->file_proxy_out_fd, 0, buffer_address, result);
+      } else {
+        core->file_proxy_step=5;
+        issue_file_request(core_id, FILE_PROXY_CLOSE, core->file_proxy_in_fd, 0, 0, 0);
+      }
+      break;
+    case 4:
+      core->file_proxy_step=3;
+      issue_file_request(core_id, FILE_PROXY_READ, core->file_proxy_in_fd, 0, buffer_address, SIM_FILE_PROXY_CHUNK);
+      break;
+    case 5:
+      issue_file_request(core_id, FILE_PROXY_CLOSE, core->file_proxy_out_fd, 0, 0, 0);
+      break;
+  }
+}
+
+static void issue_file_request(int core_id, uint32_t operation, int64_t fd, int32_t flags, uint64_t buffer_address, uint64_t length) {
+  uint64_t request_address=(uint64_t) data_space_mb * 1024 * 1024 - MAILBOX_REGION_SIZE - FILE_PROXY_REQUEST_SIZE;
+  struct file_proxy_request request;
+  memset(&request, 0, sizeof(struct file_proxy_request));
+  request.magic=FILE_PROXY_MAGIC;
+  request.operation=operation;
+  request.fd=(int32_t) fd;
+  request.flags=flags;
+  request.buffer_address=buffer_address;
+  request.length=length;
+  request.state=FILE_PROXY_REQUESTED;
+  memcpy(&get_core_memory(core_id, false)[request_address], &request, sizeof(struct file_proxy_request));
+}
+
+// Settings are read on first use, which is before launchpad starts any other threads
+static struct simulated_board * get_selected_board() {
+  if (boards == NULL) read_simulation_settings();
+  return &boards[selected_board];
+}
+
+static bool is_valid_core(int core_id) {
+  struct simulated_board * board=get_selected_board();
+  return board->cores != NULL && core_id >= 0 && core_id < number_cores;
+}
+
+static uint64_t get_time_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t) now.tv_sec * 1000000000) + now.tv_nsec;
+}
@@ -0,0 +1,8 @@
+#ifndef SIMULATED_H_
+#define SIMULATED_H_
+
+#include "launchpad_common.h"
+
+struct device_drivers setup_simulated_device_drivers(void);
+
+#endif
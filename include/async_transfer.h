@@ -0,0 +1,26 @@
+#ifndef ASYNC_TRANSFER_H_
+#define ASYNC_TRANSFER_H_
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "launchpad_common.h"
+
+struct completed_transfer;
+
+// Collects the completions of the transfers submitted against it, each user of asynchronous transfers has its own
+struct transfer_queue {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  struct completed_transfer * head, * tail;
+  int outstanding;
+};
+
+void initialise_async_transfers(struct device_configuration*, struct device_drivers*, int);
+void initialise_transfer_queue(struct transfer_queue*);
+void destroy_transfer_queue(struct transfer_queue*);
+void submit_transfer(struct transfer_queue*, struct device_transfer_request*);
+bool poll_transfer(struct transfer_queue*, struct device_transfer_completion*);
+void wait_transfer(struct transfer_queue*, struct device_transfer_completion*);
+void wait_all_transfers(struct transfer_queue*);
+
+#endif
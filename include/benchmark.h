@@ -0,0 +1,11 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "launchpad_common.h"
+#include "configuration.h"
+
+#define DEFAULT_BENCHMARK_ITERATIONS 100
+
+int run_transfer_benchmark(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef BOARD_H_
+#define BOARD_H_
+
+#include "launchpad_common.h"
+
+// Large enough for a core described as board.core
+#define BOARD_CORE_NAME_SIZE 24
+
+struct device_drivers setup_board_drivers(struct device_drivers);
+void initialise_board_cores(struct device_configuration*);
+int get_number_boards(void);
+int get_core_board(int);
+int get_board_first_core(int);
+int get_board_number_cores(int);
+int resolve_board_core(int, int);
+void describe_core(int, char*);
+
+#endif
@@ -3,19 +3,48 @@
 
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include "core_set.h"
 
 #define VERSION_IDENT "0.1"
-#define MAX_NUM_CORES 128
+#define DEFAULT_POLL_RATE_HZ 1000
+#define DEFAULT_POLL_SPIN_SWEEPS 100
+#define DEFAULT_POLL_THREADS 1
+#define DEFAULT_UART_BUFFER_KB 64
+#define DEFAULT_RENDER_FPS 30
+#define DEFAULT_SCROLLBACK_KB 64
+#define DEFAULT_TRANSFER_THREADS 4
+#define DEFAULT_TELEMETRY_HZ 10
 
 struct launchpad_configuration {
   char * executable_filename;
-  bool active_cores[MAX_NUM_CORES];
-  bool all_cores_active, reset, display_config;
+  char * active_cores_spec;
+  struct core_set active_cores;
+  bool reset, display_config, batch_mode, upload_cache, benchmark_mode;
+  unsigned int poll_rate_hz, poll_spin_sweeps;
+  int poll_threads, poll_pin_cpu, transfer_threads;
+  unsigned int uart_buffer_kb, render_fps, telemetry_hz, scrollback_kb;
+  bool tile_view;
+  char * batch_output_dir, * batch_sentinel;
+  unsigned int batch_timeout_sec;
+  uint64_t data_base_address;
+  unsigned int benchmark_iterations;
+  char ** dataset_specs;
+  bool * dataset_sharded;
+  int num_datasets;
+  char * daemon_socket, * connect_socket;
+  char ** client_commands;
+  int num_client_commands;
+  char ** job_specs;
+  int num_jobs;
+  char * telemetry_csv;
+  char * capture_dir, * capture_dump_spec;
+  char * frames_dir, * mailbox_dir, * file_proxy_dir;
 };
 
 struct launchpad_configuration* readConfiguration(int, char*[]);
-void parseCoreActiveInfo(struct launchpad_configuration*, char*);
-void parseCoreInfoString(char*, bool*, int);
+bool parseCoreActiveInfo(struct launchpad_configuration*, char*);
+bool parseCoreInfoString(char*, struct core_set*);
 
 #endif
@@ -0,0 +1,30 @@
+#ifndef CORE_SET_H_
+#define CORE_SET_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Cores packed 64 to a word, the words have the same layout as the core masks passed to the device drivers
+struct core_set {
+  uint64_t * words;
+  int number_cores, num_words;
+};
+
+void initialise_core_set(struct core_set*, int);
+void view_core_mask_as_set(struct core_set*, const uint64_t*, int);
+void free_core_set(struct core_set*);
+void copy_core_set(struct core_set*, struct core_set*);
+void clear_core_set(struct core_set*);
+void fill_core_set(struct core_set*);
+void add_core_to_set(struct core_set*, int);
+void remove_core_from_set(struct core_set*, int);
+bool is_core_in_set(struct core_set*, int);
+bool are_core_sets_equal(struct core_set*, struct core_set*);
+int count_cores_in_set(struct core_set*);
+int next_core_in_set(struct core_set*, int);
+int get_cores_in_set(struct core_set*, int*);
+void union_core_sets(struct core_set*, struct core_set*);
+void intersect_core_sets(struct core_set*, struct core_set*);
+void subtract_core_sets(struct core_set*, struct core_set*);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef CORE_SWEEPER_H_
+#define CORE_SWEEPER_H_
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "core_set.h"
+
+// Visits the sweeper's cores, which are set to the polled cores, and returns whether there was anything to do there
+struct core_sweeper;
+typedef bool (*core_sweep)(struct core_sweeper*);
+
+// A background thread sweeping the polled cores, such as for the mailboxes or file requests they post in device memory
+struct core_sweeper {
+  struct launchpad_configuration * config;
+  // A copy, as the sweeper's thread may still be running whilst launchpad exits
+  struct device_drivers drivers;
+  struct core_set cores;
+  unsigned int min_interval_us, max_interval_us;
+  core_sweep sweep;
+  bool in_background;
+  pthread_mutex_t mutex;
+};
+
+void initialise_core_sweeper(struct core_sweeper*, struct launchpad_configuration*, struct device_configuration*, struct device_drivers*);
+void start_core_sweeper(struct core_sweeper*, unsigned int, unsigned int, core_sweep, char*);
+bool run_core_sweep(struct core_sweeper*);
+bool continue_core_sweep(struct core_sweeper*);
+void lock_core_sweeper(struct core_sweeper*);
+void unlock_core_sweeper(struct core_sweeper*);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef COUNTER_H_
+#define COUNTER_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// For statistics counters with a single writer that other threads read. A relaxed load and store avoids the locked
+// instruction of an atomic add, which only matters where more than one thread writes
+static inline void add_to_counter(_Atomic uint64_t * counter, uint64_t amount) {
+  atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+#endif
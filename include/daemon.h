@@ -0,0 +1,15 @@
+#ifndef DAEMON_H_
+#define DAEMON_H_
+
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "util.h"
+
+#define DAEMON_COMMAND_SIZE 4096
+#define DAEMON_MESSAGE_SIZE 1024
+#define DAEMON_MAX_READ_BYTES 1048576
+
+int run_daemon(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, struct current_device_status*);
+int run_daemon_client(struct launchpad_configuration*);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef DATASET_H_
+#define DATASET_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+
+#define DATASET_MESSAGE_SIZE 512
+
+bool add_dataset(struct device_configuration*, char*, bool, char*);
+void clear_datasets(void);
+int get_number_datasets(void);
+size_t get_datasets_description_size(void);
+void describe_datasets(char*, size_t);
+bool stage_datasets(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, char*);
+
+#endif
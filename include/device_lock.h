@@ -0,0 +1,19 @@
+#ifndef DEVICE_LOCK_H_
+#define DEVICE_LOCK_H_
+
+#include <stdint.h>
+#include "launchpad_common.h"
+
+void initialise_device_locks(struct device_configuration*);
+int get_core_lock_domain(int);
+int get_number_lock_domains(void);
+void lock_device_core(int);
+void unlock_device_core(int);
+void lock_device(void);
+void unlock_device(void);
+void lock_device_board_status(void);
+void unlock_device_board_status(void);
+void lock_device_core_set(const uint64_t*);
+void unlock_device_core_set(const uint64_t*);
+
+#endif
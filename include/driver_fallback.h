@@ -0,0 +1,14 @@
+#ifndef DRIVER_FALLBACK_H_
+#define DRIVER_FALLBACK_H_
+
+#include "launchpad_common.h"
+
+#include <stdbool.h>
+
+LP_STATUS_CODE driver_read_uart_bulk(struct device_drivers*, int, char*, unsigned int, unsigned int*);
+LP_STATUS_CODE driver_write_core_set_instructions(struct device_drivers*, const uint64_t*, int, uint64_t, const char*, uint64_t);
+LP_STATUS_CODE driver_write_core_set_data(struct device_drivers*, const uint64_t*, int, uint64_t, const char*, uint64_t);
+LP_STATUS_CODE driver_start_core_set(struct device_drivers*, const uint64_t*, int);
+LP_STATUS_CODE driver_stop_core_set(struct device_drivers*, const uint64_t*, int);
+
+#endif
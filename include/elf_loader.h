@@ -0,0 +1,12 @@
+#ifndef ELF_LOADER_H_
+#define ELF_LOADER_H_
+
+#include <stdbool.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "loader.h"
+
+bool is_elf_file(struct load_stream*);
+void transfer_elf_to_device(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, struct load_stream*, int*, int);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef FILE_PROXY_H_
+#define FILE_PROXY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "mailbox.h"
+#include "core_set.h"
+
+/**
+ * Each core's file request block sits at the top of its data space just below its mailbox. The core fills in a
+ * request, with any path or data in its own data space at buffer_address, and sets state to FILE_PROXY_REQUESTED.
+ * The host serves it and writes back result (bytes transferred, the file descriptor or offset, or -errno on failure)
+ * together with state set to FILE_PROXY_COMPLETED, then raises FILE_PROXY_COMPLETION_INTERRUPT on the core
+ */
+#define FILE_PROXY_MAGIC 0x4f49504c
+#define FILE_PROXY_REQUEST_SIZE 64
+#define FILE_PROXY_COMPLETION_INTERRUPT 2
+#define FILE_PROXY_MAX_FILES 16
+#define FILE_PROXY_MAX_TRANSFER (1024 * 1024)
+#define FILE_PROXY_MAX_PATH 1024
+#define FILE_PROXY_POLL_INTERVAL_US 200
+#define FILE_PROXY_MAX_POLL_INTERVAL_US 10000
+#define FILE_PROXY_MESSAGE_SIZE 256
+
+#define FILE_PROXY_IDLE 0
+#define FILE_PROXY_REQUESTED 1
+#define FILE_PROXY_COMPLETED 2
+
+enum file_proxy_operation {FILE_PROXY_OPEN=1, FILE_PROXY_READ, FILE_PROXY_WRITE, FILE_PROXY_LSEEK, FILE_PROXY_CLOSE};
+
+// Flags of an open, the core's own values so they do not depend on the host
+#define FILE_PROXY_OPEN_READ 1
+#define FILE_PROXY_OPEN_WRITE 2
+#define FILE_PROXY_OPEN_CREATE 4
+#define FILE_PROXY_OPEN_TRUNCATE 8
+#define FILE_PROXY_OPEN_APPEND 16
+
+// Whence of a seek
+#define FILE_PROXY_SEEK_SET 0
+#define FILE_PROXY_SEEK_CUR 1
+#define FILE_PROXY_SEEK_END 2
+
+struct file_proxy_request {
+  uint32_t magic, operation;
+  int32_t fd, flags;
+  int64_t offset;
+  uint64_t buffer_address, length;
+  int64_t result;
+  uint32_t state, reserved;
+  char padding[FILE_PROXY_REQUEST_SIZE - 56];
+};
+
+void start_file_proxy(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*);
+bool is_file_proxy_enabled(void);
+void describe_file_proxy(char*);
+void close_file_proxy_files(struct core_set*);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef JOB_QUEUE_H_
+#define JOB_QUEUE_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+
+#define JOB_MESSAGE_SIZE 512
+
+void initialise_job_queue(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*);
+bool submit_job(char*, char*);
+bool is_job_queue_busy(void);
+int wait_for_jobs(void);
+void describe_jobs(FILE*);
+int run_job_batch(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*);
+
+#endif
@@ -13,9 +13,34 @@
 #define LP_NOT_IMPLEMENTED 5
 #define LP_UNKNOWN_CORE 6
 
+// Number of 64 bit words in a core mask, where core n is bit n%64 of word n/64
+#define LP_CORE_MASK_WORDS(number_cores) (((number_cores) + 63) / 64)
+
 enum LP_DEVICE_ARCHITECTURE_TYPE {LP_ARCH_TYPE_SHARED_NOTHING, LP_ARCH_TYPE_SHARED_INSTR_ONLY, LP_ARCH_TYPE_SHARED_DATA_ONLY, LP_ARCH_TYPE_SHARED_EVERYTHING};
 enum LP_HOST_BOARD_TYPE {LP_PA100, LP_PA101, LP_BOARD_UNKNOWN};
 enum LP_DEVICE_COMM_TYPE {LP_DEVICE_COMM_UART};
+// Granularity at which the backend allows concurrent access, defaults to global (a single lock for the whole device). A
+// backend that declares per DDR bank or per core access must also allow device_get_host_board_status to be called
+// concurrently with any other call, as the board status is sampled in the background whilst the cores are in use
+enum LP_DEVICE_LOCK_GRANULARITY {LP_LOCK_GLOBAL, LP_LOCK_PER_DDR_BANK, LP_LOCK_PER_CORE};
+
+enum LP_TRANSFER_TYPE {LP_TRANSFER_WRITE_INSTRUCTIONS, LP_TRANSFER_WRITE_DATA, LP_TRANSFER_READ_DATA, LP_TRANSFER_WRITE_CORE_INSTRUCTIONS,
+  LP_TRANSFER_WRITE_CORE_DATA, LP_TRANSFER_READ_CORE_DATA, LP_TRANSFER_WRITE_CORE_SET_INSTRUCTIONS, LP_TRANSFER_WRITE_CORE_SET_DATA};
+
+// A memory transfer submitted asynchronously, equivalent to the blocking call of the same type (core_id is ignored for shared
+// spaces and core_mask is only used for core set writes)
+struct device_transfer_request {
+  enum LP_TRANSFER_TYPE type;
+  int core_id;
+  const uint64_t * core_mask;
+  uint64_t address, size, tag;
+  char * buffer;
+};
+
+struct device_transfer_completion {
+  uint64_t tag;
+  LP_STATUS_CODE status;
+};
 
 struct host_board_status {
   float temp, power_draw;
@@ -33,8 +58,13 @@ struct device_configuration {
   unsigned int instruction_space_size_mb, per_core_data_space_mb, shared_data_space_kb;
   enum LP_DEVICE_ARCHITECTURE_TYPE architecture_type;
   enum LP_DEVICE_COMM_TYPE communication_type;
+  enum LP_DEVICE_LOCK_GRANULARITY lock_granularity;
 };
 
+/**
+ * The calls a backend provides, returned by its setup function. Backends must zero the structure before filling it in,
+ * as calls marked optional are only made when not NULL and any call or field added later is then left NULL
+ */
 struct device_drivers {
   LP_STATUS_CODE (*device_initialise)();
   LP_STATUS_CODE (*device_finalise)();
@@ -59,8 +89,28 @@ struct device_drivers {
   LP_STATUS_CODE (*device_write_gpio)(int, int, char);
   LP_STATUS_CODE (*device_uart_has_data)(int, int*);
   LP_STATUS_CODE (*device_read_uart)(int, char*);
+  // Optional, reads up to the provided number of bytes from a core's UART and sets how many were read; may be NULL
+  LP_STATUS_CODE (*device_read_uart_bulk)(int, char*, unsigned int, unsigned int*);
   LP_STATUS_CODE (*device_write_uart)(int, char);
   LP_STATUS_CODE (*device_raise_interrupt)(int, int);
+  // Optional, registers a handler that the backend calls with the core id when UART data becomes available; may be NULL
+  LP_STATUS_CODE (*device_set_uart_event_handler)(void (*)(int));
+  // Optional, sets whether a core is still running (i.e. has not halted or been stopped); may be NULL
+  LP_STATUS_CODE (*device_get_core_running)(int, int*);
+  // Optional, writes the same contents to the memory of every core in the mask with a single multicast transfer; may be NULL
+  LP_STATUS_CODE (*device_write_core_set_instructions)(const uint64_t*, uint64_t, const char*, uint64_t);
+  LP_STATUS_CODE (*device_write_core_set_data)(const uint64_t*, uint64_t, const char*, uint64_t);
+  // Optional, starts or stops every core in the mask at the same time; may be NULL
+  LP_STATUS_CODE (*device_start_core_set)(const uint64_t*);
+  LP_STATUS_CODE (*device_stop_core_set)(const uint64_t*);
+  // Optional, queues a memory transfer and returns without waiting for it, the buffer must remain valid until it completes; may be NULL
+  LP_STATUS_CODE (*device_submit_transfer)(struct device_transfer_request*);
+  // Optional, blocks until a submitted transfer completes and sets its tag and status; may be NULL
+  LP_STATUS_CODE (*device_wait_transfer_completion)(struct device_transfer_completion*);
+  // Optional, sets the number of boards that the backend drives; may be NULL for a single board
+  LP_STATUS_CODE (*device_get_number_boards)(int*);
+  // Optional, directs every subsequent call made by the calling thread to the board; may be NULL for a single board
+  LP_STATUS_CODE (*device_select_board)(int);
 };
 
 #endif
@@ -0,0 +1,40 @@
+#ifndef LOADER_H_
+#define LOADER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "launchpad_common.h"
+
+#define LOAD_CHUNK_SIZE 1048576
+
+enum load_target_space {LOAD_CORE_INSTRUCTIONS, LOAD_CORE_DATA, LOAD_SHARED_INSTRUCTIONS, LOAD_SHARED_DATA};
+
+// A contiguous range of a file (or zeros if there is no file handle) to be written to the same address of one or more
+// target memory spaces, read only if the cores will never write to it once loaded
+struct load_stream {
+  int file_handle;
+  char * filename;
+  uint64_t file_offset, length, device_address;
+  bool read_only;
+  enum load_target_space space;
+  int * cores;
+  int num_cores;
+};
+
+// Accumulated timings of each phase of the transfers since the statistics were last reset, bytes requested less those
+// written were skipped by the upload cache as the device already held them
+struct load_statistics {
+  uint64_t bytes_read, bytes_requested, bytes_written;
+  double read_seconds, shared_write_seconds, multicast_write_seconds, total_seconds;
+  double * bank_write_seconds;
+  int num_banks;
+};
+
+void set_load_stream_target(struct load_stream*, struct device_configuration*, bool, int*, int);
+void stream_to_device(struct device_configuration*, struct device_drivers*, struct load_stream*);
+void streams_to_device(struct device_configuration*, struct device_drivers*, struct load_stream*, int);
+void reset_load_statistics(void);
+struct load_statistics * get_load_statistics(void);
+void describe_load_statistics(char*);
+
+#endif
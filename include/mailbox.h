@@ -0,0 +1,36 @@
+#ifndef MAILBOX_H_
+#define MAILBOX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+
+/**
+ * Layout of a core's mailbox, a region of MAILBOX_REGION_SIZE bytes at the top of the core's data space or, on
+ * architectures with shared data, core n's region is the (n+1)th from the top of the shared data space. The region
+ * starts with the header, which the core initialises, followed by number_slots slots of slot_size bytes. The core posts
+ * a record into slot head % number_slots then increments head, waiting whilst head - tail == number_slots. The host
+ * drains slots from tail up to head, writes the new tail back and raises MAILBOX_DOORBELL_INTERRUPT on the core
+ */
+#define MAILBOX_MAGIC 0x424d504c
+#define MAILBOX_REGION_SIZE 16384
+#define MAILBOX_HEADER_SIZE 64
+// Each slot starts with the record's type and payload length, as uint32_t
+#define MAILBOX_SLOT_HEADER_SIZE 8
+#define MAILBOX_DOORBELL_INTERRUPT 1
+#define MAILBOX_POLL_INTERVAL_MS 10
+#define MAILBOX_MESSAGE_SIZE 256
+
+struct mailbox_header {
+  uint32_t magic, number_slots, slot_size, reserved;
+  uint64_t head, tail;
+  char padding[MAILBOX_HEADER_SIZE - 32];
+};
+
+void start_mailbox_drain(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*);
+bool is_mailbox_enabled(void);
+void drain_mailboxes(void);
+void describe_mailboxes(char*);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef RECORD_WRITER_H_
+#define RECORD_WRITER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "uart_ring.h"
+
+#define RECORD_WRITER_MAX_WRITERS 4
+
+// Moves the records held in the writer's rings to their files, writing out everything held if asked to flush (as on
+// exit), and returns whether any records were moved
+struct record_writer;
+typedef bool (*record_drain)(struct record_writer*, bool);
+
+// A ring of records per core, pushed by the poller owning the core and drained by a background thread
+struct record_writer {
+  struct uart_ring * rings;
+  int number_rings;
+  unsigned int interval_ms;
+  record_drain drain;
+  pthread_mutex_t mutex;
+  // The thread holding the lock to drain, so that a drain exiting on an error is not flushed again by that thread
+  pthread_t drain_thread;
+  _Atomic bool draining;
+};
+
+void prepare_record_directory(char*, char*);
+void initialise_record_writer(struct record_writer*, int, uint64_t);
+void start_record_writer(struct record_writer*, unsigned int, record_drain, char*);
+bool push_record(struct record_writer*, int, const char*, unsigned int, const char*, unsigned int);
+uint64_t get_record_dropped_bytes(struct record_writer*, int);
+
+#endif
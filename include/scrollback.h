@@ -0,0 +1,18 @@
+#ifndef SCROLLBACK_H_
+#define SCROLLBACK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A core's most recent output held in a fixed size arena, the oldest whole lines are evicted to make room for new output
+struct scrollback {
+  char * buffer;
+  uint64_t capacity, start, length, total_lines;
+};
+
+void initialise_scrollback(struct scrollback*, uint64_t);
+void append_scrollback(struct scrollback*, const char*, uint64_t);
+uint64_t find_scrollback_line(struct scrollback*, uint64_t);
+bool read_scrollback_line(struct scrollback*, uint64_t*, char*, unsigned int);
+
+#endif
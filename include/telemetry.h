@@ -0,0 +1,30 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdbool.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+
+#define TELEMETRY_RING_SAMPLES 8192
+#define TELEMETRY_MESSAGE_SIZE 256
+
+struct telemetry_sample {
+  double time_sec;
+  float temp, power_draw;
+  bool in_run;
+};
+
+// The run in progress, or otherwise the last run, that board power has been integrated over
+struct energy_summary {
+  bool sampled, run_active;
+  double run_seconds, energy_joules, average_power, peak_temp;
+};
+
+void start_telemetry_sampler(struct launchpad_configuration*, struct device_drivers*);
+void begin_energy_run(void);
+void end_energy_run(void);
+void get_energy_summary(struct energy_summary*);
+void describe_energy(char*);
+bool export_telemetry_csv(char*, char*);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef UART_CAPTURE_H_
+#define UART_CAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+
+#define CAPTURE_BLOCK_SIZE 65536
+#define CAPTURE_RECORD_HEADER_SIZE 12
+#define CAPTURE_MAX_ENCODED_HEADER_SIZE 15
+#define CAPTURE_BLOCK_HEADER_SIZE 8
+#define CAPTURE_FLUSH_INTERVAL_MS 1000
+#define CAPTURE_WRITER_INTERVAL_MS 50
+#define CAPTURE_LINE_SIZE 2048
+
+// An entry of a core's index file, one per compressed block of its log file
+struct capture_index_entry {
+  uint64_t first_timestamp_ns, last_timestamp_ns, file_offset;
+  uint32_t compressed_length, raw_length;
+};
+
+void start_uart_capture(struct launchpad_configuration*, struct device_configuration*);
+bool is_uart_capture_enabled(void);
+void capture_uart_data(int, const char*, unsigned int, struct timespec*);
+uint64_t get_capture_dropped_bytes(int);
+int dump_uart_capture(struct launchpad_configuration*);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef UART_FRAME_H_
+#define UART_FRAME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+
+/**
+ * Wire format of a binary frame sent by a core over its UART, interleaved with its text output:
+ *
+ *   sync (0xFE 0xA5) | type (1 byte) | payload length (2 bytes, little endian) | payload | checksum (2 bytes, little endian)
+ *
+ * The checksum is the 16 bit Fletcher checksum (sum1 in the low byte, sum2 in the high byte) of the type, length and
+ * payload bytes. 0xFE never appears in ASCII or UTF-8 text, so text passes through the decoder unchanged
+ */
+#define UART_FRAME_SYNC_0 0xFE
+#define UART_FRAME_SYNC_1 0xA5
+#define UART_FRAME_HEADER_SIZE 5
+#define UART_FRAME_CHECKSUM_SIZE 2
+#define UART_FRAME_MAX_PAYLOAD 4096
+// A decoded frame as held in the stream files: timestamp (8 bytes), type (1 byte) and payload length (2 bytes)
+#define UART_FRAME_RECORD_HEADER_SIZE 11
+#define UART_FRAME_WRITER_INTERVAL_MS 50
+
+// Called on the poller thread with each decoded frame, so it must be quick and must not block
+typedef void (*uart_frame_consumer)(int, uint8_t, const char*, unsigned int, uint64_t);
+
+void set_uart_frame_consumer(uart_frame_consumer);
+void start_uart_frame_decoding(struct launchpad_configuration*, struct device_configuration*);
+bool is_uart_frame_decoding_enabled(void);
+unsigned int decode_uart_frames(int, const char*, unsigned int, char*, struct timespec*);
+void get_uart_frame_statistics(int, uint64_t*, uint64_t*, uint64_t*);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef UART_HEADLESS_H_
+#define UART_HEADLESS_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "util.h"
+
+#define LP_BATCH_EXIT_COMPLETE 0
+#define LP_BATCH_EXIT_ERROR 1
+#define LP_BATCH_EXIT_TIMEOUT 2
+#define LP_BATCH_EXIT_INTERRUPTED 3
+
+#define HEADLESS_CHUNK_SIZE 65536
+#define HEADLESS_LINE_SIZE 2048
+
+// Progress through a core's UART output, which goes to its own file or as lines tagged by the core to a shared output
+struct headless_core_state {
+  FILE * output_file;
+  char * line_buffer;
+  unsigned int line_length, sentinel_match;
+  uint64_t reported_dropped_bytes;
+  bool finished;
+};
+
+int headless_uart(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, struct current_device_status*);
+int stream_uart_output(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, struct current_device_status*, FILE*, bool);
+void drain_core_output(FILE*, int, struct headless_core_state*, char*, char*, int*);
+void finish_core_output(FILE*, int, struct headless_core_state*, char*);
+int * build_sentinel_failure_table(char*);
+bool has_core_stopped(struct device_drivers*, int);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef UART_PANES_H_
+#define UART_PANES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+
+#define PANE_MIN_HEIGHT 3
+#define PANE_MIN_WIDTH 20
+#define PANE_LINE_SIZE 2048
+
+enum pane_view {PANE_VIEW_STREAM, PANE_VIEW_TILE, PANE_VIEW_FOCUS};
+
+void initialise_panes(struct launchpad_configuration*, struct device_configuration*);
+void append_pane_output(int, const char*, uint64_t);
+void mark_pane_dirty(int);
+void set_pane_view(enum pane_view, int);
+enum pane_view get_pane_view(void);
+void set_pane_scroll(uint64_t);
+void redraw_all_panes(void);
+bool render_panes(struct launchpad_configuration*);
+char * generate_scrollback_matches(char*, unsigned int, unsigned int);
+
+#endif
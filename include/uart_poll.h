@@ -0,0 +1,37 @@
+#ifndef UART_POLL_H_
+#define UART_POLL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "uart_ring.h"
+
+#define UART_STATISTICS_LINE_SIZE 320
+
+struct uart_poll_statistics {
+  uint64_t wakes_after_sleep, total_wake_latency_us, max_wake_latency_us, sweeps, wall_us;
+  double cpu_usage;
+};
+
+struct uart_core_statistics {
+  uint64_t bytes_received, lines_received, polls, empty_polls, lock_wait_ns, dropped_bytes, capture_dropped_bytes;
+  uint64_t frames_received, frame_bytes, frame_errors;
+};
+
+void start_uart_pollers(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, bool);
+void set_uart_polling(bool);
+void flush_uart_poll_cores(struct launchpad_configuration*, struct core_set*);
+void add_uart_poll_cores(struct core_set*);
+void remove_uart_poll_cores(struct core_set*);
+void get_uart_poll_cores(struct launchpad_configuration*, struct core_set*);
+bool is_uart_polling(void);
+void wake_uart_poller(void);
+void notify_uart_output(void);
+struct uart_ring * get_uart_output_ring(int);
+bool wait_for_uart_output(unsigned int);
+void get_uart_poll_statistics(struct launchpad_configuration*, struct uart_poll_statistics*);
+void get_uart_core_statistics(int, struct uart_core_statistics*);
+void describe_uart_statistics(struct launchpad_configuration*, struct device_configuration*, char*);
+
+#endif
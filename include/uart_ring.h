@@ -0,0 +1,20 @@
+#ifndef UART_RING_H_
+#define UART_RING_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Single producer, single consumer ring of UART bytes, the producer is the poller holding the core's lock and the consumer the output thread
+struct uart_ring {
+  char * buffer;
+  uint64_t capacity;
+  _Atomic uint64_t head, tail, dropped_bytes;
+};
+
+void initialise_uart_ring(struct uart_ring*, uint64_t);
+uint64_t uart_ring_push(struct uart_ring*, const char*, uint64_t);
+uint64_t uart_ring_pop(struct uart_ring*, char*, uint64_t);
+uint64_t uart_ring_discard(struct uart_ring*);
+uint64_t uart_ring_used(struct uart_ring*);
+
+#endif
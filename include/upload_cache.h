@@ -0,0 +1,26 @@
+#ifndef UPLOAD_CACHE_H_
+#define UPLOAD_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "launchpad_common.h"
+#include "async_transfer.h"
+
+#define UPLOAD_CACHE_BLOCK_SIZE 4096
+// Block hashes for a chunk that starts part way through a block can span one more block than a whole chunk
+#define UPLOAD_CACHE_MAX_CHUNK_BLOCKS(chunk_size) (((chunk_size) / UPLOAD_CACHE_BLOCK_SIZE) + 2)
+#define UPLOAD_CACHE_SHARED_SPACE -1
+
+// The 128 bit hash of a block's contents, zero in both halves means the contents are unknown
+struct upload_block_hash {
+  uint64_t low, high;
+};
+
+void initialise_upload_cache(struct device_configuration*, bool);
+bool is_upload_cache_enabled(void);
+void invalidate_upload_cache(void);
+void hash_upload_blocks(uint64_t, char*, uint64_t, bool, struct upload_block_hash*);
+uint64_t write_cached_instructions(struct transfer_queue*, int, uint64_t, char*, uint64_t, struct upload_block_hash*);
+uint64_t write_cached_core_set_instructions(struct transfer_queue*, int*, int, uint64_t*, uint64_t, char*, uint64_t, struct upload_block_hash*);
+
+#endif
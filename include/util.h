@@ -4,12 +4,13 @@
 #include <stdbool.h>
 #include "launchpad_common.h"
 #include "configuration.h"
+#include "core_set.h"
 
 #define CONFIGURATION_STR_SIZE 1048576
 
 struct current_device_status {
   bool initialised, running;
-  bool * cores_active;
+  struct core_set cores_active;
 };
 
 void generate_device_configuration(struct device_configuration*, struct device_drivers*, char*);
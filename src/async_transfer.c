@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "async_transfer.h"
+#include "launchpad_common.h"
+#include "device_lock.h"
+#include "driver_fallback.h"
+#include "util.h"
+
+/**
+ * Asynchronous memory transfers, submitted with a tag and later collected from a completion queue so that callers
+ * can keep several transfers in flight. Backends that provide device_submit_transfer and
+ * device_wait_transfer_completion are used natively, with a reaper thread routing each completion back to the queue
+ * it was submitted on. Otherwise a pool of worker threads emulates them with the blocking driver calls, each worker
+ * takes the device lock for just the one call (the core's domain, or the whole device for shared memory) so that
+ * UART polling and other transfers interleave with large uploads rather than waiting for them to finish
+ */
+
+struct completed_transfer {
+  struct device_transfer_request request;
+  uint64_t tag;
+  LP_STATUS_CODE status;
+  struct transfer_queue * queue;
+  struct completed_transfer * next;
+};
+
+static struct device_drivers * transfer_drivers=NULL;
+static int number_cores=0;
+static bool native_transfers=false;
+static struct completed_transfer * pending_head=NULL, * pending_tail=NULL;
+static pthread_mutex_t pending_mutex=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_cond=PTHREAD_COND_INITIALIZER;
+
+static void * transfer_worker_thread(void*);
+static void * completion_reaper_thread(void*);
+static LP_STATUS_CODE execute_transfer(struct device_transfer_request*);
+static void lock_transfer(struct device_transfer_request*);
+static void unlock_transfer(struct device_transfer_request*);
+static void complete_transfer(struct completed_transfer*);
+static struct completed_transfer * take_completion(struct transfer_queue*, struct device_transfer_completion*);
+
+void initialise_async_transfers(struct device_configuration * device_config, struct device_drivers * active_device_drivers, int num_workers) {
+  transfer_drivers=active_device_drivers;
+  number_cores=device_config->number_cores;
+  native_transfers=active_device_drivers->device_submit_transfer != NULL && active_device_drivers->device_wait_transfer_completion != NULL;
+  int num_threads=native_transfers ? 1 : (num_workers > 0 ? num_workers : 1);
+  for (int i=0;i<num_threads;i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, native_transfers ? &completion_reaper_thread : &transfer_worker_thread, NULL)) {
+      fprintf(stderr, "Error creating device transfer thread\n");
+      exit(-1);
+    }
+    pthread_detach(thread);
+  }
+}
+
+void initialise_transfer_queue(struct transfer_queue * queue) {
+  pthread_mutex_init(&queue->mutex, NULL);
+  pthread_cond_init(&queue->cond, NULL);
+  queue->head=queue->tail=NULL;
+  queue->outstanding=0;
+}
+
+void destroy_transfer_queue(struct transfer_queue * queue) {
+  wait_all_transfers(queue);
+  pthread_mutex_destroy(&queue->mutex);
+  pthread_cond_destroy(&queue->cond);
+}
+
+/**
+ * Submits the transfer, the request's tag is reported back in its completion
+ */
+void submit_transfer(struct transfer_queue * queue, struct device_transfer_request * request) {
+  struct completed_transfer * transfer=(struct completed_transfer*) malloc(sizeof(struct completed_transfer));
+  memcpy(&transfer->request, request, sizeof(struct device_transfer_request));
+  transfer->tag=request->tag;
+  transfer->queue=queue;
+  transfer->next=NULL;
+  pthread_mutex_lock(&queue->mutex);
+  queue->outstanding++;
+  pthread_mutex_unlock(&queue->mutex);
+
+  if (native_transfers) {
+    // The backend's tag identifies our record, so the reaper can find the queue to complete on
+    transfer->request.tag=(uint64_t) (uintptr_t) transfer;
+    // Submitting is a driver call like any other, so it is made under the lock that the transfer's memory needs
+    lock_transfer(&transfer->request);
+    LP_STATUS_CODE status=transfer_drivers->device_submit_transfer(&transfer->request);
+    unlock_transfer(&transfer->request);
+    check_device_status(status);
+    return;
+  }
+  pthread_mutex_lock(&pending_mutex);
+  if (pending_tail == NULL) {
+    pending_head=transfer;
+  } else {
+    pending_tail->next=transfer;
+  }
+  pending_tail=transfer;
+  pthread_cond_signal(&pending_cond);
+  pthread_mutex_unlock(&pending_mutex);
+}
+
+/**
+ * Collects a completed transfer if there is one, without blocking
+ */
+bool poll_transfer(struct transfer_queue * queue, struct device_transfer_completion * completion) {
+  pthread_mutex_lock(&queue->mutex);
+  struct completed_transfer * transfer=queue->head != NULL ? take_completion(queue, completion) : NULL;
+  pthread_mutex_unlock(&queue->mutex);
+  if (transfer == NULL) return false;
+  free(transfer);
+  return true;
+}
+
+void wait_transfer(struct transfer_queue * queue, struct device_transfer_completion * completion) {
+  pthread_mutex_lock(&queue->mutex);
+  while (queue->head == NULL) pthread_cond_wait(&queue->cond, &queue->mutex);
+  struct completed_transfer * transfer=take_completion(queue, completion);
+  pthread_mutex_unlock(&queue->mutex);
+  free(transfer);
+}
+
+/**
+ * Waits for every outstanding transfer on the queue, a failed transfer is handled as a failed driver call
+ */
+void wait_all_transfers(struct transfer_queue * queue) {
+  struct device_transfer_completion completion;
+  while (true) {
+    pthread_mutex_lock(&queue->mutex);
+    int outstanding=queue->outstanding;
+    pthread_mutex_unlock(&queue->mutex);
+    if (outstanding == 0) break;
+    wait_transfer(queue, &completion);
+    check_device_status(completion.status);
+  }
+}
+
+static void * transfer_worker_thread(void * args) {
+  while (true) {
+    pthread_mutex_lock(&pending_mutex);
+    while (pending_head == NULL) pthread_cond_wait(&pending_cond, &pending_mutex);
+    struct completed_transfer * transfer=pending_head;
+    pending_head=transfer->next;
+    if (pending_head == NULL) pending_tail=NULL;
+    pthread_mutex_unlock(&pending_mutex);
+
+    transfer->status=execute_transfer(&transfer->request);
+    complete_transfer(transfer);
+  }
+  return NULL;
+}
+
+static void * completion_reaper_thread(void * args) {
+  struct device_transfer_completion completion;
+  while (true) {
+    check_device_status(transfer_drivers->device_wait_transfer_completion(&completion));
+    struct completed_transfer * transfer=(struct completed_transfer*) (uintptr_t) completion.tag;
+    transfer->status=completion.status;
+    complete_transfer(transfer);
+  }
+  return NULL;
+}
+
+static LP_STATUS_CODE execute_transfer(struct device_transfer_request * request) {
+  lock_transfer(request);
+  LP_STATUS_CODE status=LP_NOT_IMPLEMENTED;
+  if (request->type == LP_TRANSFER_WRITE_INSTRUCTIONS) {
+    status=transfer_drivers->device_write_instructions(request->address, request->buffer, request->size);
+  } else if (request->type == LP_TRANSFER_WRITE_DATA) {
+    status=transfer_drivers->device_write_data(request->address, request->buffer, request->size);
+  } else if (request->type == LP_TRANSFER_READ_DATA) {
+    status=transfer_drivers->device_read_data(request->address, request->buffer, request->size);
+  } else if (request->type == LP_TRANSFER_WRITE_CORE_INSTRUCTIONS) {
+    status=transfer_drivers->device_write_core_instructions(request->core_id, request->address, request->buffer, request->size);
+  } else if (request->type == LP_TRANSFER_WRITE_CORE_DATA) {
+    status=transfer_drivers->device_write_core_data(request->core_id, request->address, request->buffer, request->size);
+  } else if (request->type == LP_TRANSFER_READ_CORE_DATA) {
+    status=transfer_drivers->device_read_core_data(request->core_id, request->address, request->buffer, request->size);
+  } else if (request->type == LP_TRANSFER_WRITE_CORE_SET_INSTRUCTIONS) {
+    status=driver_write_core_set_instructions(transfer_drivers, request->core_mask, number_cores, request->address, request->buffer, request->size);
+  } else if (request->type == LP_TRANSFER_WRITE_CORE_SET_DATA) {
+    status=driver_write_core_set_data(transfer_drivers, request->core_mask, number_cores, request->address, request->buffer, request->size);
+  }
+  unlock_transfer(request);
+  return status;
+}
+
+// Shared memory spans every lock domain so takes the whole device, core set writes take the domains of their cores
+static void lock_transfer(struct device_transfer_request * request) {
+  if (request->type == LP_TRANSFER_WRITE_INSTRUCTIONS || request->type == LP_TRANSFER_WRITE_DATA || request->type == LP_TRANSFER_READ_DATA) {
+    lock_device();
+  } else if (request->type == LP_TRANSFER_WRITE_CORE_SET_INSTRUCTIONS || request->type == LP_TRANSFER_WRITE_CORE_SET_DATA) {
+    lock_device_core_set(request->core_mask);
+  } else {
+    lock_device_core(request->core_id);
+  }
+}
+
+static void unlock_transfer(struct device_transfer_request * request) {
+  if (request->type == LP_TRANSFER_WRITE_INSTRUCTIONS || request->type == LP_TRANSFER_WRITE_DATA || request->type == LP_TRANSFER_READ_DATA) {
+    unlock_device();
+  } else if (request->type == LP_TRANSFER_WRITE_CORE_SET_INSTRUCTIONS || request->type == LP_TRANSFER_WRITE_CORE_SET_DATA) {
+    unlock_device_core_set(request->core_mask);
+  } else {
+    unlock_device_core(request->core_id);
+  }
+}
+
+static void complete_transfer(struct completed_transfer * transfer) {
+  struct transfer_queue * queue=transfer->queue;
+  transfer->next=NULL;
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->tail == NULL) {
+    queue->head=transfer;
+  } else {
+    queue->tail->next=transfer;
+  }
+  queue->tail=transfer;
+  pthread_cond_broadcast(&queue->cond);
+  pthread_mutex_unlock(&queue->mutex);
+}
+
+// Called with the queue's mutex held
+static struct completed_transfer * take_completion(struct transfer_queue * queue, struct device_transfer_completion * completion) {
+  struct completed_transfer * transfer=queue->head;
+  queue->head=transfer->next;
+  if (queue->head == NULL) queue->tail=NULL;
+  queue->outstanding--;
+  completion->tag=transfer->tag;
+  completion->status=transfer->status;
+  return transfer;
+}
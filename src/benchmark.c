@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "benchmark.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "util.h"
+#include "device_lock.h"
+
+#define BENCHMARK_MIN_SIZE 64
+#define BENCHMARK_MAX_SIZE 16777216
+#define BENCHMARK_SIZE_STEP 4
+// Each case moves roughly this much data in total, so large transfers and many cores do not take disproportionately long
+#define BENCHMARK_TARGET_BYTES 67108864
+// Size assumed for memory spaces that the device does not report
+#define BENCHMARK_UNKNOWN_SPACE_SIZE 1048576
+
+/**
+ * Measures the throughput and latency of the memory transfer calls of the device drivers, so it runs against any
+ * backend. Sweeps each memory space of the architecture over transfer sizes, device address alignments, read/write
+ * mixes and the number of cores transferred to concurrently (one thread per DDR bank, as the loader does, taking the
+ * same device locks). Writes a CSV row per case for all banks together and for each bank. This overwrites device
+ * memory so is run instead of loading an executable
+ */
+
+enum benchmark_space {BENCHMARK_CORE_INSTRUCTIONS, BENCHMARK_CORE_DATA, BENCHMARK_SHARED_INSTRUCTIONS, BENCHMARK_SHARED_DATA};
+
+static char * benchmark_space_names[]={"core_instructions", "core_data", "shared_instructions", "shared_data"};
+static unsigned int benchmark_alignments[]={0, 4, 64};
+static int benchmark_write_percentages[]={100, 50, 0};
+
+struct benchmark_case {
+  enum benchmark_space space;
+  uint64_t size, alignment;
+  int write_percent, num_cores;
+  unsigned int calls_per_core;
+};
+
+// The cores of one DDR bank in a case, bank is -1 for a shared memory space
+struct benchmark_worker {
+  struct benchmark_case * bench_case;
+  struct device_drivers * active_device_drivers;
+  int bank, num_cores;
+  int * cores;
+  char * buffer;
+  double * latencies;
+  unsigned int num_calls;
+  uint64_t bytes;
+  double seconds;
+};
+
+static void benchmark_space(FILE*, struct device_configuration*, struct device_drivers*, enum benchmark_space, uint64_t, int*, int, unsigned int);
+static void run_benchmark_case(FILE*, struct device_configuration*, struct device_drivers*, struct benchmark_case*, int*);
+static int build_bank_workers(struct device_configuration*, struct device_drivers*, struct benchmark_case*, int*, struct benchmark_worker*);
+static void * benchmark_worker_thread(void*);
+static void transfer(struct benchmark_worker*, int, bool);
+static void write_csv_row(FILE*, struct benchmark_case*, char*, unsigned int, uint64_t, double, double*);
+static int compare_latencies(const void*, const void*);
+static double get_percentile(double*, unsigned int, double);
+static uint64_t get_space_size(struct device_configuration*, enum benchmark_space);
+static double get_seconds_since(struct timespec*);
+
+int run_transfer_benchmark(struct launchpad_configuration * config, struct device_configuration * device_config,
+      struct device_drivers * active_device_drivers) {
+  // Cores selected with -c form the pool that the core count sweep draws from, otherwise every core on the device
+  int * cores=(int*) malloc(sizeof(int) * device_config->number_cores);
+  int num_cores=get_cores_in_set(&config->active_cores, cores);
+  if (num_cores == 0) {
+    for (int i=0;i<device_config->number_cores;i++) cores[num_cores++]=i;
+  }
+  fprintf(stderr, "Benchmarking transfers over %d cores, this overwrites device memory\n", num_cores);
+  printf("space,write_percent,size_bytes,alignment,cores,bank,calls,bytes,seconds,mb_per_sec,latency_p50_us,latency_p90_us,latency_p99_us,latency_max_us\n");
+
+  bool shared_instructions=device_config->architecture_type == LP_ARCH_TYPE_SHARED_INSTR_ONLY || device_config->architecture_type == LP_ARCH_TYPE_SHARED_EVERYTHING;
+  bool shared_data=device_config->architecture_type == LP_ARCH_TYPE_SHARED_DATA_ONLY || device_config->architecture_type == LP_ARCH_TYPE_SHARED_EVERYTHING;
+  unsigned int iterations=config->benchmark_iterations;
+  if (shared_instructions) {
+    benchmark_space(stdout, device_config, active_device_drivers, BENCHMARK_SHARED_INSTRUCTIONS, get_space_size(device_config, BENCHMARK_SHARED_INSTRUCTIONS), cores, num_cores, iterations);
+  } else {
+    benchmark_space(stdout, device_config, active_device_drivers, BENCHMARK_CORE_INSTRUCTIONS, get_space_size(device_config, BENCHMARK_CORE_INSTRUCTIONS), cores, num_cores, iterations);
+  }
+  if (shared_data) {
+    benchmark_space(stdout, device_config, active_device_drivers, BENCHMARK_SHARED_DATA, get_space_size(device_config, BENCHMARK_SHARED_DATA), cores, num_cores, iterations);
+  } else {
+    benchmark_space(stdout, device_config, active_device_drivers, BENCHMARK_CORE_DATA, get_space_size(device_config, BENCHMARK_CORE_DATA), cores, num_cores, iterations);
+  }
+  fflush(stdout);
+  free(cores);
+  return 0;
+}
+
+/**
+ * Sweeps every combination of size, alignment, read/write mix and core count for one memory space, instruction spaces
+ * are write only and shared spaces are not per core so only have a single core count
+ */
+static void benchmark_space(FILE * output, struct device_configuration * device_config, struct device_drivers * active_device_drivers,
+      enum benchmark_space space, uint64_t space_size, int * cores, int num_cores, unsigned int iterations) {
+  bool instructions=space == BENCHMARK_CORE_INSTRUCTIONS || space == BENCHMARK_SHARED_INSTRUCTIONS;
+  bool shared=space == BENCHMARK_SHARED_INSTRUCTIONS || space == BENCHMARK_SHARED_DATA;
+  fprintf(stderr, "Benchmarking %s space of %ld bytes\n", benchmark_space_names[space], space_size);
+  for (uint64_t size=BENCHMARK_MIN_SIZE;size<=BENCHMARK_MAX_SIZE;size*=BENCHMARK_SIZE_STEP) {
+    for (unsigned int a=0;a<sizeof(benchmark_alignments) / sizeof(unsigned int);a++) {
+      if (size + benchmark_alignments[a] > space_size) continue;
+      for (unsigned int m=0;m<sizeof(benchmark_write_percentages) / sizeof(int);m++) {
+        if (instructions && benchmark_write_percentages[m] != 100) continue;
+        // Core counts double up to the size of the pool, which is always included
+        for (int case_cores=1;case_cores<=num_cores;case_cores=(case_cores*2 > num_cores && case_cores < num_cores) ? num_cores : case_cores*2) {
+          struct benchmark_case bench_case;
+          bench_case.space=space;
+          bench_case.size=size;
+          bench_case.alignment=benchmark_alignments[a];
+          bench_case.write_percent=benchmark_write_percentages[m];
+          bench_case.num_cores=shared ? 1 : case_cores;
+          uint64_t target_calls=BENCHMARK_TARGET_BYTES / (size * bench_case.num_cores);
+          bench_case.calls_per_core=target_calls < iterations ? (target_calls > 0 ? target_calls : 1) : iterations;
+          run_benchmark_case(output, device_config, active_device_drivers, &bench_case, cores);
+          if (shared) break;
+        }
+      }
+    }
+  }
+}
+
+static void run_benchmark_case(FILE * output, struct device_configuration * device_config, struct device_drivers * active_device_drivers,
+      struct benchmark_case * bench_case, int * cores) {
+  struct benchmark_worker workers[bench_case->num_cores];
+  int num_workers=build_bank_workers(device_config, active_device_drivers, bench_case, cores, workers);
+
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  pthread_t worker_threads[num_workers];
+  for (int i=0;i<num_workers;i++) {
+    if (pthread_create(&worker_threads[i], NULL, &benchmark_worker_thread, &workers[i])) {
+      fprintf(stderr, "Error creating benchmark thread\n");
+      exit(-1);
+    }
+  }
+  unsigned int total_calls=0;
+  uint64_t total_bytes=0;
+  for (int i=0;i<num_workers;i++) {
+    pthread_join(worker_threads[i], NULL);
+    total_calls+=workers[i].num_calls;
+    total_bytes+=workers[i].bytes;
+  }
+  double elapsed_seconds=get_seconds_since(&start_time);
+
+  double * all_latencies=(double*) malloc(sizeof(double) * total_calls);
+  unsigned int latency_index=0;
+  for (int i=0;i<num_workers;i++) {
+    memcpy(&all_latencies[latency_index], workers[i].latencies, sizeof(double) * workers[i].num_calls);
+    latency_index+=workers[i].num_calls;
+  }
+  write_csv_row(output, bench_case, "all", total_calls, total_bytes, elapsed_seconds, all_latencies);
+  for (int i=0;i<num_workers;i++) {
+    char bank_name[16];
+    if (workers[i].bank < 0) {
+      sprintf(bank_name, "shared");
+    } else {
+      sprintf(bank_name, "%d", workers[i].bank);
+    }
+    write_csv_row(output, bench_case, bank_name, workers[i].num_calls, workers[i].bytes, workers[i].seconds, workers[i].latencies);
+    free(workers[i].cores);
+    free(workers[i].buffer);
+    free(workers[i].latencies);
+  }
+  free(all_latencies);
+}
+
+/**
+ * Groups the first cores of the pool by DDR bank, one worker per bank with any cores
+ */
+static int build_bank_workers(struct device_configuration * device_config, struct device_drivers * active_device_drivers,
+      struct benchmark_case * bench_case, int * cores, struct benchmark_worker * workers) {
+  int num_banks=1, num_workers=0;
+  bool shared=bench_case->space == BENCHMARK_SHARED_INSTRUCTIONS || bench_case->space == BENCHMARK_SHARED_DATA;
+  for (int i=0;i<bench_case->num_cores;i++) {
+    if (device_config->ddr_bank_mapping[cores[i]] >= num_banks) num_banks=device_config->ddr_bank_mapping[cores[i]]+1;
+  }
+  for (int bank=shared ? -1 : 0;bank<(shared ? 0 : num_banks);bank++) {
+    struct benchmark_worker * worker=&workers[num_workers];
+    memset(worker, 0, sizeof(struct benchmark_worker));
+    worker->bench_case=bench_case;
+    worker->active_device_drivers=active_device_drivers;
+    worker->bank=bank;
+    worker->cores=(int*) malloc(sizeof(int) * bench_case->num_cores);
+    for (int i=0;i<bench_case->num_cores;i++) {
+      if (shared || device_config->ddr_bank_mapping[cores[i]] == bank) worker->cores[worker->num_cores++]=cores[i];
+    }
+    if (shared) worker->num_cores=1;
+    if (worker->num_cores == 0) {
+      free(worker->cores);
+      continue;
+    }
+    // The host buffer is offset by the same alignment as the device address
+    worker->buffer=(char*) malloc(sizeof(char) * (bench_case->size + bench_case->alignment));
+    for (uint64_t i=0;i<bench_case->size + bench_case->alignment;i++) worker->buffer[i]=(char) i;
+    worker->latencies=(double*) malloc(sizeof(double) * bench_case->calls_per_core * worker->num_cores);
+    num_workers++;
+  }
+  return num_workers;
+}
+
+static void * benchmark_worker_thread(void * args) {
+  struct benchmark_worker * worker=(struct benchmark_worker*) args;
+  struct benchmark_case * bench_case=worker->bench_case;
+  unsigned int total_calls=bench_case->calls_per_core * worker->num_cores;
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  for (unsigned int call=0;call<total_calls;call++) {
+    // Spreads reads evenly between the writes for the requested mix
+    bool write=((call * bench_case->write_percent) % 100) < (unsigned int) bench_case->write_percent;
+    transfer(worker, worker->cores[call % worker->num_cores], write);
+  }
+  worker->seconds=get_seconds_since(&start_time);
+  return NULL;
+}
+
+/**
+ * A single timed call of the driver, the latency excludes waiting for the device lock
+ */
+static void transfer(struct benchmark_worker * worker, int core_id, bool write) {
+  struct benchmark_case * bench_case=worker->bench_case;
+  struct device_drivers * drivers=worker->active_device_drivers;
+  char * data=&worker->buffer[bench_case->alignment];
+  uint64_t address=bench_case->alignment, size=bench_case->size;
+  bool shared=bench_case->space == BENCHMARK_SHARED_INSTRUCTIONS || bench_case->space == BENCHMARK_SHARED_DATA;
+  if (shared) {
+    lock_device();
+  } else {
+    lock_device_core(core_id);
+  }
+  struct timespec call_start;
+  clock_gettime(CLOCK_MONOTONIC, &call_start);
+  if (bench_case->space == BENCHMARK_CORE_INSTRUCTIONS) {
+    check_device_status(drivers->device_write_core_instructions(core_id, address, data, size));
+  } else if (bench_case->space == BENCHMARK_SHARED_INSTRUCTIONS) {
+    check_device_status(drivers->device_write_instructions(address, data, size));
+  } else if (bench_case->space == BENCHMARK_CORE_DATA) {
+    if (write) {
+      check_device_status(drivers->device_write_core_data(core_id, address, data, size));
+    } else {
+      check_device_status(drivers->device_read_core_data(core_id, address, data, size));
+    }
+  } else {
+    if (write) {
+      check_device_status(drivers->device_write_data(address, data, size));
+    } else {
+      check_device_status(drivers->device_read_data(address, data, size));
+    }
+  }
+  worker->latencies[worker->num_calls++]=get_seconds_since(&call_start);
+  if (shared) {
+    unlock_device();
+  } else {
+    unlock_device_core(core_id);
+  }
+  worker->bytes+=size;
+}
+
+static void write_csv_row(FILE * output, struct benchmark_case * bench_case, char * bank_name, unsigned int calls, uint64_t bytes,
+      double seconds, double * latencies) {
+  qsort(latencies, calls, sizeof(double), compare_latencies);
+  fprintf(output, "%s,%d,%ld,%ld,%d,%s,%u,%ld,%.6f,%.2f,%.2f,%.2f,%.2f,%.2f\n", benchmark_space_names[bench_case->space],
+    bench_case->write_percent, bench_case->size, bench_case->alignment, bench_case->num_cores, bank_name, calls, bytes, seconds,
+    seconds > 0 ? ((double) bytes / (1024 * 1024)) / seconds : 0.0, get_percentile(latencies, calls, 0.5) * 1e6,
+    get_percentile(latencies, calls, 0.9) * 1e6, get_percentile(latencies, calls, 0.99) * 1e6, get_percentile(latencies, calls, 1.0) * 1e6);
+}
+
+static int compare_latencies(const void * a, const void * b) {
+  double latency_a=*((double*) a), latency_b=*((double*) b);
+  return (latency_a > latency_b) - (latency_a < latency_b);
+}
+
+/**
+ * Nearest rank percentile of sorted latencies
+ */
+static double get_percentile(double * sorted_latencies, unsigned int count, double percentile) {
+  if (count == 0) return 0.0;
+  unsigned int rank=(unsigned int) (percentile * count + 0.999999);
+  if (rank < 1) rank=1;
+  if (rank > count) rank=count;
+  return sorted_latencies[rank-1];
+}
+
+static uint64_t get_space_size(struct device_configuration * device_config, enum benchmark_space space) {
+  uint64_t size;
+  if (space == BENCHMARK_CORE_INSTRUCTIONS || space == BENCHMARK_SHARED_INSTRUCTIONS) {
+    size=(uint64_t) device_config->instruction_space_size_mb * 1024 * 1024;
+  } else if (space == BENCHMARK_CORE_DATA) {
+    size=(uint64_t) device_config->per_core_data_space_mb * 1024 * 1024;
+  } else {
+    size=(uint64_t) device_config->shared_data_space_kb * 1024;
+  }
+  return size > 0 ? size : BENCHMARK_UNKNOWN_SPACE_SIZE;
+}
+
+static double get_seconds_since(struct timespec * start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + ((now.tv_nsec - start->tv_nsec) / 1e9);
+}
@@ -0,0 +1,509 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "board.h"
+#include "launchpad_common.h"
+#include "driver_fallback.h"
+#include "core_set.h"
+#include "util.h"
+
+/**
+ * Several boards driven by one backend are presented to the rest of launchpad as a single device, whose cores and DDR
+ * banks are those of each board in turn. Every call on a core is directed to its board with device_select_board,
+ * which the backend applies to the calling thread, so threads working on different boards (the UART pollers and bank
+ * writers) proceed concurrently. Calls that span boards, such as initialise, start, stop and shared memory writes,
+ * are made on each board from a thread per board so that the boards run them in parallel. Cores are numbered across
+ * the boards and can also be addressed as board.core. Backends without board selection are a single board and are
+ * used directly
+ */
+
+struct board {
+  int first_core, number_cores, first_bank;
+  struct device_configuration configuration;
+};
+
+// One call made on one board, from its own thread where several boards are involved
+struct board_call {
+  int board_id;
+  LP_STATUS_CODE (*call)(int, void*);
+  void * args;
+  LP_STATUS_CODE status;
+};
+
+// The arguments of a core set call, with the mask split into one for each board's own cores
+struct core_set_call {
+  uint64_t ** board_masks;
+  uint64_t address, size;
+  const char * data;
+};
+
+static struct device_drivers board_drivers;
+static struct board * boards=NULL;
+static int number_boards=1, total_cores=0;
+static int * core_boards=NULL, * combined_bank_mapping=NULL;
+static uint64_t * combined_base_addr_mapping=NULL;
+
+static LP_STATUS_CODE call_boards(bool*, LP_STATUS_CODE (*)(int, void*), void*);
+static void * board_call_thread(void*);
+static LP_STATUS_CODE run_board_call(struct board_call*);
+static LP_STATUS_CODE call_core_set(const uint64_t*, LP_STATUS_CODE (*)(int, void*), uint64_t, const char*, uint64_t);
+static int select_core_board(int);
+static LP_STATUS_CODE initialise_board(int, void*);
+static LP_STATUS_CODE finalise_board(int, void*);
+static LP_STATUS_CODE reset_board(int, void*);
+static LP_STATUS_CODE start_board(int, void*);
+static LP_STATUS_CODE stop_board(int, void*);
+static LP_STATUS_CODE write_board_instructions(int, void*);
+static LP_STATUS_CODE write_board_data(int, void*);
+static LP_STATUS_CODE start_board_core_set(int, void*);
+static LP_STATUS_CODE stop_board_core_set(int, void*);
+static LP_STATUS_CODE write_board_core_set_instructions(int, void*);
+static LP_STATUS_CODE write_board_core_set_data(int, void*);
+static LP_STATUS_CODE boards_initialise(void);
+static LP_STATUS_CODE boards_finalise(void);
+static LP_STATUS_CODE boards_reset(void);
+static LP_STATUS_CODE boards_get_configuration(struct device_configuration*);
+static LP_STATUS_CODE boards_get_host_board_status(struct host_board_status*);
+static LP_STATUS_CODE boards_start_core(int);
+static LP_STATUS_CODE boards_start_allcores(void);
+static LP_STATUS_CODE boards_stop_core(int);
+static LP_STATUS_CODE boards_stop_allcores(void);
+static LP_STATUS_CODE boards_write_instructions(uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE boards_write_data(uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE boards_read_data(uint64_t, char*, uint64_t);
+static LP_STATUS_CODE boards_write_core_instructions(int, uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE boards_write_core_data(int, uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE boards_read_core_data(int, uint64_t, char*, uint64_t);
+static LP_STATUS_CODE boards_read_gpio(int, int, char*);
+static LP_STATUS_CODE boards_write_gpio(int, int, char);
+static LP_STATUS_CODE boards_uart_has_data(int, int*);
+static LP_STATUS_CODE boards_read_uart(int, char*);
+static LP_STATUS_CODE boards_read_uart_bulk(int, char*, unsigned int, unsigned int*);
+static LP_STATUS_CODE boards_write_uart(int, char);
+static LP_STATUS_CODE boards_raise_interrupt(int, int);
+static LP_STATUS_CODE boards_get_core_running(int, int*);
+static LP_STATUS_CODE boards_write_core_set_instructions(const uint64_t*, uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE boards_write_core_set_data(const uint64_t*, uint64_t, const char*, uint64_t);
+static LP_STATUS_CODE boards_start_core_set(const uint64_t*);
+static LP_STATUS_CODE boards_stop_core_set(const uint64_t*);
+
+/**
+ * Returns drivers for every board that the backend provides, which are the backend's own drivers if there is only one
+ */
+struct device_drivers setup_board_drivers(struct device_drivers backend_drivers) {
+  int boards_available=1;
+  if (backend_drivers.device_get_number_boards != NULL && backend_drivers.device_select_board != NULL) {
+    check_device_status(backend_drivers.device_get_number_boards(&boards_available));
+  }
+  if (boards_available <= 1) return backend_drivers;
+  board_drivers=backend_drivers;
+  number_boards=boards_available;
+  boards=(struct board*) calloc(number_boards, sizeof(struct board));
+
+  struct device_drivers drivers;
+  memset(&drivers, 0, sizeof(struct device_drivers));
+  drivers.device_initialise=boards_initialise;
+  drivers.device_finalise=boards_finalise;
+  drivers.device_reset=boards_reset;
+  drivers.device_get_configuration=boards_get_configuration;
+  drivers.device_get_host_board_status=boards_get_host_board_status;
+  drivers.device_start_core=boards_start_core;
+  drivers.device_start_allcores=boards_start_allcores;
+  drivers.device_stop_core=boards_stop_core;
+  drivers.device_stop_allcores=boards_stop_allcores;
+  drivers.device_write_instructions=boards_write_instructions;
+  drivers.device_write_data=boards_write_data;
+  drivers.device_read_data=boards_read_data;
+  drivers.device_write_core_instructions=boards_write_core_instructions;
+  drivers.device_write_core_data=boards_write_core_data;
+  drivers.device_read_core_data=boards_read_core_data;
+  drivers.device_read_gpio=boards_read_gpio;
+  drivers.device_write_gpio=boards_write_gpio;
+  drivers.device_uart_has_data=boards_uart_has_data;
+  drivers.device_read_uart=boards_read_uart;
+  drivers.device_write_uart=boards_write_uart;
+  drivers.device_raise_interrupt=boards_raise_interrupt;
+  // Start and stop of a core set are always split per board, so that the boards start their cores together
+  drivers.device_start_core_set=boards_start_core_set;
+  drivers.device_stop_core_set=boards_stop_core_set;
+  // The remaining optional calls are only provided where the backend has them, UART events and native asynchronous
+  // transfers identify cores by their board's numbering so are not used across boards
+  if (backend_drivers.device_read_uart_bulk != NULL) drivers.device_read_uart_bulk=boards_read_uart_bulk;
+  if (backend_drivers.device_get_core_running != NULL) drivers.device_get_core_running=boards_get_core_running;
+  if (backend_drivers.device_write_core_set_instructions != NULL) drivers.device_write_core_set_instructions=boards_write_core_set_instructions;
+  if (backend_drivers.device_write_core_set_data != NULL) drivers.device_write_core_set_data=boards_write_core_set_data;
+  return drivers;
+}
+
+/**
+ * Records the cores of a single board, multiple boards are recorded as their configuration is read
+ */
+void initialise_board_cores(struct device_configuration * device_config) {
+  if (boards != NULL) return;
+  boards=(struct board*) calloc(1, sizeof(struct board));
+  boards[0].number_cores=total_cores=device_config->number_cores;
+}
+
+int get_number_boards() {
+  return number_boards;
+}
+
+int get_core_board(int core_id) {
+  return number_boards > 1 ? core_boards[core_id] : 0;
+}
+
+int get_board_first_core(int board_id) {
+  return boards[board_id].first_core;
+}
+
+int get_board_number_cores(int board_id) {
+  return boards[board_id].number_cores;
+}
+
+/**
+ * Returns the device wide id of a core on a board, or -1 if there is no such core
+ */
+int resolve_board_core(int board_id, int core_id) {
+  if (board_id < 0 || board_id >= number_boards) return -1;
+  if (core_id < 0 || core_id >= boards[board_id].number_cores) return -1;
+  return boards[board_id].first_core + core_id;
+}
+
+/**
+ * Describes a core for display, as board.core where there are several boards
+ */
+void describe_core(int core_id, char * target) {
+  if (number_boards > 1) {
+    sprintf(target, "%d.%d", core_boards[core_id], core_id - boards[core_boards[core_id]].first_core);
+  } else {
+    sprintf(target, "%d", core_id);
+  }
+}
+
+/**
+ * Makes the call on each selected board (all of them if selected is NULL), in parallel where there are several, and
+ * returns the first failure
+ */
+static LP_STATUS_CODE call_boards(bool * selected, LP_STATUS_CODE (*call)(int, void*), void * args) {
+  struct board_call calls[number_boards];
+  pthread_t threads[number_boards];
+  int num_selected=0;
+  for (int i=0;i<number_boards;i++) {
+    calls[i].board_id=i;
+    calls[i].call=call;
+    calls[i].args=args;
+    calls[i].status=LP_SUCCESS;
+    if (selected == NULL || selected[i]) num_selected++;
+  }
+  if (num_selected == 1) {
+    for (int i=0;i<number_boards;i++) {
+      if (selected == NULL || selected[i]) return run_board_call(&calls[i]);
+    }
+  }
+  for (int i=0;i<number_boards;i++) {
+    if (selected != NULL && !selected[i]) continue;
+    if (pthread_create(&threads[i], NULL, &board_call_thread, &calls[i])) {
+      fprintf(stderr, "Error creating board call thread\n");
+      exit(-1);
+    }
+  }
+  LP_STATUS_CODE status=LP_SUCCESS;
+  for (int i=0;i<number_boards;i++) {
+    if (selected != NULL && !selected[i]) continue;
+    pthread_join(threads[i], NULL);
+    if (status == LP_SUCCESS) status=calls[i].status;
+  }
+  return status;
+}
+
+static void * board_call_thread(void * args) {
+  run_board_call((struct board_call*) args);
+  return NULL;
+}
+
+static LP_STATUS_CODE run_board_call(struct board_call * board_call) {
+  board_call->status=board_drivers.device_select_board(board_call->board_id);
+  if (board_call->status == LP_SUCCESS) board_call->status=board_call->call(board_call->board_id, board_call->args);
+  return board_call->status;
+}
+
+/**
+ * Splits the mask into one per board and makes the call on each board that has cores in it
+ */
+static LP_STATUS_CODE call_core_set(const uint64_t * core_mask, LP_STATUS_CODE (*call)(int, void*), uint64_t address, const char * data, uint64_t size) {
+  struct core_set_call args;
+  uint64_t * board_masks[number_boards];
+  bool selected[number_boards];
+  args.board_masks=board_masks;
+  args.address=address;
+  args.data=data;
+  args.size=size;
+  struct core_set cores, board_cores[number_boards];
+  view_core_mask_as_set(&cores, core_mask, total_cores);
+  for (int i=0;i<number_boards;i++) {
+    initialise_core_set(&board_cores[i], boards[i].number_cores);
+    // The set's words are laid out as a driver core mask
+    board_masks[i]=board_cores[i].words;
+    selected[i]=false;
+  }
+  for (int i=next_core_in_set(&cores, 0);i>=0;i=next_core_in_set(&cores, i+1)) {
+    add_core_to_set(&board_cores[core_boards[i]], i - boards[core_boards[i]].first_core);
+    selected[core_boards[i]]=true;
+  }
+  LP_STATUS_CODE status=call_boards(selected, call, &args);
+  for (int i=0;i<number_boards;i++) free_core_set(&board_cores[i]);
+  return status;
+}
+
+// Selects the board of a device wide core id for the calling thread, returning the core's id on its board or -1
+static int select_core_board(int core_id) {
+  if (core_id < 0 || core_id >= total_cores) return -1;
+  if (board_drivers.device_select_board(core_boards[core_id]) != LP_SUCCESS) return -1;
+  return core_id - boards[core_boards[core_id]].first_core;
+}
+
+static LP_STATUS_CODE initialise_board(int board_id, void * args) {
+  return board_drivers.device_initialise();
+}
+
+static LP_STATUS_CODE finalise_board(int board_id, void * args) {
+  return board_drivers.device_finalise();
+}
+
+static LP_STATUS_CODE reset_board(int board_id, void * args) {
+  return board_drivers.device_reset();
+}
+
+static LP_STATUS_CODE start_board(int board_id, void * args) {
+  return board_drivers.device_start_allcores();
+}
+
+static LP_STATUS_CODE stop_board(int board_id, void * args) {
+  return board_drivers.device_stop_allcores();
+}
+
+static LP_STATUS_CODE write_board_instructions(int board_id, void * args) {
+  struct core_set_call * write=(struct core_set_call*) args;
+  return board_drivers.device_write_instructions(write->address, write->data, write->size);
+}
+
+static LP_STATUS_CODE write_board_data(int board_id, void * args) {
+  struct core_set_call * write=(struct core_set_call*) args;
+  return board_drivers.device_write_data(write->address, write->data, write->size);
+}
+
+static LP_STATUS_CODE start_board_core_set(int board_id, void * args) {
+  return driver_start_core_set(&board_drivers, ((struct core_set_call*) args)->board_masks[board_id], boards[board_id].number_cores);
+}
+
+static LP_STATUS_CODE stop_board_core_set(int board_id, void * args) {
+  return driver_stop_core_set(&board_drivers, ((struct core_set_call*) args)->board_masks[board_id], boards[board_id].number_cores);
+}
+
+static LP_STATUS_CODE write_board_core_set_instructions(int board_id, void * args) {
+  struct core_set_call * write=(struct core_set_call*) args;
+  return board_drivers.device_write_core_set_instructions(write->board_masks[board_id], write->address, write->data, write->size);
+}
+
+static LP_STATUS_CODE write_board_core_set_data(int board_id, void * args) {
+  struct core_set_call * write=(struct core_set_call*) args;
+  return board_drivers.device_write_core_set_data(write->board_masks[board_id], write->address, write->data, write->size);
+}
+
+static LP_STATUS_CODE boards_initialise() {
+  return call_boards(NULL, initialise_board, NULL);
+}
+
+static LP_STATUS_CODE boards_finalise() {
+  return call_boards(NULL, finalise_board, NULL);
+}
+
+static LP_STATUS_CODE boards_reset() {
+  return call_boards(NULL, reset_board, NULL);
+}
+
+/**
+ * Combines the boards' configurations, they must share a memory architecture and the first board's memory sizes are
+ * reported. Concurrent access is allowed at the coarsest granularity of any board, which is never wider than a board
+ */
+static LP_STATUS_CODE boards_get_configuration(struct device_configuration * device_config) {
+  total_cores=0;
+  int total_banks=0;
+  for (int i=0;i<number_boards;i++) {
+    LP_STATUS_CODE status=board_drivers.device_select_board(i);
+    if (status == LP_SUCCESS) status=board_drivers.device_get_configuration(&boards[i].configuration);
+    if (status != LP_SUCCESS) return status;
+    if (boards[i].configuration.architecture_type != boards[0].configuration.architecture_type) {
+      fprintf(stderr, "Error, board %d has a different memory architecture to board 0\n", i);
+      return LP_ERROR;
+    }
+    boards[i].first_core=total_cores;
+    boards[i].number_cores=boards[i].configuration.number_cores;
+    boards[i].first_bank=total_banks;
+    total_cores+=boards[i].number_cores;
+    for (int j=0;j<boards[i].number_cores;j++) {
+      if (boards[i].first_bank + boards[i].configuration.ddr_bank_mapping[j] >= total_banks) {
+        total_banks=boards[i].first_bank + boards[i].configuration.ddr_bank_mapping[j] + 1;
+      }
+    }
+  }
+  core_boards=(int*) realloc(core_boards, sizeof(int) * total_cores);
+  combined_bank_mapping=(int*) realloc(combined_bank_mapping, sizeof(int) * total_cores);
+  combined_base_addr_mapping=(uint64_t*) realloc(combined_base_addr_mapping, sizeof(uint64_t) * total_cores);
+  memcpy(device_config, &boards[0].configuration, sizeof(struct device_configuration));
+  for (int i=0;i<number_boards;i++) {
+    for (int j=0;j<boards[i].number_cores;j++) {
+      core_boards[boards[i].first_core + j]=i;
+      combined_bank_mapping[boards[i].first_core + j]=boards[i].first_bank + boards[i].configuration.ddr_bank_mapping[j];
+      combined_base_addr_mapping[boards[i].first_core + j]=boards[i].configuration.ddr_base_addr_mapping[j];
+    }
+    if (boards[i].configuration.lock_granularity < device_config->lock_granularity) {
+      device_config->lock_granularity=boards[i].configuration.lock_granularity;
+    }
+  }
+  device_config->number_cores=total_cores;
+  device_config->ddr_bank_mapping=combined_bank_mapping;
+  device_config->ddr_base_addr_mapping=combined_base_addr_mapping;
+  return LP_SUCCESS;
+}
+
+/**
+ * Reports the hottest board's temperature and the total power draw, other details are those of the first board
+ */
+static LP_STATUS_CODE boards_get_host_board_status(struct host_board_status * board_status) {
+  for (int i=0;i<number_boards;i++) {
+    struct host_board_status status_of_board;
+    LP_STATUS_CODE status=board_drivers.device_select_board(i);
+    if (status == LP_SUCCESS) status=board_drivers.device_get_host_board_status(&status_of_board);
+    if (status != LP_SUCCESS) return status;
+    if (i == 0) {
+      memcpy(board_status, &status_of_board, sizeof(struct host_board_status));
+    } else {
+      if (status_of_board.temp > board_status->temp) board_status->temp=status_of_board.temp;
+      board_status->power_draw+=status_of_board.power_draw;
+    }
+  }
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE boards_start_core(int core_id) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_start_core(board_core);
+}
+
+static LP_STATUS_CODE boards_start_allcores() {
+  return call_boards(NULL, start_board, NULL);
+}
+
+static LP_STATUS_CODE boards_stop_core(int core_id) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_stop_core(board_core);
+}
+
+static LP_STATUS_CODE boards_stop_allcores() {
+  return call_boards(NULL, stop_board, NULL);
+}
+
+// Each board has its own shared memory, so writes to it go to every board
+static LP_STATUS_CODE boards_write_instructions(uint64_t address, const char * data, uint64_t size) {
+  struct core_set_call args={NULL, address, size, data};
+  return call_boards(NULL, write_board_instructions, &args);
+}
+
+static LP_STATUS_CODE boards_write_data(uint64_t address, const char * data, uint64_t size) {
+  struct core_set_call args={NULL, address, size, data};
+  return call_boards(NULL, write_board_data, &args);
+}
+
+// Reads are from the first board's shared data memory
+static LP_STATUS_CODE boards_read_data(uint64_t address, char * data, uint64_t size) {
+  LP_STATUS_CODE status=board_drivers.device_select_board(0);
+  if (status != LP_SUCCESS) return status;
+  return board_drivers.device_read_data(address, data, size);
+}
+
+static LP_STATUS_CODE boards_write_core_instructions(int core_id, uint64_t address, const char * data, uint64_t size) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_write_core_instructions(board_core, address, data, size);
+}
+
+static LP_STATUS_CODE boards_write_core_data(int core_id, uint64_t address, const char * data, uint64_t size) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_write_core_data(board_core, address, data, size);
+}
+
+static LP_STATUS_CODE boards_read_core_data(int core_id, uint64_t address, char * data, uint64_t size) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_read_core_data(board_core, address, data, size);
+}
+
+static LP_STATUS_CODE boards_read_gpio(int core_id, int pin, char * value) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_read_gpio(board_core, pin, value);
+}
+
+static LP_STATUS_CODE boards_write_gpio(int core_id, int pin, char value) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_write_gpio(board_core, pin, value);
+}
+
+static LP_STATUS_CODE boards_uart_has_data(int core_id, int * has_data) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_uart_has_data(board_core, has_data);
+}
+
+static LP_STATUS_CODE boards_read_uart(int core_id, char * data) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_read_uart(board_core, data);
+}
+
+static LP_STATUS_CODE boards_read_uart_bulk(int core_id, char * buffer, unsigned int max_bytes, unsigned int * bytes_read) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_read_uart_bulk(board_core, buffer, max_bytes, bytes_read);
+}
+
+static LP_STATUS_CODE boards_write_uart(int core_id, char data) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_write_uart(board_core, data);
+}
+
+static LP_STATUS_CODE boards_raise_interrupt(int core_id, int interrupt_id) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_raise_interrupt(board_core, interrupt_id);
+}
+
+static LP_STATUS_CODE boards_get_core_running(int core_id, int * running) {
+  int board_core=select_core_board(core_id);
+  if (board_core < 0) return LP_UNKNOWN_CORE;
+  return board_drivers.device_get_core_running(board_core, running);
+}
+
+static LP_STATUS_CODE boards_write_core_set_instructions(const uint64_t * core_mask, uint64_t address, const char * data, uint64_t size) {
+  return call_core_set(core_mask, write_board_core_set_instructions, address, data, size);
+}
+
+static LP_STATUS_CODE boards_write_core_set_data(const uint64_t * core_mask, uint64_t address, const char * data, uint64_t size) {
+  return call_core_set(core_mask, write_board_core_set_data, address, data, size);
+}
+
+static LP_STATUS_CODE boards_start_core_set(const uint64_t * core_mask) {
+  return call_core_set(core_mask, start_board_core_set, 0, NULL, 0);
+}
+
+static LP_STATUS_CODE boards_stop_core_set(const uint64_t * core_mask) {
+  return call_core_set(core_mask, stop_board_core_set, 0, NULL, 0);
+}
@@ -3,11 +3,16 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <limits.h>
 #include "configuration.h"
+#include "benchmark.h"
+#include "board.h"
 
 static void parseCommandLineArguments(struct launchpad_configuration*, int, char**);
 static int areStringsEqualIgnoreCase(char*, char*);
 static void displayHelp(void);
+static void addDatasetSpec(struct launchpad_configuration*, char*, bool);
+static bool parseCoreId(char*, char**, long*);
 
 /**
  * Given the command line arguments this will read the configuration and return the configuration structure
@@ -19,8 +24,41 @@ struct launchpad_configuration* readConfiguration(int argc, char *argv[]) {
   configuration->executable_filename=NULL;
   configuration->reset=false;
   configuration->display_config=false;
-  configuration->all_cores_active=false;
-  for (int i=0;i<MAX_NUM_CORES;i++) configuration->active_cores[i]=false;
+  configuration->active_cores_spec=NULL;
+  configuration->poll_rate_hz=DEFAULT_POLL_RATE_HZ;
+  configuration->poll_spin_sweeps=DEFAULT_POLL_SPIN_SWEEPS;
+  configuration->poll_threads=DEFAULT_POLL_THREADS;
+  configuration->poll_pin_cpu=-1;
+  configuration->transfer_threads=DEFAULT_TRANSFER_THREADS;
+  configuration->uart_buffer_kb=DEFAULT_UART_BUFFER_KB;
+  configuration->render_fps=DEFAULT_RENDER_FPS;
+  configuration->scrollback_kb=DEFAULT_SCROLLBACK_KB;
+  configuration->tile_view=false;
+  configuration->telemetry_hz=DEFAULT_TELEMETRY_HZ;
+  configuration->telemetry_csv=NULL;
+  configuration->capture_dir=NULL;
+  configuration->capture_dump_spec=NULL;
+  configuration->frames_dir=NULL;
+  configuration->mailbox_dir=NULL;
+  configuration->file_proxy_dir=NULL;
+  configuration->batch_mode=false;
+  configuration->batch_output_dir=NULL;
+  configuration->batch_sentinel=NULL;
+  configuration->batch_timeout_sec=0;
+  configuration->data_base_address=0;
+  configuration->upload_cache=true;
+  configuration->benchmark_mode=false;
+  configuration->benchmark_iterations=DEFAULT_BENCHMARK_ITERATIONS;
+  configuration->dataset_specs=NULL;
+  configuration->dataset_sharded=NULL;
+  configuration->num_datasets=0;
+  configuration->daemon_socket=NULL;
+  configuration->connect_socket=NULL;
+  configuration->client_commands=NULL;
+  configuration->num_client_commands=0;
+  configuration->job_specs=NULL;
+  configuration->num_jobs=0;
+  memset(&configuration->active_cores, 0, sizeof(struct core_set));
   parseCommandLineArguments(configuration, argc, argv);
   return configuration;
 }
@@ -39,67 +77,264 @@ static void parseCommandLineArguments(struct launchpad_configuration* configurat
       exit(0);
     } else if (areStringsEqualIgnoreCase(argv[i], "-reset")) {
       configuration->reset=true;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-nocache")) {
+      configuration->upload_cache=false;
     } else if (areStringsEqualIgnoreCase(argv[i], "-config")) {
       configuration->display_config=true;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-pollrate")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the UART poll rate you must provide the rate in Hz\n");
+        exit(0);
+      }
+      configuration->poll_rate_hz=atoi(argv[++i]);
+    } else if (areStringsEqualIgnoreCase(argv[i], "-pollspin")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the UART poll spin you must provide the number of sweeps\n");
+        exit(0);
+      }
+      configuration->poll_spin_sweeps=atoi(argv[++i]);
+    } else if (areStringsEqualIgnoreCase(argv[i], "-pollthreads")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the number of UART poller threads you must provide a value\n");
+        exit(0);
+      }
+      configuration->poll_threads=atoi(argv[++i]);
+      if (configuration->poll_threads < 1) configuration->poll_threads=1;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-pollpin")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When pinning UART poller threads you must provide the first CPU\n");
+        exit(0);
+      }
+      configuration->poll_pin_cpu=atoi(argv[++i]);
+    } else if (areStringsEqualIgnoreCase(argv[i], "-transferthreads")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the number of transfer threads you must provide a value\n");
+        exit(0);
+      }
+      configuration->transfer_threads=atoi(argv[++i]);
+      if (configuration->transfer_threads < 1) configuration->transfer_threads=1;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-uartbuffer")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the UART buffer size you must provide the size in KB\n");
+        exit(0);
+      }
+      configuration->uart_buffer_kb=atoi(argv[++i]);
+      if (configuration->uart_buffer_kb < 1) configuration->uart_buffer_kb=1;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-fps")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the display frame rate you must provide a value\n");
+        exit(0);
+      }
+      configuration->render_fps=atoi(argv[++i]);
+    } else if (areStringsEqualIgnoreCase(argv[i], "-scrollback")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the scrollback size you must provide the size in KB\n");
+        exit(0);
+      }
+      configuration->scrollback_kb=atoi(argv[++i]);
+      if (configuration->scrollback_kb < 1) configuration->scrollback_kb=1;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-tile")) {
+      configuration->tile_view=true;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-telemetry")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the board telemetry sample rate you must provide a value\n");
+        exit(0);
+      }
+      configuration->telemetry_hz=atoi(argv[++i]);
+    } else if (areStringsEqualIgnoreCase(argv[i], "-telemetrycsv")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the board telemetry CSV file you must provide a path\n");
+        exit(0);
+      }
+      configuration->telemetry_csv=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-capture")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When capturing UART output you must provide the directory to write the logs to\n");
+        exit(0);
+      }
+      configuration->capture_dir=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-capturedump")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When reading a UART capture you must provide the core and optionally the time, as core[@seconds]\n");
+        exit(0);
+      }
+      configuration->capture_dump_spec=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-frames")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When decoding binary UART frames you must provide the directory to write the frame streams to\n");
+        exit(0);
+      }
+      configuration->frames_dir=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-mailbox")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When draining core mailboxes you must provide the directory to write the records to\n");
+        exit(0);
+      }
+      configuration->mailbox_dir=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-fileproxy")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When serving file I/O to the cores you must provide the directory that their files are in\n");
+        exit(0);
+      }
+      configuration->file_proxy_dir=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-batch")) {
+      configuration->batch_mode=true;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-output")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the batch output directory you must provide a path\n");
+        exit(0);
+      }
+      configuration->batch_output_dir=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-until")) {
+      if (i+1 == argc || strlen(argv[i+1]) == 0) {
+        fprintf(stderr, "When specifying the batch sentinel you must provide a non-empty string\n");
+        exit(0);
+      }
+      configuration->batch_sentinel=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-timeout")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the batch timeout you must provide the number of seconds\n");
+        exit(0);
+      }
+      configuration->batch_timeout_sec=atoi(argv[++i]);
+    } else if (areStringsEqualIgnoreCase(argv[i], "-benchmark")) {
+      configuration->benchmark_mode=true;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-benchiters")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the benchmark iterations you must provide the number of calls\n");
+        exit(0);
+      }
+      configuration->benchmark_iterations=atoi(argv[++i]);
+      if (configuration->benchmark_iterations < 1) configuration->benchmark_iterations=1;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-data") || areStringsEqualIgnoreCase(argv[i], "-shard")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying a dataset you must provide [cores=]filename[@offset]\n");
+        exit(0);
+      }
+      addDatasetSpec(configuration, argv[i+1], areStringsEqualIgnoreCase(argv[i], "-shard"));
+      i++;
+    } else if (areStringsEqualIgnoreCase(argv[i], "-database")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When specifying the data base address you must provide an address\n");
+        exit(0);
+      }
+      configuration->data_base_address=strtoull(argv[++i], NULL, 0);
+    } else if (areStringsEqualIgnoreCase(argv[i], "-daemon")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When running as a daemon you must provide the path of the socket to listen on\n");
+        exit(0);
+      }
+      configuration->daemon_socket=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-connect")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When connecting to a daemon you must provide the path of its socket\n");
+        exit(0);
+      }
+      configuration->connect_socket=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-send")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When sending a command to a daemon you must provide the command\n");
+        exit(0);
+      }
+      configuration->client_commands=(char**) realloc(configuration->client_commands, sizeof(char*) * (configuration->num_client_commands + 1));
+      configuration->client_commands[configuration->num_client_commands++]=argv[++i];
+    } else if (areStringsEqualIgnoreCase(argv[i], "-job")) {
+      if (i+1 == argc) {
+        fprintf(stderr, "When queueing a job you must provide its description\n");
+        exit(0);
+      }
+      configuration->job_specs=(char**) realloc(configuration->job_specs, sizeof(char*) * (configuration->num_jobs + 1));
+      configuration->job_specs[configuration->num_jobs++]=argv[++i];
     } else if (areStringsEqualIgnoreCase(argv[i], "-c")) {
       if (i+1 ==argc) {
         fprintf(stderr, "When specifying active cores you must provide arguments\n");
         exit(0);
       } else {
-        parseCoreActiveInfo(configuration, argv[++i]);
+        // Parsed once the number of cores on the device is known
+        configuration->active_cores_spec=argv[++i];
       }
     }
   }
 }
 
+/**
+ * Records a dataset to be staged into the data memory of cores, these are parsed once the device configuration is known
+ */
+static void addDatasetSpec(struct launchpad_configuration* configuration, char * spec, bool sharded) {
+  configuration->dataset_specs=(char**) realloc(configuration->dataset_specs, sizeof(char*) * (configuration->num_datasets + 1));
+  configuration->dataset_sharded=(bool*) realloc(configuration->dataset_sharded, sizeof(bool) * (configuration->num_datasets + 1));
+  configuration->dataset_specs[configuration->num_datasets]=spec;
+  configuration->dataset_sharded[configuration->num_datasets]=sharded;
+  configuration->num_datasets++;
+}
+
 /**
  * Determines the active cores if the user supplied -c n, can be a single integer, a list, a range or
- * all to select all cores
+ * all to select all cores. The active core set must already be sized to the device, returns false and leaves the
+ * active cores unchanged if the description is invalid
+ */
+bool parseCoreActiveInfo(struct launchpad_configuration* configuration, char * info) {
+  struct core_set parsed_cores;
+  initialise_core_set(&parsed_cores, configuration->active_cores.number_cores);
+  bool valid=parseCoreInfoString(info, &parsed_cores);
+  if (valid) copy_core_set(&configuration->active_cores, &parsed_cores);
+  free_core_set(&parsed_cores);
+  return valid;
+}
+
+/**
+ * Sets the cores to those described, which is all or a comma separated list where each element is a core, an
+ * inclusive range of them (a:b) or every core of a board (b.*). A core is its id or, where there are several boards,
+ * board.core. Returns false if the description is malformed or names a core beyond the set's number of cores
  */
-void parseCoreActiveInfo(struct launchpad_configuration* configuration, char * info) {
+bool parseCoreInfoString(char * info, struct core_set * cores) {
+  clear_core_set(cores);
   if (areStringsEqualIgnoreCase(info, "all")) {
-    configuration->all_cores_active=true;
-    for (int i=0;i<MAX_NUM_CORES;i++) configuration->active_cores[i]=true;
-  } else {
-    bool * active_cores = (bool*) malloc(sizeof(bool) * MAX_NUM_CORES);
-    parseCoreInfoString(info, active_cores, MAX_NUM_CORES);
-    for (int i=0;i<MAX_NUM_CORES;i++) configuration->active_cores[i]=active_cores[i];
-    free(active_cores);
+    fill_core_set(cores);
+    return true;
+  }
+  char * element=info;
+  while (true) {
+    char * end;
+    long from, to;
+    long board=strtol(element, &end, 10);
+    if (end != element && end[0] == '.' && end[1] == '*') {
+      if (board < 0 || board >= get_number_boards()) return false;
+      from=get_board_first_core((int) board);
+      to=from + get_board_number_cores((int) board) - 1;
+      end+=2;
+    } else {
+      if (!parseCoreId(element, &end, &from)) return false;
+      to=from;
+      if (*end == ':') {
+        if (!parseCoreId(end+1, &end, &to)) return false;
+      }
+    }
+    if (*end != ',' && *end != '\0') return false;
+    if (from < 0 || to < from || to >= cores->number_cores) return false;
+    for (long i=from;i<=to;i++) add_core_to_set(cores, (int) i);
+    if (*end == '\0') return true;
+    element=end+1;
   }
 }
 
-void parseCoreInfoString(char * info, bool * active_cores, int number_cores) {
-  if (strchr(info, ',') != NULL) {
-    char vn[5];
-    int s;
-    for (int i=0;i<number_cores;i++) active_cores=false;
-    while (strchr(info, ',') != NULL) {
-      s=strchr(info, ',')-info;
-      memcpy(vn, info, s);
-      vn[s]='\0';
-      active_cores[atoi(vn)]=true;
-      info=strchr(info, ',')+1;
-    }
-    active_cores[atoi(info)]=true;
-  } else if (strchr(info, ':') != NULL) {
-    char vn[5];
-    int s;
-    s=strchr(info, ':')-info;
-    memcpy(vn, info, s);
-    vn[s]='\0';
-    int from=atoi(vn);
-    int to=atoi(strchr(info, ':')+1);
-    for (int i=0;i<number_cores;i++) {
-      if (i >= from && i<= to) {
-        active_cores[i]=true;
-      } else {
-        active_cores[i]=false;
-      }
+/**
+ * Parses a core given as its id or as board.core, a board core that does not exist is parsed as -1
+ */
+static bool parseCoreId(char * str, char ** end, long * core_id) {
+  *core_id=strtol(str, end, 10);
+  if (*end == str) return false;
+  if (**end == '.') {
+    char * board_core=*end+1;
+    long core_on_board=strtol(board_core, end, 10);
+    if (*end == board_core) return false;
+    if (*core_id > INT_MAX || core_on_board > INT_MAX) {
+      *core_id=-1;
+    } else {
+      *core_id=resolve_board_core((int) *core_id, (int) core_on_board);
     }
-  } else {
-    for (int i=0;i<number_cores;i++) active_cores[i]=false;
-    active_cores[atoi(info)]=true;
   }
+  return true;
 }
 
 /**
@@ -109,7 +344,57 @@ static void displayHelp() {
   printf("Launchpad version %s\n", VERSION_IDENT);
   printf("launchpad [arguments]\n\nArguments\n--------\n");
   printf("-bin/-exe arg  Provides the binary executable file to be loaded and executed\n");
-  printf("-c list        Specify active cores; can be a single id, all, a range (a:b) or a list (a,b,c,d)\n");
+  printf("-c list        Specify active cores; can be a single id, all, a range (a:b) or a list of these (a,b,c:d), with\n");
+  printf("               several boards a core can also be given as board.core and every core of a board as board.*\n");
+  printf("-data spec     Stage a dataset into each core's data memory before starting, spec is [cores=]file[@offset] and a\n");
+  printf("               %%d in the filename is replaced by the core id for a file per core (can be repeated)\n");
+  printf("-shard spec    As -data, but a single file split into equal contiguous slices, one per core in order\n");
+  printf("-database addr Core address at which data memory starts, ELF segments at or above this are loaded into data\n");
+  printf("               memory (default is directly after instruction memory)\n");
+  printf("-pollrate hz   Minimum UART poll rate when cores are idle, trades CPU usage for output latency (default %d)\n", DEFAULT_POLL_RATE_HZ);
+  printf("-pollspin n    Number of empty UART poll sweeps before backing off (default %d)\n", DEFAULT_POLL_SPIN_SWEEPS);
+  printf("-pollthreads n Number of UART poller threads, each polls a shard of the cores (default %d)\n", DEFAULT_POLL_THREADS);
+  printf("-pollpin cpu   Pin UART poller threads to consecutive host CPUs starting at this one\n");
+  printf("-transferthreads n\n");
+  printf("               Number of threads performing device memory transfers for backends without asynchronous\n");
+  printf("               transfers, uploads overlap across cores and with UART polling (default %d)\n", DEFAULT_TRANSFER_THREADS);
+  printf("-uartbuffer kb Per core buffer of UART output awaiting display, output beyond this is dropped (default %d)\n", DEFAULT_UART_BUFFER_KB);
+  printf("-fps n         Maximum number of display refreshes per second (default %d)\n", DEFAULT_RENDER_FPS);
+  printf("-tile          Start the interactive display with a pane for each core rather than a single stream\n");
+  printf("-scrollback kb Per core scrollback kept for the panes and searching, the oldest lines are evicted beyond this\n");
+  printf("               (default %d)\n", DEFAULT_SCROLLBACK_KB);
+  printf("-telemetry hz  Board temperature and power samples per second, integrated into the energy of each run, 0\n");
+  printf("               disables (default %d)\n", DEFAULT_TELEMETRY_HZ);
+  printf("-telemetrycsv f\n");
+  printf("               Write the board telemetry samples to the CSV file f on exit\n");
+  printf("-capture dir   Capture every core's UART output, timestamped, to compressed logs (core_n.log) in dir with an\n");
+  printf("               index of each log (core_n.idx) by time. Capture never holds up polling, records are dropped\n");
+  printf("               and counted if the writer falls behind\n");
+  printf("-capturedump c Print core c's output captured in the -capture directory, with each line's time, from the\n");
+  printf("               start or given as c@seconds from that time, then quit\n");
+  printf("-frames dir    Decode binary frames that cores send amongst their UART text, writing each core's frames\n");
+  printf("               with their time to dir/core_n.frames, the text passes through to the display unchanged\n");
+  printf("-mailbox dir   Drain the records that cores post to their mailbox, the top 16KB of each core's data space (or\n");
+  printf("               of the shared data space on shared data architectures), writing them to dir/core_n.mailbox\n");
+  printf("-fileproxy dir Serve the file requests (open, read, write, lseek and close) that cores make through the block\n");
+  printf("               below their mailbox from the files in dir, paths outside of dir are refused\n");
+  printf("-batch         Run without the interactive display, streaming UART output to stdout (tagged by core) or files\n");
+  printf("-output dir    In batch mode write each core's UART output to dir/core_n.out instead of stdout\n");
+  printf("-until str     In batch mode a core has completed once it prints this sentinel string\n");
+  printf("-timeout s     In batch mode stop the cores and exit with status 2 if not complete after s seconds\n");
+  printf("-daemon path   Keep the device initialised and serve commands from clients on this Unix domain socket\n");
+  printf("-connect path  Run as a client of the daemon on this socket, with -bin runs as batch mode does (using -c, -data,\n");
+  printf("               -shard, -until, -timeout and -reset) on the daemon's device, otherwise sends the -send commands\n");
+  printf("               or each line of standard input and exits with the batch exit codes\n");
+  printf("-send cmd      Command for the daemon, using the interactive commands plus :uart, :read, :until, :timeout and\n");
+  printf("               :shutdown (can be repeated)\n");
+  printf("-job spec      Queue a job, [cores=]file[,until=str][,timeout=s] where cores is a core list or #n for any n free\n");
+  printf("               cores (default #1). Jobs start as their cores free up and each writes its output to job_n.out\n");
+  printf("               (in the -output directory if given), exiting once all have finished (can be repeated, with\n");
+  printf("               -connect the jobs are queued on the daemon)\n");
+  printf("-benchmark     Benchmark the device's memory transfers (overwriting device memory), writing CSV results to stdout\n");
+  printf("-benchiters n  Maximum number of calls per core for each benchmark case (default %d)\n", DEFAULT_BENCHMARK_ITERATIONS);
+  printf("-nocache       Always transfer the whole executable, rather than only the blocks that changed since the last upload\n");
   printf("-reset         Reset device\n");
   printf("-config        Display configuration information\n");
   printf("-help          Display this help and quit\n");
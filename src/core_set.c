@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "core_set.h"
+
+/**
+ * Sets of cores as bitsets sized at runtime to the number of cores on the device. Counting is a popcount per word and
+ * iteration skips straight to the next set bit, so loops over the active cores cost nothing for inactive ones however
+ * many cores the device has. Sets that are combined must have been initialised with the same number of cores
+ */
+
+#define CORE_SET_WORD_BITS 64
+
+static int get_word_index(int);
+static uint64_t get_bit(int);
+
+void initialise_core_set(struct core_set * set, int number_cores) {
+  set->number_cores=number_cores;
+  set->num_words=(number_cores + CORE_SET_WORD_BITS - 1) / CORE_SET_WORD_BITS;
+  set->words=(uint64_t*) calloc(set->num_words > 0 ? set->num_words : 1, sizeof(uint64_t));
+  if (set->words == NULL) {
+    fprintf(stderr, "Error allocating memory for a set of %d cores\n", number_cores);
+    exit(-1);
+  }
+}
+
+/**
+ * Sets up the set over a driver core mask, without copying it, so that the mask is read with the set operations. The
+ * set must not be changed or freed
+ */
+void view_core_mask_as_set(struct core_set * set, const uint64_t * core_mask, int number_cores) {
+  set->number_cores=number_cores;
+  set->num_words=(number_cores + CORE_SET_WORD_BITS - 1) / CORE_SET_WORD_BITS;
+  set->words=(uint64_t*) core_mask;
+}
+
+void free_core_set(struct core_set * set) {
+  free(set->words);
+  set->words=NULL;
+  set->number_cores=set->num_words=0;
+}
+
+void copy_core_set(struct core_set * target, struct core_set * source) {
+  memcpy(target->words, source->words, sizeof(uint64_t) * target->num_words);
+}
+
+void clear_core_set(struct core_set * set) {
+  memset(set->words, 0, sizeof(uint64_t) * set->num_words);
+}
+
+void fill_core_set(struct core_set * set) {
+  for (int i=0;i<set->num_words;i++) set->words[i]=~0ULL;
+  // Bits beyond the last core stay clear so that counts and comparisons of whole words remain correct
+  if (set->number_cores % CORE_SET_WORD_BITS != 0) set->words[set->num_words-1]=get_bit(set->number_cores) - 1;
+}
+
+void add_core_to_set(struct core_set * set, int core_id) {
+  set->words[get_word_index(core_id)]|=get_bit(core_id);
+}
+
+void remove_core_from_set(struct core_set * set, int core_id) {
+  set->words[get_word_index(core_id)]&=~get_bit(core_id);
+}
+
+bool is_core_in_set(struct core_set * set, int core_id) {
+  if (core_id < 0 || core_id >= set->number_cores) return false;
+  return (set->words[get_word_index(core_id)] & get_bit(core_id)) != 0;
+}
+
+bool are_core_sets_equal(struct core_set * first, struct core_set * second) {
+  return memcmp(first->words, second->words, sizeof(uint64_t) * first->num_words) == 0;
+}
+
+int count_cores_in_set(struct core_set * set) {
+  int count=0;
+  for (int i=0;i<set->num_words;i++) count+=__builtin_popcountll(set->words[i]);
+  return count;
+}
+
+/**
+ * Returns the lowest core in the set at or above from, or -1 if there is none. Iterate with
+ * for (int i=next_core_in_set(set, 0);i>=0;i=next_core_in_set(set, i+1))
+ */
+int next_core_in_set(struct core_set * set, int from) {
+  if (from >= set->number_cores) return -1;
+  int word_index=get_word_index(from);
+  // Mask off the cores below from in the first word, then scan for the first non-empty word
+  uint64_t word=set->words[word_index] & ~(get_bit(from) - 1);
+  while (word == 0) {
+    if (++word_index >= set->num_words) return -1;
+    word=set->words[word_index];
+  }
+  return (word_index * CORE_SET_WORD_BITS) + __builtin_ctzll(word);
+}
+
+/**
+ * Fills the array, which must have room for the set's number of cores, with the cores in ascending order and returns
+ * how many there are
+ */
+int get_cores_in_set(struct core_set * set, int * cores) {
+  int num_cores=0;
+  for (int i=next_core_in_set(set, 0);i>=0;i=next_core_in_set(set, i+1)) cores[num_cores++]=i;
+  return num_cores;
+}
+
+void union_core_sets(struct core_set * target, struct core_set * source) {
+  for (int i=0;i<target->num_words;i++) target->words[i]|=source->words[i];
+}
+
+void intersect_core_sets(struct core_set * target, struct core_set * source) {
+  for (int i=0;i<target->num_words;i++) target->words[i]&=source->words[i];
+}
+
+void subtract_core_sets(struct core_set * target, struct core_set * source) {
+  for (int i=0;i<target->num_words;i++) target->words[i]&=~source->words[i];
+}
+
+static int get_word_index(int core_id) {
+  return core_id / CORE_SET_WORD_BITS;
+}
+
+static uint64_t get_bit(int core_id) {
+  return 1ULL << (core_id % CORE_SET_WORD_BITS);
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "core_sweeper.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "core_set.h"
+#include "uart_poll.h"
+
+/**
+ * Runs a sweep over the polled cores in the background for modules serving what the cores post in device memory. Each
+ * sweep is made under the sweeper's lock, which the owner also holds to read its statistics or to sweep explicitly.
+ * Whilst sweeps find something to do the thread keeps sweeping, otherwise the interval between them doubles from the
+ * minimum up to the maximum. The thread only sweeps whilst UART polling is on, so the cores are left alone once they
+ * have been stopped and the device may be reset or finalised
+ */
+
+static void * core_sweeper_thread(void*);
+
+void initialise_core_sweeper(struct core_sweeper * sweeper, struct launchpad_configuration * config, struct device_configuration * device_config,
+      struct device_drivers * active_device_drivers) {
+  sweeper->config=config;
+  sweeper->drivers=*active_device_drivers;
+  initialise_core_set(&sweeper->cores, device_config->number_cores);
+  sweeper->in_background=false;
+  pthread_mutex_init(&sweeper->mutex, NULL);
+}
+
+void start_core_sweeper(struct core_sweeper * sweeper, unsigned int min_interval_us, unsigned int max_interval_us, core_sweep sweep, char * name) {
+  sweeper->min_interval_us=min_interval_us;
+  sweeper->max_interval_us=max_interval_us;
+  sweeper->sweep=sweep;
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, &core_sweeper_thread, sweeper)) {
+    fprintf(stderr, "Error creating %s thread\n", name);
+    exit(-1);
+  }
+  pthread_detach(thread);
+}
+
+/**
+ * Sweeps the polled cores once whether or not polling is on, such as to drain what the cores posted just before they
+ * stopped. Returns whether there was anything to do
+ */
+bool run_core_sweep(struct core_sweeper * sweeper) {
+  pthread_mutex_lock(&sweeper->mutex);
+  get_uart_poll_cores(sweeper->config, &sweeper->cores);
+  bool swept=sweeper->sweep(sweeper);
+  pthread_mutex_unlock(&sweeper->mutex);
+  return swept;
+}
+
+/**
+ * Called by a sweep having just taken a core's lock, returns whether it may go on to the core. A background sweep stops
+ * once polling has, as the device may have been reset or finalised whilst it waited on the lock
+ */
+bool continue_core_sweep(struct core_sweeper * sweeper) {
+  return !sweeper->in_background || is_uart_polling();
+}
+
+void lock_core_sweeper(struct core_sweeper * sweeper) {
+  pthread_mutex_lock(&sweeper->mutex);
+}
+
+void unlock_core_sweeper(struct core_sweeper * sweeper) {
+  pthread_mutex_unlock(&sweeper->mutex);
+}
+
+static void * core_sweeper_thread(void * args) {
+  struct core_sweeper * sweeper=(struct core_sweeper*) args;
+  unsigned int interval_us=sweeper->min_interval_us;
+  while (true) {
+    bool swept=false;
+    if (is_uart_polling()) {
+      pthread_mutex_lock(&sweeper->mutex);
+      sweeper->in_background=true;
+      get_uart_poll_cores(sweeper->config, &sweeper->cores);
+      swept=sweeper->sweep(sweeper);
+      sweeper->in_background=false;
+      pthread_mutex_unlock(&sweeper->mutex);
+    }
+    if (swept) {
+      interval_us=sweeper->min_interval_us;
+    } else {
+      usleep(interval_us);
+      interval_us=interval_us * 2 < sweeper->max_interval_us ? interval_us * 2 : sweeper->max_interval_us;
+    }
+  }
+  return NULL;
+}
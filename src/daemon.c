@@ -0,0 +1,596 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "daemon.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "util.h"
+#include "device_lock.h"
+#include "board.h"
+#include "uart_poll.h"
+#include "uart_ring.h"
+#include "uart_headless.h"
+#include "loader.h"
+#include "upload_cache.h"
+#include "dataset.h"
+#include "job_queue.h"
+#include "telemetry.h"
+#include "mailbox.h"
+#include "file_proxy.h"
+
+#define DAEMON_LISTEN_BACKLOG 16
+#define DAEMON_READ_LINE_BYTES 32
+
+/**
+ * Daemon mode keeps the device initialised between runs and serves commands from local clients over a Unix domain
+ * socket, so back to back runs skip device bring-up. A command is a line holding one of the interactive commands, with
+ * the same semantics, or :uart to stream the running cores' output as batch mode does, :read to read data memory,
+ * :until and :timeout to set when a stream completes, :job, :jobs and :jobwait to queue and follow jobs and
+ * :shutdown to stop the daemon. Any output is followed by a
+ * single status line, which is OK or ERROR followed by a message, or TIMEOUT where a stream did not complete in time.
+ * Clients are served one at a time, each for as long as it stays connected
+ */
+
+enum daemon_command_status { DAEMON_CONTINUE, DAEMON_DISCONNECT, DAEMON_SHUTDOWN };
+enum daemon_core_change { DAEMON_ENABLE_CORES, DAEMON_SET_CORES, DAEMON_DISABLE_CORES };
+
+struct daemon_context {
+  struct launchpad_configuration * config;
+  struct device_configuration * device_config;
+  struct device_drivers * active_device_drivers;
+  struct current_device_status * device_status;
+};
+
+static int open_daemon_socket(char*);
+static enum daemon_command_status serve_client(struct daemon_context*, int);
+static enum daemon_command_status handle_daemon_command(struct daemon_context*, char*, FILE*);
+static void set_executable(struct daemon_context*, char*, FILE*);
+static void change_cores(struct daemon_context*, char*, enum daemon_core_change, FILE*);
+static void handle_dataset(struct daemon_context*, char*, bool, FILE*);
+static void start_daemon_cores(struct daemon_context*, FILE*);
+static void stop_daemon_cores(struct daemon_context*, FILE*);
+static void reset_daemon_device(struct daemon_context*, FILE*);
+static void stream_uart(struct daemon_context*, FILE*);
+static void read_data(struct daemon_context*, char*, FILE*);
+static void set_sentinel(struct daemon_context*, char*, FILE*);
+static void set_timeout(struct daemon_context*, char*, FILE*);
+static void submit_daemon_job(struct daemon_context*, char*, FILE*);
+static void wait_for_daemon_jobs(FILE*);
+static bool check_job_queue_idle(FILE*);
+static void export_telemetry(char*, FILE*);
+static void send_status(struct daemon_context*, FILE*);
+static void send_config(struct daemon_context*, FILE*);
+static void send_statistics(struct daemon_context*, FILE*);
+static void send_help(FILE*);
+static void discard_uart_output(struct daemon_context*);
+static void reply(FILE*, char*, char*);
+static bool check_daemon_call(LP_STATUS_CODE, char*, FILE*);
+static bool check_command_portion(char*, char*);
+static char * get_arg_portion(char*);
+
+int run_daemon(struct launchpad_configuration * config, struct device_configuration * device_config,
+      struct device_drivers * active_device_drivers, struct current_device_status * device_status) {
+  // A client that goes away is noticed as a failed write rather than ending the daemon
+  signal(SIGPIPE, SIG_IGN);
+  int listen_fd=open_daemon_socket(config->daemon_socket);
+  start_uart_pollers(config, device_config, active_device_drivers, device_status->running);
+  if (device_config->communication_type == LP_DEVICE_COMM_UART) {
+    initialise_job_queue(config, device_config, active_device_drivers);
+    char message[JOB_MESSAGE_SIZE];
+    for (int i=0;i<config->num_jobs;i++) {
+      if (!submit_job(config->job_specs[i], message)) {
+        fprintf(stderr, "Error, %s\n", message);
+        exit(-1);
+      }
+    }
+  }
+  fprintf(stderr, "Launchpad daemon listening on '%s'\n", config->daemon_socket);
+
+  struct daemon_context context={config, device_config, active_device_drivers, device_status};
+  while (true) {
+    int client_fd=accept(listen_fd, NULL, NULL);
+    if (client_fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      fprintf(stderr, "Error accepting a daemon client: %s\n", strerror(errno));
+      break;
+    }
+    if (serve_client(&context, client_fd) == DAEMON_SHUTDOWN) break;
+  }
+  close(listen_fd);
+  unlink(config->daemon_socket);
+  lock_device();
+  if (device_status->running || is_job_queue_busy()) check_device_status(active_device_drivers->device_stop_allcores());
+  set_uart_polling(false);
+  check_device_status(active_device_drivers->device_finalise());
+  unlock_device();
+  if (device_status->running) end_energy_run();
+  fprintf(stderr, "Launchpad daemon shut down\n");
+  return 0;
+}
+
+static int open_daemon_socket(char * socket_path) {
+  struct sockaddr_un address;
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Error, daemon socket path '%s' is too long\n", socket_path);
+    exit(-1);
+  }
+  memset(&address, 0, sizeof(struct sockaddr_un));
+  address.sun_family=AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+  int listen_fd=socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    fprintf(stderr, "Error creating daemon socket: %s\n", strerror(errno));
+    exit(-1);
+  }
+  // A socket left behind by a daemon that has exited is replaced, but not one that a daemon is still serving
+  if (connect(listen_fd, (struct sockaddr*) &address, sizeof(struct sockaddr_un)) == 0) {
+    fprintf(stderr, "Error, there is already a daemon listening on '%s'\n", socket_path);
+    exit(-1);
+  }
+  close(listen_fd);
+  unlink(socket_path);
+  listen_fd=socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*) &address, sizeof(struct sockaddr_un)) < 0 || listen(listen_fd, DAEMON_LISTEN_BACKLOG) < 0) {
+    fprintf(stderr, "Error listening on daemon socket '%s': %s\n", socket_path, strerror(errno));
+    exit(-1);
+  }
+  return listen_fd;
+}
+
+static enum daemon_command_status serve_client(struct daemon_context * context, int client_fd) {
+  FILE * input=fdopen(client_fd, "r");
+  FILE * output=fdopen(dup(client_fd), "w");
+  if (input == NULL || output == NULL) {
+    fprintf(stderr, "Error opening daemon client connection: %s\n", strerror(errno));
+    if (input != NULL) fclose(input); else close(client_fd);
+    if (output != NULL) fclose(output);
+    return DAEMON_CONTINUE;
+  }
+  char command[DAEMON_COMMAND_SIZE];
+  enum daemon_command_status status=DAEMON_CONTINUE;
+  while (status == DAEMON_CONTINUE && fgets(command, DAEMON_COMMAND_SIZE, input) != NULL) {
+    command[strcspn(command, "\r\n")]='\0';
+    if (strlen(command) == 0) continue;
+    status=handle_daemon_command(context, command, output);
+    fflush(output);
+    if (status == DAEMON_CONTINUE && ferror(output)) status=DAEMON_DISCONNECT;
+  }
+  fclose(input);
+  fclose(output);
+  return status;
+}
+
+static enum daemon_command_status handle_daemon_command(struct daemon_context * context, char * buffer, FILE * output) {
+  if (strcmp(buffer, ":q")==0 || strcmp(buffer, ":quit")==0) {
+    reply(output, "OK", "Disconnected");
+    return DAEMON_DISCONNECT;
+  } else if (strcmp(buffer, ":shutdown")==0) {
+    reply(output, "OK", "Daemon shutting down");
+    return DAEMON_SHUTDOWN;
+  } else if (strcmp(buffer, ":h")==0 || strcmp(buffer, ":help")==0) {
+    send_help(output);
+  } else if (strcmp(buffer, ":status")==0) {
+    send_status(context, output);
+  } else if (strcmp(buffer, ":config")==0) {
+    send_config(context, output);
+  } else if (strcmp(buffer, ":stats")==0) {
+    send_statistics(context, output);
+  } else if (strcmp(buffer, ":reset")==0) {
+    if (check_job_queue_idle(output)) reset_daemon_device(context, output);
+  } else if (strcmp(buffer, ":stop")==0) {
+    if (check_job_queue_idle(output)) stop_daemon_cores(context, output);
+  } else if (strcmp(buffer, ":start")==0) {
+    if (check_job_queue_idle(output)) start_daemon_cores(context, output);
+  } else if (check_command_portion(buffer, ":job")) {
+    submit_daemon_job(context, get_arg_portion(buffer), output);
+  } else if (strcmp(buffer, ":jobs")==0) {
+    describe_jobs(output);
+    reply(output, "OK", "Jobs listed");
+  } else if (strcmp(buffer, ":jobwait")==0) {
+    wait_for_daemon_jobs(output);
+  } else if (strcmp(buffer, ":uart")==0) {
+    stream_uart(context, output);
+  } else if (check_command_portion(buffer, ":e") || check_command_portion(buffer, ":enable")) {
+    change_cores(context, get_arg_portion(buffer), DAEMON_ENABLE_CORES, output);
+  } else if (check_command_portion(buffer, ":c") || check_command_portion(buffer, ":cores")) {
+    change_cores(context, get_arg_portion(buffer), DAEMON_SET_CORES, output);
+  } else if (check_command_portion(buffer, ":d") || check_command_portion(buffer, ":disable")) {
+    change_cores(context, get_arg_portion(buffer), DAEMON_DISABLE_CORES, output);
+  } else if (strcmp(buffer, ":data")==0 || check_command_portion(buffer, ":data") || check_command_portion(buffer, ":shard")) {
+    handle_dataset(context, get_arg_portion(buffer), check_command_portion(buffer, ":shard"), output);
+  } else if (check_command_portion(buffer, ":bin") || check_command_portion(buffer, ":exe")) {
+    set_executable(context, get_arg_portion(buffer), output);
+  } else if (check_command_portion(buffer, ":read")) {
+    read_data(context, get_arg_portion(buffer), output);
+  } else if (strcmp(buffer, ":until")==0 || check_command_portion(buffer, ":until")) {
+    set_sentinel(context, get_arg_portion(buffer), output);
+  } else if (check_command_portion(buffer, ":telemetry")) {
+    export_telemetry(get_arg_portion(buffer), output);
+  } else if (check_command_portion(buffer, ":timeout")) {
+    set_timeout(context, get_arg_portion(buffer), output);
+  } else {
+    reply(output, "ERROR", "Command not recognised, use :h for help");
+  }
+  return DAEMON_CONTINUE;
+}
+
+static void set_executable(struct daemon_context * context, char * args, FILE * output) {
+  if (context->device_status->running) {
+    reply(output, "ERROR", "Can only change executable in a stopped state, stop running cores first");
+    return;
+  }
+  if (access(args, F_OK) != 0) {
+    reply(output, "ERROR", "Specified file does not exist");
+    return;
+  }
+  struct launchpad_configuration * config=context->config;
+  if (config->executable_filename != NULL) free(config->executable_filename);
+  config->executable_filename=(char*) malloc(sizeof(char) * strlen(args)+1);
+  strcpy(config->executable_filename, args);
+  char message[DAEMON_MESSAGE_SIZE];
+  snprintf(message, DAEMON_MESSAGE_SIZE, "Successfully changed executable to '%s'", config->executable_filename);
+  reply(output, "OK", message);
+}
+
+/**
+ * Enabling is additive, setting replaces the enabled cores and disabling removes from them, as in interactive mode
+ */
+static void change_cores(struct daemon_context * context, char * args, enum daemon_core_change change, FILE * output) {
+  if (context->device_status->running) {
+    reply(output, "ERROR", "Can only change active cores in a stopped state, stop running cores first");
+    return;
+  }
+  struct core_set cores;
+  initialise_core_set(&cores, context->device_config->number_cores);
+  if (!parseCoreInfoString(args, &cores)) {
+    free_core_set(&cores);
+    reply(output, "ERROR", "Invalid core list, cores are given as a single id, all, a range (a:b) or a list of these");
+    return;
+  }
+  struct core_set * active_cores=&context->config->active_cores;
+  if (change == DAEMON_ENABLE_CORES) {
+    union_core_sets(active_cores, &cores);
+  } else if (change == DAEMON_SET_CORES) {
+    copy_core_set(active_cores, &cores);
+  } else {
+    subtract_core_sets(active_cores, &cores);
+  }
+  free_core_set(&cores);
+  char message[DAEMON_MESSAGE_SIZE];
+  sprintf(message, "There are now %d cores enabled", count_cores_in_set(active_cores));
+  reply(output, "OK", message);
+}
+
+static void handle_dataset(struct daemon_context * context, char * args, bool sharded, FILE * output) {
+  char message[DATASET_MESSAGE_SIZE];
+  if (args == NULL || strlen(args) == 0) {
+    size_t description_size=get_datasets_description_size();
+    char * description=(char*) malloc(sizeof(char) * description_size);
+    describe_datasets(description, description_size);
+    fprintf(output, "%s\n", description);
+    free(description);
+    reply(output, "OK", "Datasets listed");
+    return;
+  }
+  if (strcmp(args, "clear") == 0) {
+    clear_datasets();
+    reply(output, "OK", "All datasets removed");
+    return;
+  }
+  reply(output, add_dataset(context->device_config, args, sharded, message) ? "OK" : "ERROR", message);
+}
+
+static void start_daemon_cores(struct daemon_context * context, FILE * output) {
+  struct launchpad_configuration * config=context->config;
+  if (context->device_status->running) {
+    reply(output, "ERROR", "Cores are already running");
+    return;
+  }
+  if (count_cores_in_set(&config->active_cores) == 0) {
+    reply(output, "ERROR", "No cores are enabled, enable at-least one before starting");
+    return;
+  }
+  if (config->executable_filename == NULL) {
+    reply(output, "ERROR", "No executable file has been specified, you must provide this to start the cores");
+    return;
+  }
+  transfer_executable_to_device(config, context->device_config, context->active_device_drivers);
+  char message[DATASET_MESSAGE_SIZE];
+  if (!stage_datasets(config, context->device_config, context->active_device_drivers, message)) {
+    reply(output, "ERROR", message);
+    return;
+  }
+  // Output left from a previous run must not be streamed as this run's
+  discard_uart_output(context);
+  lock_device();
+  int num_started=start_cores(config, context->device_config, context->active_device_drivers, context->device_status);
+  set_uart_polling(true);
+  unlock_device();
+  char load_summary[DAEMON_MESSAGE_SIZE], started_message[DAEMON_MESSAGE_SIZE + 32];
+  describe_load_statistics(load_summary);
+  sprintf(started_message, "%d cores started, %s", num_started, load_summary);
+  reply(output, "OK", started_message);
+}
+
+static void stop_daemon_cores(struct daemon_context * context, FILE * output) {
+  if (!context->device_status->running) {
+    reply(output, "ERROR", "Cores are already stopped");
+    return;
+  }
+  lock_device();
+  if (!check_daemon_call(context->active_device_drivers->device_stop_allcores(), "stopping the cores", output)) {
+    unlock_device();
+    return;
+  }
+  set_uart_polling(false);
+  unlock_device();
+  end_energy_run();
+  clear_core_set(&context->device_status->cores_active);
+  context->device_status->running=false;
+  reply(output, "OK", "All cores stopped and idle");
+}
+
+static void reset_daemon_device(struct daemon_context * context, FILE * output) {
+  lock_device();
+  // Whether or not the reset succeeds the device's memory and the state of its cores are no longer known
+  invalidate_upload_cache();
+  set_uart_polling(false);
+  bool reset=check_daemon_call(context->active_device_drivers->device_reset(), "resetting the device", output) &&
+    check_daemon_call(context->active_device_drivers->device_initialise(), "initialising the device", output);
+  unlock_device();
+  if (context->device_status->running) end_energy_run();
+  clear_core_set(&context->device_status->cores_active);
+  context->device_status->running=false;
+  if (reset) reply(output, "OK", "Reset successful, cores all idle");
+}
+
+/**
+ * Streams the output of the enabled cores until they complete, as batch mode does, but leaves them running
+ */
+static void stream_uart(struct daemon_context * context, FILE * output) {
+  if (context->device_config->communication_type != LP_DEVICE_COMM_UART) {
+    reply(output, "ERROR", "The device does not communicate over UART");
+    return;
+  }
+  if (!context->device_status->running) {
+    reply(output, "ERROR", "Cores are not running, start them first");
+    return;
+  }
+  int exit_code=stream_uart_output(context->config, context->device_config, context->active_device_drivers, context->device_status, output, false);
+  char message[DAEMON_MESSAGE_SIZE];
+  if (exit_code == LP_BATCH_EXIT_TIMEOUT) {
+    sprintf(message, "Cores did not complete within %d seconds", context->config->batch_timeout_sec);
+    reply(output, "TIMEOUT", message);
+  } else {
+    reply(output, "OK", "Cores completed");
+  }
+}
+
+/**
+ * Reads data memory as hexadecimal, args are the address, number of bytes and optionally the core (otherwise
+ * shared data memory is read)
+ */
+static void read_data(struct daemon_context * context, char * args, FILE * output) {
+  char * end;
+  uint64_t address=strtoull(args, &end, 0);
+  uint64_t size=end != args ? strtoull(end, &end, 0) : 0;
+  int core_id=-1;
+  while (*end == ' ') end++;
+  if (*end != '\0') {
+    struct core_set core;
+    initialise_core_set(&core, context->device_config->number_cores);
+    if (parseCoreInfoString(end, &core) && count_cores_in_set(&core) == 1) core_id=next_core_in_set(&core, 0);
+    free_core_set(&core);
+    if (core_id < 0) {
+      reply(output, "ERROR", "Invalid core, a single core must be given");
+      return;
+    }
+  }
+  if (size == 0 || size > DAEMON_MAX_READ_BYTES) {
+    reply(output, "ERROR", "Must provide an address and a size of up to 1MB to read");
+    return;
+  }
+  // Reads are checked against the memory size here as an out of range read is an error from the driver
+  uint64_t memory_size=core_id >= 0 ? (uint64_t) context->device_config->per_core_data_space_mb * 1024 * 1024 :
+    (uint64_t) context->device_config->shared_data_space_kb * 1024;
+  if (address >= memory_size || size > memory_size - address) {
+    char message[DAEMON_MESSAGE_SIZE];
+    sprintf(message, "The read must lie within the %s data memory of 0x%lx bytes", core_id >= 0 ? "core's" : "shared", memory_size);
+    reply(output, "ERROR", message);
+    return;
+  }
+  char * data=(char*) malloc(sizeof(char) * size);
+  bool read;
+  if (core_id >= 0) {
+    lock_device_core(core_id);
+    read=check_daemon_call(context->active_device_drivers->device_read_core_data(core_id, address, data, size), "reading data memory", output);
+    unlock_device_core(core_id);
+  } else {
+    lock_device();
+    read=check_daemon_call(context->active_device_drivers->device_read_data(address, data, size), "reading data memory", output);
+    unlock_device();
+  }
+  if (!read) {
+    free(data);
+    return;
+  }
+  for (uint64_t i=0;i<size;i++) {
+    if (i % DAEMON_READ_LINE_BYTES == 0) fprintf(output, "%s0x%08lx:", i > 0 ? "\n" : "", address + i);
+    fprintf(output, " %02x", (unsigned char) data[i]);
+  }
+  fprintf(output, "\n");
+  free(data);
+  char message[DAEMON_MESSAGE_SIZE];
+  sprintf(message, "Read %ld bytes", size);
+  reply(output, "OK", message);
+}
+
+// Without a sentinel a stream completes once the cores have stopped
+static void set_sentinel(struct daemon_context * context, char * args, FILE * output) {
+  struct launchpad_configuration * config=context->config;
+  // The sentinel given on the command line is not ours to free
+  static char * allocated_sentinel=NULL;
+  if (allocated_sentinel != NULL) free(allocated_sentinel);
+  allocated_sentinel=NULL;
+  if (args == NULL || strlen(args) == 0) {
+    config->batch_sentinel=NULL;
+    reply(output, "OK", "Streams complete when the cores stop");
+    return;
+  }
+  allocated_sentinel=(char*) malloc(sizeof(char) * strlen(args)+1);
+  strcpy(allocated_sentinel, args);
+  config->batch_sentinel=allocated_sentinel;
+  reply(output, "OK", "Streams complete when every core has printed the sentinel");
+}
+
+static void set_timeout(struct daemon_context * context, char * args, FILE * output) {
+  context->config->batch_timeout_sec=atoi(args);
+  char message[DAEMON_MESSAGE_SIZE];
+  sprintf(message, "Stream timeout is now %d seconds", context->config->batch_timeout_sec);
+  reply(output, "OK", message);
+}
+
+/**
+ * Queues a job, which runs on free cores alongside others whilst the cores are not started by hand
+ */
+static void submit_daemon_job(struct daemon_context * context, char * args, FILE * output) {
+  if (context->device_config->communication_type != LP_DEVICE_COMM_UART) {
+    reply(output, "ERROR", "Jobs need a device that communicates over UART");
+    return;
+  }
+  if (context->device_status->running) {
+    reply(output, "ERROR", "Can only queue jobs in a stopped state, stop running cores first");
+    return;
+  }
+  char message[JOB_MESSAGE_SIZE];
+  reply(output, submit_job(args, message) ? "OK" : "ERROR", message);
+}
+
+static void wait_for_daemon_jobs(FILE * output) {
+  if (wait_for_jobs() == LP_BATCH_EXIT_TIMEOUT) {
+    reply(output, "TIMEOUT", "All jobs finished, but some timed out");
+  } else {
+    reply(output, "OK", "All jobs complete");
+  }
+}
+
+// Starting, stopping and resetting by hand would pull the cores from under queued jobs
+static bool check_job_queue_idle(FILE * output) {
+  if (!is_job_queue_busy()) return true;
+  reply(output, "ERROR", "Jobs are queued or running, wait for them with :jobwait first");
+  return false;
+}
+
+/**
+ * Writes the board telemetry samples to a CSV file, as a path on the daemon's host
+ */
+static void export_telemetry(char * filename, FILE * output) {
+  char message[TELEMETRY_MESSAGE_SIZE];
+  reply(output, export_telemetry_csv(filename, message) ? "OK" : "ERROR", message);
+}
+
+static void send_status(struct daemon_context * context, FILE * output) {
+  fprintf(output, "Soft cores currently %s\n", context->device_status->running ? "running" : "stopped");
+  for (int i=0;i<context->device_config->number_cores;i++) {
+    char core_name[BOARD_CORE_NAME_SIZE];
+    describe_core(i, core_name);
+    fprintf(output, "Core %s: %s (%s)\n", core_name, is_core_in_set(&context->device_status->cores_active, i) ? "active" : "inactive",
+      is_core_in_set(&context->config->active_cores, i) ? "enabled" : "disabled");
+  }
+  fprintf(output, "Executable: %s\n", context->config->executable_filename != NULL ? context->config->executable_filename : "none");
+  char energy_summary[TELEMETRY_MESSAGE_SIZE];
+  describe_energy(energy_summary);
+  fprintf(output, "%s\n", energy_summary);
+  if (is_mailbox_enabled()) {
+    char mailbox_summary[MAILBOX_MESSAGE_SIZE];
+    describe_mailboxes(mailbox_summary);
+    fprintf(output, "%s\n", mailbox_summary);
+  }
+  if (is_file_proxy_enabled()) {
+    char file_proxy_summary[FILE_PROXY_MESSAGE_SIZE];
+    describe_file_proxy(file_proxy_summary);
+    fprintf(output, "%s\n", file_proxy_summary);
+  }
+  reply(output, "OK", "Status listed");
+}
+
+static void send_config(struct daemon_context * context, FILE * output) {
+  char * config_str=(char*) malloc(sizeof(char) * CONFIGURATION_STR_SIZE);
+  generate_device_configuration(context->device_config, context->active_device_drivers, config_str);
+  fprintf(output, "%s", config_str);
+  free(config_str);
+  reply(output, "OK", "Configuration listed");
+}
+
+static void send_statistics(struct daemon_context * context, FILE * output) {
+  char * statistics=(char*) malloc(sizeof(char) * UART_STATISTICS_LINE_SIZE * (context->device_config->number_cores + 2));
+  describe_uart_statistics(context->config, context->device_config, statistics);
+  fprintf(output, "%s", statistics);
+  free(statistics);
+  reply(output, "OK", "Statistics listed");
+}
+
+static void send_help(FILE * output) {
+  fprintf(output, "Launchpad daemon commands, each is followed by a status line of OK, ERROR or TIMEOUT and a message\n");
+  fprintf(output, ":status          - Current soft core status including active and enabled cores\n");
+  fprintf(output, ":config          - Soft core CPU and board configuration and status\n");
+  fprintf(output, ":stats           - UART pipeline statistics, per core throughput and polling\n");
+  fprintf(output, ":stop            - Stop all cores\n");
+  fprintf(output, ":start           - Start all enabled cores\n");
+  fprintf(output, ":exe, :bin       - Specify the binary executable that cores should run, as a path on the daemon's host\n");
+  fprintf(output, ":data spec       - Add a dataset staged into data memory on start, :data lists and :data clear removes all\n");
+  fprintf(output, ":shard spec      - Add a single file dataset split into one slice per core\n");
+  fprintf(output, ":e, :enable      - Enables core(s) provided as a singleton, list or range (does not start)\n");
+  fprintf(output, ":c, :cores       - Sets core(s) provided as a singleton, list or range as the active set (does not start)\n");
+  fprintf(output, ":d, :disable     - Disables core(s) provided as a singleton, list or range (does not stop)\n");
+  fprintf(output, ":uart            - Stream the enabled cores' output until they complete (does not stop)\n");
+  fprintf(output, ":until [str]     - Streams complete once every core prints this, or when they stop if not given\n");
+  fprintf(output, ":timeout s       - Streams end with TIMEOUT after s seconds, 0 for no timeout\n");
+  fprintf(output, ":read addr n [c] - Read n bytes of core c's data memory, or shared data memory, as hexadecimal\n");
+  fprintf(output, ":job spec        - Queue [cores=]file[,until=str][,timeout=s] to run on a core list or #n free cores\n");
+  fprintf(output, ":jobs            - List queued, running and finished jobs with their wait and run times\n");
+  fprintf(output, ":jobwait         - Wait until every queued job has finished\n");
+  fprintf(output, ":telemetry file  - Write the board temperature and power samples to a CSV file on the daemon's host\n");
+  fprintf(output, ":reset           - Reset device and stop all cores\n");
+  fprintf(output, ":q, :quit        - Disconnect, leaving the daemon running\n");
+  fprintf(output, ":shutdown        - Stop the daemon\n");
+  reply(output, "OK", "Help listed");
+}
+
+static void discard_uart_output(struct daemon_context * context) {
+  for (int i=0;i<context->device_config->number_cores;i++) uart_ring_discard(get_uart_output_ring(i));
+}
+
+static void reply(FILE * output, char * status, char * message) {
+  fprintf(output, "%s %s\n", status, message);
+}
+
+/**
+ * A failed device call is replied to the client as an error rather than ending the daemon, returning whether the call
+ * succeeded
+ */
+static bool check_daemon_call(LP_STATUS_CODE status, char * action, FILE * output) {
+  if (status == LP_SUCCESS) return true;
+  char message[DAEMON_MESSAGE_SIZE];
+  sprintf(message, "The device reported an error %s", action);
+  reply(output, "ERROR", message);
+  return false;
+}
+
+static bool check_command_portion(char * buffer, char * command) {
+  if (strncmp(buffer, command, strlen(command)) != 0) return false;
+  // This ensures there is whitespace next, i.e. this is the command portion and not just part of the command
+  return buffer[strlen(command)] == ' ';
+}
+
+static char * get_arg_portion(char * buffer) {
+  char * space=strchr(buffer, ' ');
+  if (space == NULL) return NULL;
+  return space+1;
+}
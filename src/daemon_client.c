@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "daemon.h"
+#include "configuration.h"
+#include "uart_headless.h"
+
+/**
+ * Thin client of the daemon, which never touches the device itself. Given an executable it performs a batch run on
+ * the daemon's device with the same arguments and exit codes as batch mode, otherwise it sends the -send commands or
+ * each line of standard input. Output from the daemon goes to stdout and its status messages to stderr
+ */
+
+static int connect_to_daemon(char*);
+static int run_on_daemon(struct launchpad_configuration*, FILE*, FILE*);
+static int run_jobs_on_daemon(struct launchpad_configuration*, FILE*, FILE*);
+static int send_command(FILE*, FILE*, char*, bool, bool);
+
+int run_daemon_client(struct launchpad_configuration * config) {
+  int socket_fd=connect_to_daemon(config->connect_socket);
+  FILE * input=fdopen(socket_fd, "r");
+  FILE * output=fdopen(dup(socket_fd), "w");
+  if (input == NULL || output == NULL) {
+    fprintf(stderr, "Error opening connection to the daemon: %s\n", strerror(errno));
+    return LP_BATCH_EXIT_ERROR;
+  }
+  int exit_code=LP_BATCH_EXIT_COMPLETE;
+  if (config->num_jobs > 0) {
+    exit_code=run_jobs_on_daemon(config, input, output);
+  } else if (config->executable_filename != NULL) {
+    exit_code=run_on_daemon(config, input, output);
+  } else if (config->num_client_commands > 0) {
+    for (int i=0;i<config->num_client_commands && exit_code == LP_BATCH_EXIT_COMPLETE;i++) {
+      exit_code=send_command(input, output, config->client_commands[i], true, true);
+    }
+  } else {
+    // Every line is sent, the exit code is that of the last command to fail
+    char command[DAEMON_COMMAND_SIZE];
+    while (fgets(command, DAEMON_COMMAND_SIZE, stdin) != NULL) {
+      command[strcspn(command, "\r\n")]='\0';
+      if (strlen(command) == 0) continue;
+      int command_exit_code=send_command(input, output, command, true, true);
+      if (command_exit_code != LP_BATCH_EXIT_COMPLETE) exit_code=command_exit_code;
+    }
+  }
+  fclose(input);
+  fclose(output);
+  return exit_code;
+}
+
+static int connect_to_daemon(char * socket_path) {
+  struct sockaddr_un address;
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Error, daemon socket path '%s' is too long\n", socket_path);
+    exit(LP_BATCH_EXIT_ERROR);
+  }
+  memset(&address, 0, sizeof(struct sockaddr_un));
+  address.sun_family=AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+  int socket_fd=socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_fd < 0 || connect(socket_fd, (struct sockaddr*) &address, sizeof(struct sockaddr_un)) < 0) {
+    fprintf(stderr, "Error connecting to the daemon on '%s': %s\n", socket_path, strerror(errno));
+    exit(LP_BATCH_EXIT_ERROR);
+  }
+  return socket_fd;
+}
+
+/**
+ * Configures the daemon as the command line would configure launchpad, then starts the cores, streams their output
+ * until they complete and stops them. Anything left running by an earlier client is stopped first
+ */
+static int run_on_daemon(struct launchpad_configuration * config, FILE * input, FILE * output) {
+  char executable[PATH_MAX], command[PATH_MAX + DAEMON_COMMAND_SIZE];
+  if (config->reset) {
+    if (send_command(input, output, ":reset", false, true) != LP_BATCH_EXIT_COMPLETE) return LP_BATCH_EXIT_ERROR;
+  } else {
+    send_command(input, output, ":stop", false, false);
+  }
+  // The daemon may run from another directory, so the executable is given by its absolute path
+  snprintf(command, sizeof(command), ":exe %s", realpath(config->executable_filename, executable) != NULL ? executable : config->executable_filename);
+  if (send_command(input, output, command, false, true) != LP_BATCH_EXIT_COMPLETE) return LP_BATCH_EXIT_ERROR;
+  if (config->active_cores_spec != NULL) {
+    snprintf(command, sizeof(command), ":c %s", config->active_cores_spec);
+    if (send_command(input, output, command, false, true) != LP_BATCH_EXIT_COMPLETE) return LP_BATCH_EXIT_ERROR;
+  }
+  if (send_command(input, output, ":data clear", false, true) != LP_BATCH_EXIT_COMPLETE) return LP_BATCH_EXIT_ERROR;
+  for (int i=0;i<config->num_datasets;i++) {
+    snprintf(command, sizeof(command), "%s %s", config->dataset_sharded[i] ? ":shard" : ":data", config->dataset_specs[i]);
+    if (send_command(input, output, command, false, true) != LP_BATCH_EXIT_COMPLETE) return LP_BATCH_EXIT_ERROR;
+  }
+  if (config->batch_sentinel != NULL) {
+    snprintf(command, sizeof(command), ":until %s", config->batch_sentinel);
+  } else {
+    strcpy(command, ":until");
+  }
+  if (send_command(input, output, command, false, true) != LP_BATCH_EXIT_COMPLETE) return LP_BATCH_EXIT_ERROR;
+  snprintf(command, sizeof(command), ":timeout %d", config->batch_timeout_sec);
+  if (send_command(input, output, command, false, true) != LP_BATCH_EXIT_COMPLETE) return LP_BATCH_EXIT_ERROR;
+  if (send_command(input, output, ":start", true, true) != LP_BATCH_EXIT_COMPLETE) return LP_BATCH_EXIT_ERROR;
+  int exit_code=send_command(input, output, ":uart", false, true);
+  send_command(input, output, ":stop", false, true);
+  return exit_code;
+}
+
+/**
+ * Queues the jobs on the daemon, with executables given by their absolute paths, then waits for every job queued there
+ * to finish and lists them
+ */
+static int run_jobs_on_daemon(struct launchpad_configuration * config, FILE * input, FILE * output) {
+  char executable[PATH_MAX], command[PATH_MAX + DAEMON_COMMAND_SIZE];
+  for (int i=0;i<config->num_jobs;i++) {
+    char spec[strlen(config->job_specs[i]) + 1];
+    strcpy(spec, config->job_specs[i]);
+    // The executable follows any cores= prefix and runs up to the first option
+    char * options=strchr(spec, ',');
+    if (options != NULL) *options++='\0';
+    char * file_portion=strchr(spec, '=');
+    if (file_portion != NULL) {
+      *file_portion++='\0';
+    } else {
+      file_portion=spec;
+    }
+    snprintf(command, sizeof(command), ":job %s%s%s%s%s", file_portion != spec ? spec : "", file_portion != spec ? "=" : "",
+      realpath(file_portion, executable) != NULL ? executable : file_portion, options != NULL ? "," : "", options != NULL ? options : "");
+    if (send_command(input, output, command, true, true) != LP_BATCH_EXIT_COMPLETE) return LP_BATCH_EXIT_ERROR;
+  }
+  int exit_code=send_command(input, output, ":jobwait", false, true);
+  send_command(input, output, ":jobs", false, true);
+  return exit_code;
+}
+
+/**
+ * Sends the command and passes on the daemon's reply, returning the batch exit code corresponding to its status. The
+ * status message is reported on success or failure as requested, timeouts are always reported
+ */
+static int send_command(FILE * input, FILE * output, char * command, bool report_success, bool report_failure) {
+  fprintf(output, "%s\n", command);
+  fflush(output);
+  char line[DAEMON_COMMAND_SIZE];
+  while (fgets(line, DAEMON_COMMAND_SIZE, input) != NULL) {
+    if (strncmp(line, "OK ", 3) == 0) {
+      if (report_success) fprintf(stderr, "%s", &line[3]);
+      return LP_BATCH_EXIT_COMPLETE;
+    } else if (strncmp(line, "ERROR ", 6) == 0) {
+      if (report_failure) fprintf(stderr, "Error, %s", &line[6]);
+      return LP_BATCH_EXIT_ERROR;
+    } else if (strncmp(line, "TIMEOUT ", 8) == 0) {
+      fprintf(stderr, "%s", &line[8]);
+      return LP_BATCH_EXIT_TIMEOUT;
+    }
+    fputs(line, stdout);
+  }
+  fflush(stdout);
+  fprintf(stderr, "Error, the daemon closed the connection\n");
+  return LP_BATCH_EXIT_ERROR;
+}
@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "dataset.h"
+#include "loader.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "core_set.h"
+
+/**
+ * Input datasets that are staged into the data memory of cores before they start, each is given as
+ * [cores=]filename[@offset]. Without a core list the dataset goes to whichever cores are active when staged. A
+ * dataset is either the same file written to every core, a file per core (the filename contains %d which is replaced
+ * by the core id) or one file sharded across the cores, where each core is given a contiguous, equally sized slice
+ * in core order. Datasets are staged in the order that they were added, and the offset is the address in each core's
+ * data memory. Per core files and slices are transferred concurrently across DDR banks
+ */
+
+struct dataset {
+  char * spec, * filename;
+  uint64_t offset;
+  bool sharded, per_core_files;
+  struct core_set * cores;
+};
+
+static struct dataset * datasets=NULL;
+static int number_datasets=0;
+
+static bool stage_dataset(struct device_configuration*, struct device_drivers*, struct dataset*, int*, int, char*);
+static bool open_dataset_file(char*, struct load_stream*, char*);
+static void build_core_filename(char*, int, char*);
+static bool check_dataset_fits(struct device_configuration*, struct dataset*, char*, uint64_t, char*);
+static bool is_shared_data(struct device_configuration*);
+static void free_dataset(struct dataset*);
+
+/**
+ * Parses and adds a dataset, returning false and setting the message if the description is invalid
+ */
+bool add_dataset(struct device_configuration * device_config, char * spec, bool sharded, char * message) {
+  struct dataset new_dataset;
+  memset(&new_dataset, 0, sizeof(struct dataset));
+  new_dataset.spec=(char*) malloc(sizeof(char) * (strlen(spec) + 1));
+  strcpy(new_dataset.spec, spec);
+  new_dataset.sharded=sharded;
+
+  char * file_portion=spec;
+  char * core_separator=strchr(spec, '=');
+  if (core_separator != NULL) {
+    char core_portion[core_separator - spec + 1];
+    memcpy(core_portion, spec, core_separator - spec);
+    core_portion[core_separator - spec]='\0';
+    new_dataset.cores=(struct core_set*) malloc(sizeof(struct core_set));
+    initialise_core_set(new_dataset.cores, device_config->number_cores);
+    if (!parseCoreInfoString(core_portion, new_dataset.cores)) {
+      snprintf(message, DATASET_MESSAGE_SIZE, "Invalid dataset cores '%s', the device has %d cores numbered from 0", core_portion, device_config->number_cores);
+      free_dataset(&new_dataset);
+      return false;
+    }
+    file_portion=core_separator+1;
+  }
+
+  new_dataset.filename=(char*) malloc(sizeof(char) * (strlen(file_portion) + 1));
+  strcpy(new_dataset.filename, file_portion);
+  char * offset_separator=strrchr(new_dataset.filename, '@');
+  if (offset_separator != NULL) {
+    char * end;
+    new_dataset.offset=strtoull(offset_separator+1, &end, 0);
+    if (*(offset_separator+1) == '\0' || *end != '\0') {
+      snprintf(message, DATASET_MESSAGE_SIZE, "Invalid data memory offset '%s' for dataset", offset_separator+1);
+      free_dataset(&new_dataset);
+      return false;
+    }
+    *offset_separator='\0';
+  }
+  new_dataset.per_core_files=strstr(new_dataset.filename, "%d") != NULL;
+  if (new_dataset.per_core_files && sharded) {
+    sprintf(message, "A sharded dataset must be a single file, not a file per core");
+    free_dataset(&new_dataset);
+    return false;
+  }
+  if ((sharded || new_dataset.per_core_files) && is_shared_data(device_config)) {
+    sprintf(message, "Per core datasets require per core data memory, but this device shares its data memory");
+    free_dataset(&new_dataset);
+    return false;
+  }
+  if (!new_dataset.per_core_files && access(new_dataset.filename, R_OK) != 0) {
+    snprintf(message, DATASET_MESSAGE_SIZE, "Dataset file '%s' can not be read", new_dataset.filename);
+    free_dataset(&new_dataset);
+    return false;
+  }
+
+  datasets=(struct dataset*) realloc(datasets, sizeof(struct dataset) * (number_datasets + 1));
+  datasets[number_datasets++]=new_dataset;
+  snprintf(message, DATASET_MESSAGE_SIZE, "Added dataset '%s'%s, it is staged into data memory when cores start", spec, sharded ? " sharded across cores" : "");
+  return true;
+}
+
+void clear_datasets() {
+  for (int i=0;i<number_datasets;i++) free_dataset(&datasets[i]);
+  free(datasets);
+  datasets=NULL;
+  number_datasets=0;
+}
+
+int get_number_datasets() {
+  return number_datasets;
+}
+
+/**
+ * The size of the buffer describe_datasets needs, as a spec can be as long as the command line it was given on
+ */
+size_t get_datasets_description_size() {
+  size_t size=DATASET_MESSAGE_SIZE;
+  for (int i=0;i<number_datasets;i++) size+=strlen(datasets[i].spec) + DATASET_MESSAGE_SIZE;
+  return size;
+}
+
+void describe_datasets(char * target, size_t size) {
+  size_t length=snprintf(target, size, "%d dataset(s)", number_datasets);
+  for (int i=0;i<number_datasets && length < size;i++) {
+    length+=snprintf(&target[length], size - length, "\n  %d: %s%s", i, datasets[i].spec, datasets[i].sharded ? " (sharded)" : "");
+  }
+}
+
+/**
+ * Transfers every dataset to the data memory of its cores, returning false and setting the message if a file can not
+ * be read or does not fit in data memory
+ */
+bool stage_datasets(struct launchpad_configuration * config, struct device_configuration * device_config,
+      struct device_drivers * active_device_drivers, char * message) {
+  int * cores=(int*) malloc(sizeof(int) * device_config->number_cores);
+  for (int i=0;i<number_datasets;i++) {
+    int num_cores=get_cores_in_set(datasets[i].cores != NULL ? datasets[i].cores : &config->active_cores, cores);
+    if (num_cores == 0) continue;
+    if (!stage_dataset(device_config, active_device_drivers, &datasets[i], cores, num_cores, message)) {
+      free(cores);
+      return false;
+    }
+  }
+  free(cores);
+  return true;
+}
+
+static bool stage_dataset(struct device_configuration * device_config, struct device_drivers * active_device_drivers,
+      struct dataset * staged_dataset, int * cores, int num_cores, char * message) {
+  if (!staged_dataset->sharded && !staged_dataset->per_core_files) {
+    // The same contents for every core is a single stream broadcast to them
+    struct load_stream stream;
+    if (!open_dataset_file(staged_dataset->filename, &stream, message)) return false;
+    bool fits=check_dataset_fits(device_config, staged_dataset, staged_dataset->filename, stream.length, message);
+    if (fits) {
+      set_load_stream_target(&stream, device_config, false, cores, num_cores);
+      stream.device_address=staged_dataset->offset;
+      stream_to_device(device_config, active_device_drivers, &stream);
+    }
+    close(stream.file_handle);
+    return fits;
+  }
+
+  struct load_stream streams[num_cores];
+  int num_streams=0;
+  bool success=true;
+  if (staged_dataset->sharded) {
+    struct load_stream file_stream;
+    if (!open_dataset_file(staged_dataset->filename, &file_stream, message)) return false;
+    uint64_t slice_length=(file_stream.length + num_cores - 1) / num_cores;
+    success=check_dataset_fits(device_config, staged_dataset, staged_dataset->filename, slice_length, message);
+    for (int i=0;i<num_cores && success;i++) {
+      memcpy(&streams[num_streams], &file_stream, sizeof(struct load_stream));
+      streams[num_streams].file_offset=i * slice_length;
+      if (streams[num_streams].file_offset >= file_stream.length) break;
+      streams[num_streams].length=file_stream.length - streams[num_streams].file_offset < slice_length ? file_stream.length - streams[num_streams].file_offset : slice_length;
+      num_streams++;
+    }
+  } else {
+    for (int i=0;i<num_cores && success;i++) {
+      char * filename=(char*) malloc(sizeof(char) * (strlen(staged_dataset->filename) + 16));
+      build_core_filename(staged_dataset->filename, cores[i], filename);
+      success=open_dataset_file(filename, &streams[num_streams], message);
+      if (success) {
+        num_streams++;
+        success=check_dataset_fits(device_config, staged_dataset, filename, streams[num_streams-1].length, message);
+      } else {
+        free(filename);
+      }
+    }
+  }
+  for (int i=0;i<num_streams;i++) {
+    set_load_stream_target(&streams[i], device_config, false, &cores[i], 1);
+    streams[i].device_address=staged_dataset->offset;
+  }
+  if (success) streams_to_device(device_config, active_device_drivers, streams, num_streams);
+  if (staged_dataset->sharded) {
+    if (num_streams > 0) close(streams[0].file_handle);
+  } else {
+    for (int i=0;i<num_streams;i++) {
+      close(streams[i].file_handle);
+      free(streams[i].filename);
+    }
+  }
+  return success;
+}
+
+static bool open_dataset_file(char * filename, struct load_stream * stream, char * message) {
+  memset(stream, 0, sizeof(struct load_stream));
+  int handle=open(filename, O_RDONLY);
+  if (handle == -1) {
+    snprintf(message, DATASET_MESSAGE_SIZE, "Error opening dataset file '%s', check it exists", filename);
+    return false;
+  }
+  struct stat st;
+  if (fstat(handle, &st) == -1) {
+    snprintf(message, DATASET_MESSAGE_SIZE, "Error obtaining status on dataset file '%s'", filename);
+    close(handle);
+    return false;
+  }
+  stream->file_handle=handle;
+  stream->filename=filename;
+  stream->length=(uint64_t) st.st_size;
+  return true;
+}
+
+/**
+ * Replaces the first %d in the filename with the core id, the filename is not used as a format string as it may
+ * contain other % characters
+ */
+static void build_core_filename(char * pattern, int core_id, char * target) {
+  char * placeholder=strstr(pattern, "%d");
+  memcpy(target, pattern, placeholder - pattern);
+  sprintf(&target[placeholder - pattern], "%d%s", core_id, placeholder + 2);
+}
+
+static bool check_dataset_fits(struct device_configuration * device_config, struct dataset * staged_dataset, char * filename,
+      uint64_t length, char * message) {
+  uint64_t space_size=is_shared_data(device_config) ? (uint64_t) device_config->shared_data_space_kb * 1024 :
+    (uint64_t) device_config->per_core_data_space_mb * 1024 * 1024;
+  // Devices that do not report the size of their data memory are not checked
+  if (space_size == 0 || staged_dataset->offset + length <= space_size) return true;
+  snprintf(message, DATASET_MESSAGE_SIZE, "Dataset '%s' of %ld bytes at offset 0x%lx does not fit in the %ld byte data memory",
+    filename, length, staged_dataset->offset, space_size);
+  return false;
+}
+
+static bool is_shared_data(struct device_configuration * device_config) {
+  return device_config->architecture_type == LP_ARCH_TYPE_SHARED_DATA_ONLY || device_config->architecture_type == LP_ARCH_TYPE_SHARED_EVERYTHING;
+}
+
+static void free_dataset(struct dataset * dataset) {
+  free(dataset->spec);
+  free(dataset->filename);
+  if (dataset->cores != NULL) {
+    free_core_set(dataset->cores);
+    free(dataset->cores);
+  }
+}
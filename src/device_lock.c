@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <semaphore.h>
+#include "device_lock.h"
+#include "launchpad_common.h"
+#include "core_set.h"
+#include "board.h"
+
+/**
+ * Serialises access to the device at the granularity declared by the driver in its configuration. Each core maps onto
+ * a lock domain (the whole device, its DDR bank or the core itself), operations on a single core take that core's
+ * domain and device wide operations (start, stop, reset, shared memory transfers) take every domain. Boards never share
+ * a domain, so a device wide lock on one board does not hold up another
+ */
+
+static sem_t * domain_semaphores=NULL;
+static int * core_domain_mapping=NULL;
+static int number_domains=0, number_cores=0;
+static bool global_granularity=true;
+
+void initialise_device_locks(struct device_configuration * device_config) {
+  number_cores=device_config->number_cores;
+  global_granularity=device_config->lock_granularity == LP_LOCK_GLOBAL;
+  core_domain_mapping=(int*) malloc(sizeof(int) * number_cores);
+  number_domains=1;
+  for (int i=0;i<number_cores;i++) {
+    if (device_config->lock_granularity == LP_LOCK_PER_CORE) {
+      core_domain_mapping[i]=i;
+    } else if (device_config->lock_granularity == LP_LOCK_PER_DDR_BANK) {
+      core_domain_mapping[i]=device_config->ddr_bank_mapping[i];
+    } else {
+      core_domain_mapping[i]=get_core_board(i);
+    }
+    if (core_domain_mapping[i] >= number_domains) number_domains=core_domain_mapping[i]+1;
+  }
+  domain_semaphores=(sem_t*) malloc(sizeof(sem_t) * number_domains);
+  for (int i=0;i<number_domains;i++) sem_init(&domain_semaphores[i], 0, 1);
+}
+
+int get_core_lock_domain(int core_id) {
+  return core_domain_mapping[core_id];
+}
+
+int get_number_lock_domains() {
+  return number_domains;
+}
+
+void lock_device_core(int core_id) {
+  sem_wait(&domain_semaphores[core_domain_mapping[core_id]]);
+}
+
+void unlock_device_core(int core_id) {
+  sem_post(&domain_semaphores[core_domain_mapping[core_id]]);
+}
+
+void lock_device() {
+  // Always acquired in ascending order so device wide lockers can not deadlock each other
+  for (int i=0;i<number_domains;i++) sem_wait(&domain_semaphores[i]);
+}
+
+void unlock_device() {
+  for (int i=number_domains-1;i>=0;i--) sem_post(&domain_semaphores[i]);
+}
+
+/**
+ * Reading the board status touches no core, so backends that allow concurrent access read it alongside any other call
+ * (see device_get_host_board_status) and only a backend with a single lock serialises it with the rest of the device
+ */
+void lock_device_board_status() {
+  if (global_granularity) lock_device();
+}
+
+void unlock_device_board_status() {
+  if (global_granularity) unlock_device();
+}
+
+/**
+ * Takes the domains of just the cores in the mask, a core set write then only excludes work on the cores it touches
+ */
+void lock_device_core_set(const uint64_t * core_mask) {
+  bool locked[number_domains];
+  for (int i=0;i<number_domains;i++) locked[i]=false;
+  struct core_set cores;
+  view_core_mask_as_set(&cores, core_mask, number_cores);
+  for (int i=next_core_in_set(&cores, 0);i>=0;i=next_core_in_set(&cores, i+1)) locked[core_domain_mapping[i]]=true;
+  for (int i=0;i<number_domains;i++) {
+    if (locked[i]) sem_wait(&domain_semaphores[i]);
+  }
+}
+
+void unlock_device_core_set(const uint64_t * core_mask) {
+  bool locked[number_domains];
+  for (int i=0;i<number_domains;i++) locked[i]=false;
+  struct core_set cores;
+  view_core_mask_as_set(&cores, core_mask, number_cores);
+  for (int i=next_core_in_set(&cores, 0);i>=0;i=next_core_in_set(&cores, i+1)) locked[core_domain_mapping[i]]=true;
+  for (int i=number_domains-1;i>=0;i--) {
+    if (locked[i]) sem_post(&domain_semaphores[i]);
+  }
+}
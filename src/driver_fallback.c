@@ -0,0 +1,88 @@
+#include <stddef.h>
+#include "driver_fallback.h"
+#include "launchpad_common.h"
+#include "core_set.h"
+
+/**
+ * Optional driver calls are accessed via these functions, which call into the native driver implementation
+ * where the backend provides one and otherwise emulate the behaviour using the mandatory driver calls
+ */
+
+static LP_STATUS_CODE emulate_read_uart_bulk(struct device_drivers*, int, char*, unsigned int, unsigned int*);
+
+LP_STATUS_CODE driver_read_uart_bulk(struct device_drivers * active_device_drivers, int core_id, char * buffer, unsigned int max_bytes, unsigned int * bytes_read) {
+  if (active_device_drivers->device_read_uart_bulk != NULL) {
+    return active_device_drivers->device_read_uart_bulk(core_id, buffer, max_bytes, bytes_read);
+  }
+  return emulate_read_uart_bulk(active_device_drivers, core_id, buffer, max_bytes, bytes_read);
+}
+
+/**
+ * Core set operations are emulated by one call per core in the mask, start and stop use the all cores call where the
+ * mask covers the whole device so that the cores still start together
+ */
+LP_STATUS_CODE driver_write_core_set_instructions(struct device_drivers * active_device_drivers, const uint64_t * core_mask, int number_cores,
+      uint64_t address, const char * data, uint64_t size) {
+  if (active_device_drivers->device_write_core_set_instructions != NULL) {
+    return active_device_drivers->device_write_core_set_instructions(core_mask, address, data, size);
+  }
+  struct core_set cores;
+  view_core_mask_as_set(&cores, core_mask, number_cores);
+  for (int i=next_core_in_set(&cores, 0);i>=0;i=next_core_in_set(&cores, i+1)) {
+    LP_STATUS_CODE status=active_device_drivers->device_write_core_instructions(i, address, data, size);
+    if (status != LP_SUCCESS) return status;
+  }
+  return LP_SUCCESS;
+}
+
+LP_STATUS_CODE driver_write_core_set_data(struct device_drivers * active_device_drivers, const uint64_t * core_mask, int number_cores,
+      uint64_t address, const char * data, uint64_t size) {
+  if (active_device_drivers->device_write_core_set_data != NULL) {
+    return active_device_drivers->device_write_core_set_data(core_mask, address, data, size);
+  }
+  struct core_set cores;
+  view_core_mask_as_set(&cores, core_mask, number_cores);
+  for (int i=next_core_in_set(&cores, 0);i>=0;i=next_core_in_set(&cores, i+1)) {
+    LP_STATUS_CODE status=active_device_drivers->device_write_core_data(i, address, data, size);
+    if (status != LP_SUCCESS) return status;
+  }
+  return LP_SUCCESS;
+}
+
+LP_STATUS_CODE driver_start_core_set(struct device_drivers * active_device_drivers, const uint64_t * core_mask, int number_cores) {
+  if (active_device_drivers->device_start_core_set != NULL) return active_device_drivers->device_start_core_set(core_mask);
+  struct core_set cores;
+  view_core_mask_as_set(&cores, core_mask, number_cores);
+  if (count_cores_in_set(&cores) == number_cores) return active_device_drivers->device_start_allcores();
+  for (int i=next_core_in_set(&cores, 0);i>=0;i=next_core_in_set(&cores, i+1)) {
+    LP_STATUS_CODE status=active_device_drivers->device_start_core(i);
+    if (status != LP_SUCCESS) return status;
+  }
+  return LP_SUCCESS;
+}
+
+LP_STATUS_CODE driver_stop_core_set(struct device_drivers * active_device_drivers, const uint64_t * core_mask, int number_cores) {
+  if (active_device_drivers->device_stop_core_set != NULL) return active_device_drivers->device_stop_core_set(core_mask);
+  struct core_set cores;
+  view_core_mask_as_set(&cores, core_mask, number_cores);
+  if (count_cores_in_set(&cores) == number_cores) return active_device_drivers->device_stop_allcores();
+  for (int i=next_core_in_set(&cores, 0);i>=0;i=next_core_in_set(&cores, i+1)) {
+    LP_STATUS_CODE status=active_device_drivers->device_stop_core(i);
+    if (status != LP_SUCCESS) return status;
+  }
+  return LP_SUCCESS;
+}
+
+static LP_STATUS_CODE emulate_read_uart_bulk(struct device_drivers * active_device_drivers, int core_id, char * buffer, unsigned int max_bytes, unsigned int * bytes_read) {
+  *bytes_read=0;
+  while (*bytes_read < max_bytes) {
+    int uart_data_present=0;
+    LP_STATUS_CODE status=active_device_drivers->device_uart_has_data(core_id, &uart_data_present);
+    if (status != LP_SUCCESS) return status;
+    if (!uart_data_present) break;
+    status=active_device_drivers->device_read_uart(core_id, &buffer[*bytes_read]);
+    if (status != LP_SUCCESS) return status;
+    (*bytes_read)++;
+  }
+  return LP_SUCCESS;
+}
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <elf.h>
+#include <unistd.h>
+#include "elf_loader.h"
+#include "loader.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+
+/**
+ * Loads ELF executables by transferring only their PT_LOAD segments, so sections that are not loaded (e.g. debug
+ * information and symbol tables) never cross the bus. Segments whose physical address is below the data base address
+ * are placed in instruction memory and the rest in data memory, relative to the data base. Any BSS portion of a
+ * segment (where the memory size exceeds the file size) is zeroed on the device
+ */
+
+struct elf_segment {
+  uint64_t file_offset, address, file_size, memory_size;
+  bool writable;
+};
+
+static int read_elf_segments(struct load_stream*, struct elf_segment**);
+static void read_from_file(struct load_stream*, uint64_t, void*, uint64_t);
+static void check_segment_fits(struct load_stream*, struct elf_segment*, uint64_t, uint64_t, char*);
+
+bool is_elf_file(struct load_stream * stream) {
+  unsigned char ident[SELFMAG];
+  if (stream->length < sizeof(Elf32_Ehdr)) return false;
+  read_from_file(stream, 0, ident, SELFMAG);
+  return memcmp(ident, ELFMAG, SELFMAG) == 0;
+}
+
+void transfer_elf_to_device(struct launchpad_configuration * config, struct device_configuration * device_config,
+      struct device_drivers * active_device_drivers, struct load_stream * file_stream, int * cores, int num_cores) {
+  struct elf_segment * segments;
+  int num_segments=read_elf_segments(file_stream, &segments);
+  uint64_t data_base=config->data_base_address != 0 ? config->data_base_address : (uint64_t) device_config->instruction_space_size_mb * 1024 * 1024;
+
+  for (int i=0;i<num_segments;i++) {
+    struct load_stream stream;
+    memcpy(&stream, file_stream, sizeof(struct load_stream));
+    bool instructions=segments[i].address < data_base;
+    set_load_stream_target(&stream, device_config, instructions, cores, num_cores);
+    stream.device_address=instructions ? segments[i].address : segments[i].address - data_base;
+    if (instructions) {
+      check_segment_fits(file_stream, &segments[i], stream.device_address, (uint64_t) device_config->instruction_space_size_mb * 1024 * 1024, "instruction");
+    } else if (stream.space == LOAD_SHARED_DATA) {
+      check_segment_fits(file_stream, &segments[i], stream.device_address, (uint64_t) device_config->shared_data_space_kb * 1024, "shared data");
+    } else {
+      check_segment_fits(file_stream, &segments[i], stream.device_address, (uint64_t) device_config->per_core_data_space_mb * 1024 * 1024, "data");
+    }
+
+    // Only segments that the program can not write to keep their contents from one run to the next
+    stream.read_only=!segments[i].writable;
+    stream.file_offset=segments[i].file_offset;
+    stream.length=segments[i].file_size;
+    stream_to_device(device_config, active_device_drivers, &stream);
+    if (segments[i].memory_size > segments[i].file_size) {
+      stream.file_handle=-1;
+      stream.device_address+=segments[i].file_size;
+      stream.length=segments[i].memory_size - segments[i].file_size;
+      stream_to_device(device_config, active_device_drivers, &stream);
+    }
+  }
+  free(segments);
+}
+
+/**
+ * Reads the loadable segments from the program header table of a 32 or 64 bit little endian ELF file
+ */
+static int read_elf_segments(struct load_stream * stream, struct elf_segment ** segments) {
+  unsigned char ident[EI_NIDENT];
+  read_from_file(stream, 0, ident, EI_NIDENT);
+  if (ident[EI_DATA] != ELFDATA2LSB) {
+    fprintf(stderr, "Error, ELF executable '%s' is not little endian\n", stream->filename);
+    exit(-1);
+  }
+  int num_segments=0;
+  if (ident[EI_CLASS] == ELFCLASS32) {
+    Elf32_Ehdr header;
+    read_from_file(stream, 0, &header, sizeof(Elf32_Ehdr));
+    *segments=(struct elf_segment*) malloc(sizeof(struct elf_segment) * (header.e_phnum > 0 ? header.e_phnum : 1));
+    for (int i=0;i<header.e_phnum;i++) {
+      Elf32_Phdr program_header;
+      read_from_file(stream, header.e_phoff + ((uint64_t) i * header.e_phentsize), &program_header, sizeof(Elf32_Phdr));
+      if (program_header.p_type != PT_LOAD || program_header.p_memsz == 0) continue;
+      (*segments)[num_segments].file_offset=program_header.p_offset;
+      (*segments)[num_segments].address=program_header.p_paddr;
+      (*segments)[num_segments].file_size=program_header.p_filesz;
+      (*segments)[num_segments].memory_size=program_header.p_memsz;
+      (*segments)[num_segments].writable=(program_header.p_flags & PF_W) != 0;
+      num_segments++;
+    }
+  } else if (ident[EI_CLASS] == ELFCLASS64) {
+    Elf64_Ehdr header;
+    read_from_file(stream, 0, &header, sizeof(Elf64_Ehdr));
+    *segments=(struct elf_segment*) malloc(sizeof(struct elf_segment) * (header.e_phnum > 0 ? header.e_phnum : 1));
+    for (int i=0;i<header.e_phnum;i++) {
+      Elf64_Phdr program_header;
+      read_from_file(stream, header.e_phoff + ((uint64_t) i * header.e_phentsize), &program_header, sizeof(Elf64_Phdr));
+      if (program_header.p_type != PT_LOAD || program_header.p_memsz == 0) continue;
+      (*segments)[num_segments].file_offset=program_header.p_offset;
+      (*segments)[num_segments].address=program_header.p_paddr;
+      (*segments)[num_segments].file_size=program_header.p_filesz;
+      (*segments)[num_segments].memory_size=program_header.p_memsz;
+      (*segments)[num_segments].writable=(program_header.p_flags & PF_W) != 0;
+      num_segments++;
+    }
+  } else {
+    fprintf(stderr, "Error, ELF executable '%s' has an unknown class\n", stream->filename);
+    exit(-1);
+  }
+  return num_segments;
+}
+
+static void read_from_file(struct load_stream * stream, uint64_t offset, void * target, uint64_t length) {
+  if (offset + length > stream->length || pread(stream->file_handle, target, length, offset) != (ssize_t) length) {
+    fprintf(stderr, "Error reading ELF headers from executable '%s'\n", stream->filename);
+    exit(-1);
+  }
+}
+
+static void check_segment_fits(struct load_stream * stream, struct elf_segment * segment, uint64_t address, uint64_t space_size, char * space_name) {
+  // Devices that do not report the size of a memory space are not checked
+  if (space_size == 0) return;
+  if (address + segment->memory_size > space_size) {
+    fprintf(stderr, "Error, ELF segment at 0x%lx of %ld bytes in '%s' does not fit in the %ld byte %s space\n", segment->address,
+      segment->memory_size, stream->filename, space_size, space_name);
+    exit(-1);
+  }
+}
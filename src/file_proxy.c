@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "file_proxy.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "core_set.h"
+#include "device_lock.h"
+#include "core_sweeper.h"
+#include "util.h"
+
+/**
+ * Serves file I/O for the cores from the host filesystem, so a core can open, read, write, seek and close files under
+ * the -fileproxy directory rather than having all input built into its executable and all output sent over the UART.
+ * A core sweeper visits the polled cores, first reading every core's request block and then serving all the
+ * requests found, so a sweep batches the requests of every core. Data moves directly between the host file and the
+ * core's buffer in its data space, and completion is written back to the request block before the core is
+ * interrupted. Each core has its own table of open files, indexed by the descriptor returned to it, which is closed
+ * when the core starts a new run. Whilst no core is making requests the interval between sweeps doubles up to
+ * FILE_PROXY_MAX_POLL_INTERVAL_US, so idle cores are not read continually under their locks
+ */
+
+struct file_proxy_core_state {
+  int host_fds[FILE_PROXY_MAX_FILES];
+};
+
+struct file_proxy_statistics {
+  uint64_t requests[FILE_PROXY_CLOSE + 1], bytes_read, bytes_written, failed;
+};
+
+static struct file_proxy_core_state * proxy_cores=NULL;
+static int number_proxy_cores;
+static uint64_t data_space_size, request_address;
+static char * proxy_root, * transfer_buffer;
+static int * pending_cores;
+static struct file_proxy_request * pending_requests;
+static struct file_proxy_statistics proxy_stats;
+// Its lock is held for each sweep, the statistics and open files are only changed whilst it is held
+static struct core_sweeper proxy_sweeper;
+
+static bool sweep_file_requests(struct core_sweeper*);
+static int64_t serve_file_request(int, struct file_proxy_request*);
+static int64_t open_proxy_file(int, struct file_proxy_request*);
+static int64_t transfer_proxy_file(int, struct file_proxy_request*, bool);
+static int64_t seek_proxy_file(int, struct file_proxy_request*);
+static int64_t close_proxy_file(int, struct file_proxy_request*);
+static int get_host_fd(int, int32_t);
+static bool is_path_within_root(char*);
+static void complete_file_request(int, int64_t);
+
+void start_file_proxy(struct launchpad_configuration * config, struct device_configuration * device_config, struct device_drivers * active_device_drivers) {
+  if (config->file_proxy_dir == NULL) return;
+  data_space_size=(uint64_t) device_config->per_core_data_space_mb * 1024 * 1024;
+  if (data_space_size < MAILBOX_REGION_SIZE + FILE_PROXY_REQUEST_SIZE) {
+    fprintf(stderr, "Error, the per core data space is too small to hold the file request block\n");
+    exit(-1);
+  }
+  request_address=data_space_size - MAILBOX_REGION_SIZE - FILE_PROXY_REQUEST_SIZE;
+  proxy_root=config->file_proxy_dir;
+  number_proxy_cores=device_config->number_cores;
+  transfer_buffer=(char*) malloc(sizeof(char) * FILE_PROXY_MAX_TRANSFER);
+  initialise_core_sweeper(&proxy_sweeper, config, device_config, active_device_drivers);
+  pending_cores=(int*) malloc(sizeof(int) * number_proxy_cores);
+  pending_requests=(struct file_proxy_request*) malloc(sizeof(struct file_proxy_request) * number_proxy_cores);
+  memset(&proxy_stats, 0, sizeof(struct file_proxy_statistics));
+  struct file_proxy_core_state * cores=(struct file_proxy_core_state*) malloc(sizeof(struct file_proxy_core_state) * number_proxy_cores);
+  for (int i=0;i<number_proxy_cores;i++) {
+    for (int j=0;j<FILE_PROXY_MAX_FILES;j++) cores[i].host_fds[j]=-1;
+  }
+  proxy_cores=cores;
+  start_core_sweeper(&proxy_sweeper, FILE_PROXY_POLL_INTERVAL_US, FILE_PROXY_MAX_POLL_INTERVAL_US, sweep_file_requests, "file proxy");
+}
+
+bool is_file_proxy_enabled() {
+  return proxy_cores != NULL;
+}
+
+void describe_file_proxy(char * target) {
+  if (proxy_cores == NULL) {
+    snprintf(target, FILE_PROXY_MESSAGE_SIZE, "File proxy: disabled, enable it with -fileproxy");
+    return;
+  }
+  lock_core_sweeper(&proxy_sweeper);
+  uint64_t total=0;
+  for (int i=FILE_PROXY_OPEN;i<=FILE_PROXY_CLOSE;i++) total+=proxy_stats.requests[i];
+  snprintf(target, FILE_PROXY_MESSAGE_SIZE, "File proxy: %ld requests (%ld opens, %ld reads, %ld writes, %ld seeks, %ld closes), %ld bytes read and %ld written, %ld failed",
+    total, proxy_stats.requests[FILE_PROXY_OPEN], proxy_stats.requests[FILE_PROXY_READ], proxy_stats.requests[FILE_PROXY_WRITE],
+    proxy_stats.requests[FILE_PROXY_LSEEK], proxy_stats.requests[FILE_PROXY_CLOSE], proxy_stats.bytes_read, proxy_stats.bytes_written,
+    proxy_stats.failed);
+  unlock_core_sweeper(&proxy_sweeper);
+}
+
+/**
+ * Closes the files left open by the cores' last run, which must be done before they are started again
+ */
+void close_file_proxy_files(struct core_set * cores) {
+  if (proxy_cores == NULL) return;
+  lock_core_sweeper(&proxy_sweeper);
+  for (int i=next_core_in_set(cores, 0);i>=0;i=next_core_in_set(cores, i+1)) {
+    for (int j=0;j<FILE_PROXY_MAX_FILES;j++) {
+      if (proxy_cores[i].host_fds[j] >= 0) {
+        close(proxy_cores[i].host_fds[j]);
+        proxy_cores[i].host_fds[j]=-1;
+      }
+    }
+  }
+  unlock_core_sweeper(&proxy_sweeper);
+}
+
+/**
+ * Reads the request block of each polled core, then serves every request that was found. Returns whether there were
+ * any requests
+ */
+static bool sweep_file_requests(struct core_sweeper * sweeper) {
+  int number_pending=0;
+  for (int i=next_core_in_set(&sweeper->cores, 0);i>=0;i=next_core_in_set(&sweeper->cores, i+1)) {
+    struct file_proxy_request * request=&pending_requests[number_pending];
+    lock_device_core(i);
+    if (!continue_core_sweep(sweeper)) {
+      unlock_device_core(i);
+      break;
+    }
+    check_device_status(proxy_sweeper.drivers.device_read_core_data(i, request_address, (char*) request, sizeof(struct file_proxy_request)));
+    unlock_device_core(i);
+    if (request->magic == FILE_PROXY_MAGIC && request->state == FILE_PROXY_REQUESTED) pending_cores[number_pending++]=i;
+  }
+  for (int i=0;i<number_pending;i++) {
+    int64_t result=serve_file_request(pending_cores[i], &pending_requests[i]);
+    if (result < 0) proxy_stats.failed++;
+    complete_file_request(pending_cores[i], result);
+  }
+  return number_pending > 0;
+}
+
+static int64_t serve_file_request(int core_id, struct file_proxy_request * request) {
+  if (request->operation >= FILE_PROXY_OPEN && request->operation <= FILE_PROXY_CLOSE) proxy_stats.requests[request->operation]++;
+  switch (request->operation) {
+    case FILE_PROXY_OPEN:
+      return open_proxy_file(core_id, request);
+    case FILE_PROXY_READ:
+      return transfer_proxy_file(core_id, request, true);
+    case FILE_PROXY_WRITE:
+      return transfer_proxy_file(core_id, request, false);
+    case FILE_PROXY_LSEEK:
+      return seek_proxy_file(core_id, request);
+    case FILE_PROXY_CLOSE:
+      return close_proxy_file(core_id, request);
+    default:
+      return -ENOSYS;
+  }
+}
+
+static int64_t open_proxy_file(int core_id, struct file_proxy_request * request) {
+  if (request->length == 0 || request->length >= FILE_PROXY_MAX_PATH) return -ENAMETOOLONG;
+  if (request->buffer_address > data_space_size || request->length > data_space_size - request->buffer_address) return -EFAULT;
+  char path[FILE_PROXY_MAX_PATH];
+  lock_device_core(core_id);
+  check_device_status(proxy_sweeper.drivers.device_read_core_data(core_id, request->buffer_address, path, request->length));
+  unlock_device_core(core_id);
+  path[request->length]='\0';
+  if (!is_path_within_root(path)) return -EACCES;
+  int fd;
+  for (fd=0;fd<FILE_PROXY_MAX_FILES && proxy_cores[core_id].host_fds[fd] >= 0;fd++);
+  if (fd == FILE_PROXY_MAX_FILES) return -EMFILE;
+
+  int host_flags=0;
+  bool reading=request->flags & FILE_PROXY_OPEN_READ, writing=request->flags & FILE_PROXY_OPEN_WRITE;
+  if (reading && writing) {
+    host_flags=O_RDWR;
+  } else if (writing) {
+    host_flags=O_WRONLY;
+  } else {
+    host_flags=O_RDONLY;
+  }
+  if (request->flags & FILE_PROXY_OPEN_CREATE) host_flags|=O_CREAT;
+  if (request->flags & FILE_PROXY_OPEN_TRUNCATE) host_flags|=O_TRUNC;
+  if (request->flags & FILE_PROXY_OPEN_APPEND) host_flags|=O_APPEND;
+  char host_path[strlen(proxy_root) + FILE_PROXY_MAX_PATH + 2];
+  sprintf(host_path, "%s/%s", proxy_root, path);
+  int host_fd=open(host_path, host_flags, 0644);
+  if (host_fd < 0) return -errno;
+  proxy_cores[core_id].host_fds[fd]=host_fd;
+  return fd;
+}
+
+/**
+ * Reads from the file into the core's buffer, or writes the core's buffer to the file, returning the bytes moved. A
+ * request larger than the host's transfer buffer moves only as much as it holds, as a short read or write would
+ */
+static int64_t transfer_proxy_file(int core_id, struct file_proxy_request * request, bool reading) {
+  int host_fd=get_host_fd(core_id, request->fd);
+  if (host_fd < 0) return -EBADF;
+  uint64_t length=request->length < FILE_PROXY_MAX_TRANSFER ? request->length : FILE_PROXY_MAX_TRANSFER;
+  if (request->buffer_address > data_space_size || length > data_space_size - request->buffer_address) return -EFAULT;
+  if (length == 0) return 0;
+  ssize_t moved;
+  if (reading) {
+    moved=read(host_fd, transfer_buffer, length);
+    if (moved < 0) return -errno;
+    if (moved > 0) {
+      lock_device_core(core_id);
+      check_device_status(proxy_sweeper.drivers.device_write_core_data(core_id, request->buffer_address, transfer_buffer, moved));
+      unlock_device_core(core_id);
+    }
+    proxy_stats.bytes_read+=moved;
+  } else {
+    lock_device_core(core_id);
+    check_device_status(proxy_sweeper.drivers.device_read_core_data(core_id, request->buffer_address, transfer_buffer, length));
+    unlock_device_core(core_id);
+    moved=write(host_fd, transfer_buffer, length);
+    if (moved < 0) return -errno;
+    proxy_stats.bytes_written+=moved;
+  }
+  return moved;
+}
+
+static int64_t seek_proxy_file(int core_id, struct file_proxy_request * request) {
+  int host_fd=get_host_fd(core_id, request->fd);
+  if (host_fd < 0) return -EBADF;
+  int whence;
+  if (request->flags == FILE_PROXY_SEEK_SET) {
+    whence=SEEK_SET;
+  } else if (request->flags == FILE_PROXY_SEEK_CUR) {
+    whence=SEEK_CUR;
+  } else if (request->flags == FILE_PROXY_SEEK_END) {
+    whence=SEEK_END;
+  } else {
+    return -EINVAL;
+  }
+  off_t offset=lseek(host_fd, request->offset, whence);
+  return offset < 0 ? -errno : offset;
+}
+
+static int64_t close_proxy_file(int core_id, struct file_proxy_request * request) {
+  int host_fd=get_host_fd(core_id, request->fd);
+  if (host_fd < 0) return -EBADF;
+  proxy_cores[core_id].host_fds[request->fd]=-1;
+  return close(host_fd) < 0 ? -errno : 0;
+}
+
+static int get_host_fd(int core_id, int32_t fd) {
+  if (fd < 0 || fd >= FILE_PROXY_MAX_FILES) return -1;
+  return proxy_cores[core_id].host_fds[fd];
+}
+
+// Cores are confined to the -fileproxy directory, so absolute paths and any that climb out with .. are refused
+static bool is_path_within_root(char * path) {
+  if (path[0] == '/') return false;
+  for (char * component=path;component != NULL;component=strchr(component, '/')) {
+    if (*component == '/') component++;
+    if (strncmp(component, "..", 2) == 0 && (component[2] == '/' || component[2] == '\0')) return false;
+  }
+  return true;
+}
+
+/**
+ * The result and state are adjacent in the request block, so both are written back with a single transfer before the
+ * core is interrupted
+ */
+static void complete_file_request(int core_id, int64_t result) {
+  char completion[sizeof(int64_t) + sizeof(uint32_t)];
+  uint32_t state=FILE_PROXY_COMPLETED;
+  memcpy(completion, &result, sizeof(int64_t));
+  memcpy(&completion[sizeof(int64_t)], &state, sizeof(uint32_t));
+  lock_device_core(core_id);
+  check_device_status(proxy_sweeper.drivers.device_write_core_data(core_id, request_address + offsetof(struct file_proxy_request, result), completion, sizeof(completion)));
+  check_device_status(proxy_sweeper.drivers.device_raise_interrupt(core_id, FILE_PROXY_COMPLETION_INTERRUPT));
+  unlock_device_core(core_id);
+}
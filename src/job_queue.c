@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "job_queue.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "util.h"
+#include "core_set.h"
+#include "device_lock.h"
+#include "driver_fallback.h"
+#include "uart_poll.h"
+#include "uart_ring.h"
+#include "uart_headless.h"
+#include "telemetry.h"
+#include "file_proxy.h"
+
+#define JOB_CHECK_INTERVAL_MS 100
+
+/**
+ * A queue of jobs, each an executable to run on a number of cores (any that are free) or on specific cores, until
+ * every core has printed the job's sentinel or stopped, or the job's timeout expires. A scheduler thread takes jobs
+ * in the order they were queued as soon as their cores are free, passing over those that do not fit yet so that free
+ * cores are filled by later jobs, and an upload thread uploads and starts each job taken whilst others run. Where the
+ * device shares data memory between cores jobs never run together, as an upload would overwrite the data of those
+ * running, and where it shares only instruction memory only jobs with the same executable run together. The output of each job's cores goes to its own file,
+ * job_n.out, as lines tagged by core, and the time that each job waited and ran is recorded along with the proportion
+ * of core time that the jobs kept busy
+ */
+
+enum job_state { JOB_PENDING, JOB_UPLOADING, JOB_RUNNING, JOB_COMPLETE, JOB_TIMED_OUT };
+
+struct job {
+  int id, num_cores;
+  char * spec, * executable, * sentinel;
+  struct core_set cores;
+  bool explicit_cores;
+  unsigned int timeout_sec;
+  enum job_state state;
+  struct timespec submit_time, start_time, end_time;
+  FILE * output;
+  struct headless_core_state * core_states;
+  int * sentinel_failure;
+  struct job * next;
+};
+
+static struct launchpad_configuration * queue_config;
+static struct device_configuration * queue_device_config;
+static struct device_drivers * queue_drivers;
+static struct job * jobs_head=NULL, * jobs_tail=NULL;
+static int number_jobs=0, number_pending=0, number_running=0, number_timed_out_since_wait=0;
+static struct core_set busy_cores, candidate_cores;
+static bool shared_instructions, shared_data;
+static double busy_core_seconds=0.0;
+static struct timespec first_start_time, last_end_time;
+// Guards the queue, the scheduler waits on the submission condition, the upload thread on the upload one and callers
+// of wait_for_jobs on the finished one
+static pthread_mutex_t queue_mutex=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t submitted_cond=PTHREAD_COND_INITIALIZER, upload_cond=PTHREAD_COND_INITIALIZER, finished_cond=PTHREAD_COND_INITIALIZER;
+
+static void * job_scheduler_thread(void*);
+static void * job_upload_thread(void*);
+static struct job * take_startable_job(void);
+static bool assign_job_cores(struct job*);
+static void start_job(struct job*);
+static void check_job(struct job*, char*, bool);
+static void end_job(struct job*, enum job_state, char*);
+static bool parse_job_spec(struct job*, char*, char*);
+static char * get_job_state_name(enum job_state);
+static double get_seconds_between(struct timespec*, struct timespec*);
+
+void initialise_job_queue(struct launchpad_configuration * config, struct device_configuration * device_config, struct device_drivers * active_device_drivers) {
+  queue_config=config;
+  queue_device_config=device_config;
+  queue_drivers=active_device_drivers;
+  shared_instructions=device_config->architecture_type == LP_ARCH_TYPE_SHARED_INSTR_ONLY || device_config->architecture_type == LP_ARCH_TYPE_SHARED_EVERYTHING;
+  shared_data=device_config->architecture_type == LP_ARCH_TYPE_SHARED_DATA_ONLY || device_config->architecture_type == LP_ARCH_TYPE_SHARED_EVERYTHING;
+  initialise_core_set(&busy_cores, device_config->number_cores);
+  initialise_core_set(&candidate_cores, device_config->number_cores);
+  if (config->batch_output_dir != NULL) mkdir(config->batch_output_dir, 0755);
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, &job_scheduler_thread, NULL)) {
+    fprintf(stderr, "Error creating job scheduler thread\n");
+    exit(-1);
+  }
+  pthread_detach(thread);
+  if (pthread_create(&thread, NULL, &job_upload_thread, NULL)) {
+    fprintf(stderr, "Error creating job upload thread\n");
+    exit(-1);
+  }
+  pthread_detach(thread);
+}
+
+/**
+ * Queues a job given as [cores=]executable[,until=sentinel][,timeout=seconds], where cores is a core list or #n for
+ * any n free cores (one if not given). Returns false and sets the message if the description is invalid
+ */
+bool submit_job(char * spec, char * message) {
+  struct job * job=(struct job*) malloc(sizeof(struct job));
+  memset(job, 0, sizeof(struct job));
+  initialise_core_set(&job->cores, queue_device_config->number_cores);
+  if (!parse_job_spec(job, spec, message)) {
+    free_core_set(&job->cores);
+    if (job->executable != NULL) free(job->executable);
+    if (job->sentinel != NULL) free(job->sentinel);
+    free(job);
+    return false;
+  }
+  job->spec=(char*) malloc(sizeof(char) * (strlen(spec) + 1));
+  strcpy(job->spec, spec);
+  job->state=JOB_PENDING;
+  clock_gettime(CLOCK_MONOTONIC, &job->submit_time);
+
+  pthread_mutex_lock(&queue_mutex);
+  job->id=number_jobs++;
+  if (jobs_tail == NULL) {
+    jobs_head=job;
+  } else {
+    jobs_tail->next=job;
+  }
+  jobs_tail=job;
+  number_pending++;
+  pthread_cond_signal(&submitted_cond);
+  pthread_mutex_unlock(&queue_mutex);
+  snprintf(message, JOB_MESSAGE_SIZE, "Queued job %d, '%s' on %d cores", job->id, job->executable, job->num_cores);
+  return true;
+}
+
+bool is_job_queue_busy() {
+  pthread_mutex_lock(&queue_mutex);
+  bool busy=number_pending > 0 || number_running > 0;
+  pthread_mutex_unlock(&queue_mutex);
+  return busy;
+}
+
+/**
+ * Waits until every queued job has finished, returning the batch exit code for timeout if any job has timed out
+ * since the last wait
+ */
+int wait_for_jobs() {
+  pthread_mutex_lock(&queue_mutex);
+  while (number_pending > 0 || number_running > 0) pthread_cond_wait(&finished_cond, &queue_mutex);
+  int exit_code=number_timed_out_since_wait > 0 ? LP_BATCH_EXIT_TIMEOUT : LP_BATCH_EXIT_COMPLETE;
+  number_timed_out_since_wait=0;
+  pthread_mutex_unlock(&queue_mutex);
+  return exit_code;
+}
+
+void describe_jobs(FILE * output) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  pthread_mutex_lock(&queue_mutex);
+  int number_finished=0;
+  double running_core_seconds=0.0;
+  for (struct job * job=jobs_head;job!=NULL;job=job->next) {
+    fprintf(output, "Job %d %s: '%s' on %d cores", job->id, get_job_state_name(job->state), job->executable, job->num_cores);
+    if (job->state == JOB_PENDING) {
+      fprintf(output, ", waiting %.3fs\n", get_seconds_between(&job->submit_time, &now));
+      continue;
+    }
+    // A job's cores are taken from when its upload begins
+    bool active=job->state == JOB_UPLOADING || job->state == JOB_RUNNING;
+    struct timespec * end_time=active ? &now : &job->end_time;
+    fprintf(output, ", waited %.3fs, ran %.3fs\n", get_seconds_between(&job->submit_time, &job->start_time), get_seconds_between(&job->start_time, end_time));
+    if (active) {
+      running_core_seconds+=job->num_cores * get_seconds_between(&job->start_time, &now);
+    } else {
+      number_finished++;
+    }
+  }
+  fprintf(output, "%d jobs, %d pending, %d running, %d finished", number_jobs, number_pending, number_running, number_finished);
+  if (number_running > 0 || number_finished > 0) {
+    double elapsed=get_seconds_between(&first_start_time, number_running > 0 ? &now : &last_end_time);
+    double utilisation=elapsed > 0 ? (busy_core_seconds + running_core_seconds) / (elapsed * queue_device_config->number_cores) : 0.0;
+    fprintf(output, ", jobs kept %.1f%% of core time busy over %.3fs", utilisation * 100, elapsed);
+  }
+  fprintf(output, "\n");
+  pthread_mutex_unlock(&queue_mutex);
+}
+
+/**
+ * Runs the jobs given on the command line to completion without the interactive display
+ */
+int run_job_batch(struct launchpad_configuration * config, struct device_configuration * device_config, struct device_drivers * active_device_drivers) {
+  start_uart_pollers(config, device_config, active_device_drivers, false);
+  initialise_job_queue(config, device_config, active_device_drivers);
+  char message[JOB_MESSAGE_SIZE];
+  for (int i=0;i<config->num_jobs;i++) {
+    if (!submit_job(config->job_specs[i], message)) {
+      fprintf(stderr, "Error, %s\n", message);
+      return LP_BATCH_EXIT_ERROR;
+    }
+  }
+  int exit_code=wait_for_jobs();
+  describe_jobs(stderr);
+  return exit_code;
+}
+
+static void * job_scheduler_thread(void * args) {
+  char * chunk=(char*) malloc(sizeof(char) * HEADLESS_CHUNK_SIZE);
+  while (true) {
+    struct job * job;
+    while (take_startable_job() != NULL);
+    pthread_mutex_lock(&queue_mutex);
+    if (number_running == 0) {
+      // Nothing is running so any pending job can start, otherwise sleep until one is submitted
+      while (number_pending == 0) pthread_cond_wait(&submitted_cond, &queue_mutex);
+      pthread_mutex_unlock(&queue_mutex);
+      continue;
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    bool new_output=wait_for_uart_output(JOB_CHECK_INTERVAL_MS);
+    // Jobs are only ever appended, and only this thread ends them, so the running jobs can be checked unlocked once the
+    // upload thread has started them
+    pthread_mutex_lock(&queue_mutex);
+    struct job * first_job=jobs_head;
+    pthread_mutex_unlock(&queue_mutex);
+    for (job=first_job;job!=NULL;job=job->next) {
+      pthread_mutex_lock(&queue_mutex);
+      bool running=job->state == JOB_RUNNING;
+      pthread_mutex_unlock(&queue_mutex);
+      if (running) check_job(job, chunk, new_output);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Uploads and starts the jobs taken by the scheduler one at a time, in the order taken, so that an upload never holds
+ * up the checks of running jobs for completion and timeout
+ */
+static void * job_upload_thread(void * args) {
+  while (true) {
+    pthread_mutex_lock(&queue_mutex);
+    struct job * job=NULL;
+    while (job == NULL) {
+      for (job=jobs_head;job!=NULL && job->state != JOB_UPLOADING;job=job->next);
+      if (job == NULL) pthread_cond_wait(&upload_cond, &queue_mutex);
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    start_job(job);
+    pthread_mutex_lock(&queue_mutex);
+    job->state=JOB_RUNNING;
+    pthread_mutex_unlock(&queue_mutex);
+  }
+  return NULL;
+}
+
+/**
+ * Takes the first pending job that can start, in queue order, with its cores marked as busy and hands it to the upload
+ * thread, returning the job or NULL if none can start
+ */
+static struct job * take_startable_job() {
+  pthread_mutex_lock(&queue_mutex);
+  struct job * job;
+  for (job=jobs_head;job!=NULL;job=job->next) {
+    if (job->state != JOB_PENDING) continue;
+    // Uploading a job stages its data, so where data memory is shared it would overwrite that of the jobs running
+    if (shared_data && number_running > 0) continue;
+    if (shared_instructions && number_running > 0) {
+      // Jobs share the instruction memory, so only jobs with the executable already running can join them
+      bool same_executable=true;
+      for (struct job * running=jobs_head;running!=NULL;running=running->next) {
+        if ((running->state == JOB_UPLOADING || running->state == JOB_RUNNING) && strcmp(running->executable, job->executable) != 0) same_executable=false;
+      }
+      if (!same_executable) continue;
+    }
+    if (assign_job_cores(job)) break;
+  }
+  if (job != NULL) {
+    union_core_sets(&busy_cores, &job->cores);
+    job->state=JOB_UPLOADING;
+    clock_gettime(CLOCK_MONOTONIC, &job->start_time);
+    if (first_start_time.tv_sec == 0 && first_start_time.tv_nsec == 0) {
+      first_start_time=job->start_time;
+    }
+    number_pending--;
+    number_running++;
+    pthread_cond_signal(&upload_cond);
+  }
+  pthread_mutex_unlock(&queue_mutex);
+  return job;
+}
+
+// Called with the queue's mutex held, a job's specific cores must all be free and otherwise the lowest free are used
+static bool assign_job_cores(struct job * job) {
+  if (job->explicit_cores) {
+    copy_core_set(&candidate_cores, &job->cores);
+    intersect_core_sets(&candidate_cores, &busy_cores);
+    return count_cores_in_set(&candidate_cores) == 0;
+  }
+  if (queue_device_config->number_cores - count_cores_in_set(&busy_cores) < job->num_cores) return false;
+  clear_core_set(&job->cores);
+  int assigned=0;
+  for (int i=0;i<queue_device_config->number_cores && assigned<job->num_cores;i++) {
+    if (!is_core_in_set(&busy_cores, i)) {
+      add_core_to_set(&job->cores, i);
+      assigned++;
+    }
+  }
+  return true;
+}
+
+/**
+ * Uploads the job's executable to its cores and starts them, each core's earlier output is discarded first. Called on
+ * the upload thread
+ */
+static void start_job(struct job * job) {
+  char filename[(queue_config->batch_output_dir != NULL ? strlen(queue_config->batch_output_dir) : 1) + 32];
+  sprintf(filename, "%s/job_%d.out", queue_config->batch_output_dir != NULL ? queue_config->batch_output_dir : ".", job->id);
+  job->output=fopen(filename, "w");
+  if (job->output == NULL) {
+    fprintf(stderr, "Error opening job output file '%s'\n", filename);
+    exit(-1);
+  }
+  job->core_states=(struct headless_core_state*) malloc(sizeof(struct headless_core_state) * job->num_cores);
+  int position=0;
+  for (int i=next_core_in_set(&job->cores, 0);i>=0;i=next_core_in_set(&job->cores, i+1)) {
+    memset(&job->core_states[position], 0, sizeof(struct headless_core_state));
+    job->core_states[position++].line_buffer=(char*) malloc(sizeof(char) * (HEADLESS_LINE_SIZE + 1));
+    uart_ring_discard(get_uart_output_ring(i));
+  }
+  job->sentinel_failure=job->sentinel != NULL ? build_sentinel_failure_table(job->sentinel) : NULL;
+
+  // The upload goes only to this job's cores, with the rest of the configuration as given to launchpad
+  struct launchpad_configuration job_config=*queue_config;
+  job_config.executable_filename=job->executable;
+  job_config.active_cores=job->cores;
+  transfer_executable_to_device(&job_config, queue_device_config, queue_drivers);
+  add_uart_poll_cores(&job->cores);
+  set_uart_polling(true);
+  close_file_proxy_files(&job->cores);
+  lock_device_core_set(job->cores.words);
+  check_device_status(driver_start_core_set(queue_drivers, job->cores.words, queue_device_config->number_cores));
+  unlock_device_core_set(job->cores.words);
+  begin_energy_run();
+}
+
+static void check_job(struct job * job, char * chunk, bool new_output) {
+  bool all_finished=true;
+  int position=0;
+  for (int i=next_core_in_set(&job->cores, 0);i>=0;i=next_core_in_set(&job->cores, i+1)) {
+    struct headless_core_state * core_state=&job->core_states[position++];
+    drain_core_output(job->output, i, core_state, chunk, job->sentinel, job->sentinel_failure);
+    // As in batch mode stopped cores are only finished once their output has gone quiet
+    if (!core_state->finished && !new_output && has_core_stopped(queue_drivers, i)) core_state->finished=true;
+    if (!core_state->finished) all_finished=false;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (all_finished) {
+    end_job(job, JOB_COMPLETE, chunk);
+  } else if (job->timeout_sec > 0 && get_seconds_between(&job->start_time, &now) >= job->timeout_sec) {
+    end_job(job, JOB_TIMED_OUT, chunk);
+  }
+}
+
+/**
+ * Stops the job's cores, collects their trailing output and frees them for other jobs
+ */
+static void end_job(struct job * job, enum job_state state, char * chunk) {
+  lock_device_core_set(job->cores.words);
+  check_device_status(driver_stop_core_set(queue_drivers, job->cores.words, queue_device_config->number_cores));
+  unlock_device_core_set(job->cores.words);
+  end_energy_run();
+  flush_uart_poll_cores(queue_config, &job->cores);
+  int position=0;
+  for (int i=next_core_in_set(&job->cores, 0);i>=0;i=next_core_in_set(&job->cores, i+1)) {
+    finish_core_output(job->output, i, &job->core_states[position++], chunk);
+  }
+  remove_uart_poll_cores(&job->cores);
+  fclose(job->output);
+  free(job->core_states);
+  if (job->sentinel_failure != NULL) free(job->sentinel_failure);
+
+  pthread_mutex_lock(&queue_mutex);
+  clock_gettime(CLOCK_MONOTONIC, &job->end_time);
+  last_end_time=job->end_time;
+  busy_core_seconds+=job->num_cores * get_seconds_between(&job->start_time, &job->end_time);
+  subtract_core_sets(&busy_cores, &job->cores);
+  job->state=state;
+  if (state == JOB_TIMED_OUT) number_timed_out_since_wait++;
+  number_running--;
+  if (number_running == 0) set_uart_polling(false);
+  pthread_cond_broadcast(&finished_cond);
+  pthread_mutex_unlock(&queue_mutex);
+}
+
+static bool parse_job_spec(struct job * job, char * spec, char * message) {
+  char description[strlen(spec) + 1];
+  strcpy(description, spec);
+  char * options=strchr(description, ',');
+  if (options != NULL) *options++='\0';
+  while (options != NULL) {
+    char * option=options;
+    options=strchr(option, ',');
+    if (options != NULL) *options++='\0';
+    if (strncmp(option, "until=", 6) == 0 && strlen(option) > 6) {
+      job->sentinel=(char*) malloc(sizeof(char) * (strlen(option) - 5));
+      strcpy(job->sentinel, &option[6]);
+    } else if (strncmp(option, "timeout=", 8) == 0) {
+      job->timeout_sec=atoi(&option[8]);
+    } else {
+      snprintf(message, JOB_MESSAGE_SIZE, "Invalid job option '%s', options are until=sentinel and timeout=seconds", option);
+      return false;
+    }
+  }
+
+  char * file_portion=description;
+  char * core_separator=strchr(description, '=');
+  job->num_cores=1;
+  if (core_separator != NULL) {
+    *core_separator='\0';
+    file_portion=core_separator+1;
+    if (description[0] == '#') {
+      char * end;
+      job->num_cores=strtol(&description[1], &end, 10);
+      if (end == &description[1] || *end != '\0' || job->num_cores < 1 || job->num_cores > queue_device_config->number_cores) {
+        snprintf(message, JOB_MESSAGE_SIZE, "Invalid job core count '%s', the device has %d cores", &description[1], queue_device_config->number_cores);
+        return false;
+      }
+    } else {
+      if (!parseCoreInfoString(description, &job->cores) || count_cores_in_set(&job->cores) == 0) {
+        snprintf(message, JOB_MESSAGE_SIZE, "Invalid job cores '%s', the device has %d cores numbered from 0", description, queue_device_config->number_cores);
+        return false;
+      }
+      job->explicit_cores=true;
+      job->num_cores=count_cores_in_set(&job->cores);
+    }
+  }
+  if (access(file_portion, R_OK) != 0) {
+    snprintf(message, JOB_MESSAGE_SIZE, "Job executable '%s' can not be read", file_portion);
+    return false;
+  }
+  if (job->sentinel == NULL && job->timeout_sec == 0 && queue_drivers->device_get_core_running == NULL) {
+    snprintf(message, JOB_MESSAGE_SIZE, "The device can not report stopped cores, so a job needs a sentinel or timeout");
+    return false;
+  }
+  job->executable=(char*) malloc(sizeof(char) * (strlen(file_portion) + 1));
+  strcpy(job->executable, file_portion);
+  return true;
+}
+
+static char * get_job_state_name(enum job_state state) {
+  if (state == JOB_PENDING) return "pending";
+  if (state == JOB_UPLOADING) return "uploading";
+  if (state == JOB_RUNNING) return "running";
+  if (state == JOB_COMPLETE) return "complete";
+  return "timed out";
+}
+
+static double get_seconds_between(struct timespec * start, struct timespec * end) {
+  return (end->tv_sec - start->tv_sec) + ((end->tv_nsec - start->tv_nsec) / 1e9);
+}
@@ -2,87 +2,134 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include "launchpad_common.h"
 #include "configuration.h"
 #include "uart_interactive.h"
+#include "uart_headless.h"
 #include "util.h"
+#include "device_lock.h"
+#include "upload_cache.h"
+#include "benchmark.h"
+#include "dataset.h"
+#include "async_transfer.h"
+#include "board.h"
+#include "daemon.h"
+#include "job_queue.h"
+#include "telemetry.h"
+#include "uart_capture.h"
+#include "uart_frame.h"
+#include "mailbox.h"
+#include "file_proxy.h"
 
 #ifdef MINOTAUR_SUPPORT
 #include "minotaur.h"
 #endif
+#ifdef SIMULATED_SUPPORT
+#include "simulated.h"
+#endif
 
-static int get_number_active_cores(struct launchpad_configuration*, struct device_configuration*);
-static void process_loop(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, struct current_device_status*);
+static int process_loop(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, struct current_device_status*);
+static void initialise_active_cores(struct launchpad_configuration*, struct device_configuration*);
 static void check_number_cores_on_device_and_active(struct launchpad_configuration*, struct device_configuration*);
+static void add_configured_datasets(struct launchpad_configuration*, struct device_configuration*);
 
 int main(int argc, char * argv[]) {
   struct launchpad_configuration * config=readConfiguration(argc, argv);
+  // A client of the daemon uses the daemon's device, so this one is never brought up
+  if (config->connect_socket != NULL) return run_daemon_client(config);
+  // Reading a capture only needs its files
+  if (config->capture_dump_spec != NULL) return dump_uart_capture(config);
   struct device_drivers active_device_drivers;
   struct device_configuration device_config;
   struct current_device_status device_status;
 
+  memset(&device_config, 0, sizeof(struct device_configuration));
+  memset(&device_status, 0, sizeof(struct current_device_status));
 #ifdef MINOTAUR_SUPPORT
   active_device_drivers=setup_minotaur_device_drivers();
 #endif
+#ifdef SIMULATED_SUPPORT
+  active_device_drivers=setup_simulated_device_drivers();
+#endif
+  // Where the backend drives several boards they are combined into a single device
+  active_device_drivers=setup_board_drivers(active_device_drivers);
 
   if (config->reset) check_device_status(active_device_drivers.device_reset());
   
   check_device_status(active_device_drivers.device_initialise());
   device_status.initialised=true;
   check_device_status(active_device_drivers.device_get_configuration(&device_config));
-  device_status.cores_active=(bool*) malloc(sizeof(bool) * device_config.number_cores);
+  initialise_board_cores(&device_config);
+  // Each board is polled by at least one thread of its own
+  if (config->poll_threads < get_number_boards()) config->poll_threads=get_number_boards();
+  initialise_active_cores(config, &device_config);
+  initialise_device_locks(&device_config);
+  initialise_upload_cache(&device_config, config->upload_cache);
+  initialise_async_transfers(&device_config, &active_device_drivers, config->transfer_threads);
+  add_configured_datasets(config, &device_config);
+  start_telemetry_sampler(config, &active_device_drivers);
+  start_uart_capture(config, &device_config);
+  start_uart_frame_decoding(config, &device_config);
+  start_mailbox_drain(config, &device_config, &active_device_drivers);
+  start_file_proxy(config, &device_config, &active_device_drivers);
+  initialise_core_set(&device_status.cores_active, device_config.number_cores);
   if (config->display_config) {
     char * config_str=(char*) malloc(sizeof(char) * CONFIGURATION_STR_SIZE);
     generate_device_configuration(&device_config, &active_device_drivers, config_str);
     printf("%s", config_str);
     free(config_str);
   }
-  if (config->executable_filename != NULL && get_number_active_cores(config, &device_config) > 0) {
+  if (config->benchmark_mode) return run_transfer_benchmark(config, &device_config, &active_device_drivers);
+  // Queued jobs upload and start their own executables
+  if (config->executable_filename != NULL && count_cores_in_set(&config->active_cores) > 0 && config->num_jobs == 0) {
     check_number_cores_on_device_and_active(config, &device_config);
     transfer_executable_to_device(config, &device_config, &active_device_drivers);
+    char message[DATASET_MESSAGE_SIZE];
+    if (!stage_datasets(config, &device_config, &active_device_drivers, message)) {
+      fprintf(stderr, "Error, %s\n", message);
+      exit(-1);
+    }
     start_cores(config, &device_config, &active_device_drivers, &device_status);      
   }
-  process_loop(config, &device_config, &active_device_drivers, &device_status);
-  return 0;
+  return process_loop(config, &device_config, &active_device_drivers, &device_status);
 }
 
-static void process_loop(struct launchpad_configuration * config, struct device_configuration* device_config,
+static int process_loop(struct launchpad_configuration * config, struct device_configuration* device_config,
         struct device_drivers * active_device_drivers, struct current_device_status * device_status) {
+  if (config->daemon_socket != NULL) return run_daemon(config, device_config, active_device_drivers, device_status);
   if (device_config->communication_type == LP_DEVICE_COMM_UART) {
+    if (config->num_jobs > 0) return run_job_batch(config, device_config, active_device_drivers);
+    if (config->batch_mode) return headless_uart(config, device_config, active_device_drivers, device_status);
     interactive_uart(config, device_config, active_device_drivers, device_status);
   }
+  return 0;
+}
+
+static void add_configured_datasets(struct launchpad_configuration * config, struct device_configuration * device_config) {
+  char message[DATASET_MESSAGE_SIZE];
+  for (int i=0;i<config->num_datasets;i++) {
+    if (!add_dataset(device_config, config->dataset_specs[i], config->dataset_sharded[i], message)) {
+      fprintf(stderr, "Error, %s\n", message);
+      exit(-1);
+    }
+  }
 }
 
-static int get_number_active_cores(struct launchpad_configuration * config, struct device_configuration * device_config) {
-  int num_active=0;
-  for (int i=0;i<device_config->number_cores;i++) {
-    if (config->active_cores[i]) num_active++;
+/**
+ * The active core set is sized to the device, so the cores given with -c are only parsed once it is known
+ */
+static void initialise_active_cores(struct launchpad_configuration * config, struct device_configuration * device_config) {
+  initialise_core_set(&config->active_cores, device_config->number_cores);
+  if (config->active_cores_spec != NULL && !parseCoreActiveInfo(config, config->active_cores_spec)) {
+    fprintf(stderr, "Error, invalid active cores '%s', the device has %d cores numbered from 0\n", config->active_cores_spec, device_config->number_cores);
+    exit(-1);
   }
-  return num_active;
 }
 
 static void check_number_cores_on_device_and_active(struct launchpad_configuration * config, struct device_configuration * device_config) {
-  if (config->all_cores_active) {
-    for (int i=0;i<device_config->number_cores;i++) {
-      config->active_cores[i]=true;
-    }
-  } else {
-    for (int i=device_config->number_cores;i<MAX_NUM_CORES;i++) {
-      if (config->active_cores[i]) {
-        fprintf(stderr, "Error, core %d configured to be active but the device only has %d cores\n", i, device_config->number_cores);
-        exit(-1);
-      }
-    }
-    bool non_active=true;
-    for (int i=0;i<device_config->number_cores;i++) {
-      if (config->active_cores[i]) {
-        non_active=false;
-        break;
-      }
-    }
-    if (non_active) {
-      fprintf(stderr, "Error, device has %d cores but none configured to be active\n", device_config->number_cores);
-      exit(-1);
-    }
+  if (count_cores_in_set(&config->active_cores) == 0) {
+    fprintf(stderr, "Error, device has %d cores but none configured to be active\n", device_config->number_cores);
+    exit(-1);
   }
 }
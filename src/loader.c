@@ -0,0 +1,476 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "loader.h"
+#include "launchpad_common.h"
+#include "util.h"
+#include "upload_cache.h"
+#include "board.h"
+#include "async_transfer.h"
+#include "driver_fallback.h"
+#include "core_set.h"
+
+#define LOAD_NUM_BUFFERS 4
+#define LOAD_SHARED_WRITER -1
+#define LOAD_MULTICAST_WRITER -2
+
+/**
+ * Streams file contents to the device in fixed size chunks. A reader thread fills a small pool of buffers from disk
+ * whilst writer threads, one per DDR bank that the target cores live in, write previously read chunks to their
+ * bank's cores. Each chunk is read once and written to all banks concurrently, file I/O overlaps with device
+ * transfers and peak host memory is independent of the size of the file. Instruction uploads go through the upload
+ * cache, the reader hashes each chunk's blocks once and writers only send the blocks that differ on each core.
+ * Writers submit the chunk's transfers to every core of their bank asynchronously, so the device lock is only held
+ * for each individual transfer and UART polling carries on during uploads. Where the backend supports multicast core
+ * set writes, a single writer sends each chunk to every target core in one transfer instead
+ */
+
+struct load_buffer {
+  char * data;
+  struct upload_block_hash * block_hashes;
+  uint64_t length, chunk_number;
+  int pending_writers;
+  bool filled;
+};
+
+struct load_pipeline {
+  struct load_stream * stream;
+  struct load_buffer buffers[LOAD_NUM_BUFFERS];
+  uint64_t num_chunks;
+  int num_writers;
+  bool cached;
+  double read_seconds;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+// The queue of target cores in one DDR bank, or all target cores of a board as a set for multicast writes
+struct load_writer {
+  struct load_pipeline * pipeline;
+  struct device_drivers * active_device_drivers;
+  int bank, num_cores;
+  int * cores;
+  struct core_set * core_set;
+  uint64_t bytes_written;
+  double write_seconds;
+  struct transfer_queue queue;
+};
+
+// The streams of one DDR bank that are transferred one after another whilst other banks proceed concurrently
+struct bank_streams {
+  struct device_configuration * device_config;
+  struct device_drivers * active_device_drivers;
+  struct load_stream ** streams;
+  int num_streams;
+};
+
+static struct load_statistics statistics;
+static pthread_mutex_t statistics_mutex=PTHREAD_MUTEX_INITIALIZER;
+
+static int build_bank_writers(struct device_configuration*, struct device_drivers*, struct load_stream*, struct load_pipeline*, struct load_writer**);
+static bool is_multicast_supported(struct device_drivers*, struct load_stream*);
+static void record_bank_write_time(int, double);
+static void * bank_streams_thread(void*);
+static void * read_chunks_thread(void*);
+static void * write_chunks_thread(void*);
+static void read_chunk(struct load_stream*, uint64_t, char*, uint64_t);
+static uint64_t write_chunk(struct load_writer*, uint64_t, struct load_buffer*);
+static void submit_write(struct transfer_queue*, enum LP_TRANSFER_TYPE, int, uint64_t, char*, uint64_t);
+static void submit_core_set_write(struct transfer_queue*, enum LP_TRANSFER_TYPE, uint64_t*, uint64_t, char*, uint64_t);
+static void free_buffers(struct load_pipeline*);
+static double get_seconds_since(struct timespec*);
+
+/**
+ * Sets the memory space that the stream is written to, depending on whether this holds instructions or data and
+ * whether the architecture shares that memory space between cores
+ */
+void set_load_stream_target(struct load_stream * stream, struct device_configuration * device_config, bool instructions, int * cores, int num_cores) {
+  bool shared;
+  if (instructions) {
+    shared=device_config->architecture_type == LP_ARCH_TYPE_SHARED_INSTR_ONLY || device_config->architecture_type == LP_ARCH_TYPE_SHARED_EVERYTHING;
+    stream->space=shared ? LOAD_SHARED_INSTRUCTIONS : LOAD_CORE_INSTRUCTIONS;
+  } else {
+    shared=device_config->architecture_type == LP_ARCH_TYPE_SHARED_DATA_ONLY || device_config->architecture_type == LP_ARCH_TYPE_SHARED_EVERYTHING;
+    stream->space=shared ? LOAD_SHARED_DATA : LOAD_CORE_DATA;
+  }
+  stream->cores=shared ? NULL : cores;
+  stream->num_cores=shared ? 0 : num_cores;
+}
+
+void stream_to_device(struct device_configuration * device_config, struct device_drivers * active_device_drivers, struct load_stream * stream) {
+  if (stream->length == 0) return;
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+  struct load_pipeline pipeline;
+  memset(&pipeline, 0, sizeof(struct load_pipeline));
+  pipeline.stream=stream;
+  pipeline.num_chunks=(stream->length + LOAD_CHUNK_SIZE - 1) / LOAD_CHUNK_SIZE;
+  pthread_mutex_init(&pipeline.mutex, NULL);
+  pthread_cond_init(&pipeline.cond, NULL);
+  pipeline.cached=is_upload_cache_enabled() && (stream->space == LOAD_CORE_INSTRUCTIONS || stream->space == LOAD_SHARED_INSTRUCTIONS);
+  for (int i=0;i<LOAD_NUM_BUFFERS;i++) {
+    pipeline.buffers[i].data=(char*) malloc(sizeof(char) * LOAD_CHUNK_SIZE);
+    pipeline.buffers[i].block_hashes=pipeline.cached ? (struct upload_block_hash*) malloc(sizeof(struct upload_block_hash) * UPLOAD_CACHE_MAX_CHUNK_BLOCKS(LOAD_CHUNK_SIZE)) : NULL;
+    pipeline.buffers[i].filled=false;
+  }
+  struct load_writer * writers;
+  pipeline.num_writers=build_bank_writers(device_config, active_device_drivers, stream, &pipeline, &writers);
+  if (pipeline.num_writers == 0) {
+    free(writers);
+    free_buffers(&pipeline);
+    return;
+  }
+
+  pthread_t reader_thread, writer_threads[pipeline.num_writers];
+  if (pthread_create(&reader_thread, NULL, &read_chunks_thread, &pipeline)) {
+    fprintf(stderr, "Error creating thread to read '%s'\n", stream->filename);
+    exit(-1);
+  }
+  for (int i=0;i<pipeline.num_writers;i++) {
+    if (pthread_create(&writer_threads[i], NULL, &write_chunks_thread, &writers[i])) {
+      fprintf(stderr, "Error creating thread to write '%s' to the device\n", stream->filename);
+      exit(-1);
+    }
+  }
+  pthread_join(reader_thread, NULL);
+  for (int i=0;i<pipeline.num_writers;i++) pthread_join(writer_threads[i], NULL);
+
+  // Streams to different banks can be in flight at once, see streams_to_device
+  pthread_mutex_lock(&statistics_mutex);
+  double multicast_seconds=0.0;
+  for (int i=0;i<pipeline.num_writers;i++) {
+    // The multicast writers of each board run concurrently, so the stream's multicast time is that of the slowest
+    if (writers[i].bank == LOAD_MULTICAST_WRITER && writers[i].write_seconds > multicast_seconds) multicast_seconds=writers[i].write_seconds;
+    record_bank_write_time(writers[i].bank, writers[i].write_seconds);
+    statistics.bytes_written+=writers[i].bytes_written;
+    if (writers[i].cores != NULL) free(writers[i].cores);
+    if (writers[i].core_set != NULL) {
+      free_core_set(writers[i].core_set);
+      free(writers[i].core_set);
+    }
+  }
+  statistics.multicast_write_seconds+=multicast_seconds;
+  statistics.read_seconds+=pipeline.read_seconds;
+  statistics.total_seconds+=get_seconds_since(&start_time);
+  if (stream->file_handle >= 0) statistics.bytes_read+=stream->length;
+  statistics.bytes_requested+=stream->length * (stream->num_cores > 0 ? stream->num_cores : 1);
+  pthread_mutex_unlock(&statistics_mutex);
+  free(writers);
+  free_buffers(&pipeline);
+  pthread_mutex_destroy(&pipeline.mutex);
+  pthread_cond_destroy(&pipeline.cond);
+}
+
+/**
+ * Transfers many streams, such as a different file or slice of a file for each core. Streams that target a single core
+ * are grouped by that core's DDR bank and each bank's streams run in turn, concurrently with the other banks, so disk
+ * reads overlap with device writes across cores. Streams to several cores or a shared space are transferred first
+ */
+void streams_to_device(struct device_configuration * device_config, struct device_drivers * active_device_drivers, struct load_stream * streams, int num_streams) {
+  int num_banks=1;
+  for (int i=0;i<num_streams;i++) {
+    if (streams[i].num_cores == 1) {
+      if (device_config->ddr_bank_mapping[streams[i].cores[0]] >= num_banks) num_banks=device_config->ddr_bank_mapping[streams[i].cores[0]]+1;
+    } else {
+      stream_to_device(device_config, active_device_drivers, &streams[i]);
+    }
+  }
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  double previous_total_seconds=statistics.total_seconds;
+  struct bank_streams banks[num_banks];
+  pthread_t bank_threads[num_banks];
+  for (int bank=0;bank<num_banks;bank++) {
+    banks[bank].device_config=device_config;
+    banks[bank].active_device_drivers=active_device_drivers;
+    banks[bank].streams=(struct load_stream**) malloc(sizeof(struct load_stream*) * num_streams);
+    banks[bank].num_streams=0;
+    for (int i=0;i<num_streams;i++) {
+      if (streams[i].num_cores == 1 && device_config->ddr_bank_mapping[streams[i].cores[0]] == bank) banks[bank].streams[banks[bank].num_streams++]=&streams[i];
+    }
+    if (banks[bank].num_streams > 0 && pthread_create(&bank_threads[bank], NULL, &bank_streams_thread, &banks[bank])) {
+      fprintf(stderr, "Error creating thread to transfer to DDR bank %d\n", bank);
+      exit(-1);
+    }
+  }
+  for (int bank=0;bank<num_banks;bank++) {
+    if (banks[bank].num_streams > 0) pthread_join(bank_threads[bank], NULL);
+    free(banks[bank].streams);
+  }
+  // Each stream added its own duration, but the banks ran concurrently so the total is the elapsed time
+  statistics.total_seconds=previous_total_seconds + get_seconds_since(&start_time);
+}
+
+void reset_load_statistics() {
+  if (statistics.bank_write_seconds != NULL) free(statistics.bank_write_seconds);
+  memset(&statistics, 0, sizeof(struct load_statistics));
+}
+
+struct load_statistics * get_load_statistics() {
+  return &statistics;
+}
+
+void describe_load_statistics(char * target) {
+  int length=sprintf(target, "Transferred %.2fMB to the device in %.1fms (file read %.1fms", (double) statistics.bytes_written / (1024 * 1024),
+    statistics.total_seconds * 1000, statistics.read_seconds * 1000);
+  if (statistics.bytes_requested > statistics.bytes_written) {
+    length+=sprintf(&target[length], ", %.2fMB unchanged", (double) (statistics.bytes_requested - statistics.bytes_written) / (1024 * 1024));
+  }
+  if (statistics.multicast_write_seconds > 0) length+=sprintf(&target[length], ", multicast %.1fms", statistics.multicast_write_seconds * 1000);
+  if (statistics.shared_write_seconds > 0) length+=sprintf(&target[length], ", shared memory %.1fms", statistics.shared_write_seconds * 1000);
+  for (int i=0;i<statistics.num_banks;i++) {
+    length+=sprintf(&target[length], ", DDR bank %d %.1fms", i, statistics.bank_write_seconds[i] * 1000);
+  }
+  sprintf(&target[length], ")");
+}
+
+/**
+ * Groups the target cores by the DDR bank they live in, there is one writer per bank so that transfers to different
+ * banks run concurrently. Shared memory spaces have a single writer, as do multicast writes to the cores of each board
+ */
+static int build_bank_writers(struct device_configuration * device_config, struct device_drivers * active_device_drivers, struct load_stream * stream,
+      struct load_pipeline * pipeline, struct load_writer ** writers) {
+  int num_banks=1;
+  for (int i=0;i<stream->num_cores;i++) {
+    if (device_config->ddr_bank_mapping[stream->cores[i]] >= num_banks) num_banks=device_config->ddr_bank_mapping[stream->cores[i]]+1;
+  }
+  *writers=(struct load_writer*) malloc(sizeof(struct load_writer) * num_banks);
+  if (stream->space == LOAD_SHARED_INSTRUCTIONS || stream->space == LOAD_SHARED_DATA) {
+    memset(&(*writers)[0], 0, sizeof(struct load_writer));
+    (*writers)[0].pipeline=pipeline;
+    (*writers)[0].active_device_drivers=active_device_drivers;
+    (*writers)[0].bank=LOAD_SHARED_WRITER;
+    return 1;
+  }
+  if (stream->num_cores > 1 && is_multicast_supported(active_device_drivers, stream)) {
+    // Boards are written concurrently, so there is a multicast writer for each board with target cores
+    int num_writers=0;
+    for (int board=0;board<get_number_boards();board++) {
+      struct load_writer * writer=&(*writers)[num_writers];
+      memset(writer, 0, sizeof(struct load_writer));
+      writer->pipeline=pipeline;
+      writer->active_device_drivers=active_device_drivers;
+      writer->bank=LOAD_MULTICAST_WRITER;
+      writer->cores=(int*) malloc(sizeof(int) * stream->num_cores);
+      for (int i=0;i<stream->num_cores;i++) {
+        if (get_core_board(stream->cores[i]) == board) writer->cores[writer->num_cores++]=stream->cores[i];
+      }
+      if (writer->num_cores == 0) {
+        free(writer->cores);
+        continue;
+      }
+      writer->core_set=(struct core_set*) malloc(sizeof(struct core_set));
+      initialise_core_set(writer->core_set, device_config->number_cores);
+      for (int i=0;i<writer->num_cores;i++) add_core_to_set(writer->core_set, writer->cores[i]);
+      num_writers++;
+    }
+    return num_writers;
+  }
+  int num_writers=0;
+  for (int bank=0;bank<num_banks;bank++) {
+    struct load_writer * writer=&(*writers)[num_writers];
+    memset(writer, 0, sizeof(struct load_writer));
+    writer->pipeline=pipeline;
+    writer->active_device_drivers=active_device_drivers;
+    writer->bank=bank;
+    writer->cores=(int*) malloc(sizeof(int) * stream->num_cores);
+    for (int i=0;i<stream->num_cores;i++) {
+      if (device_config->ddr_bank_mapping[stream->cores[i]] == bank) writer->cores[writer->num_cores++]=stream->cores[i];
+    }
+    if (writer->num_cores > 0) {
+      num_writers++;
+    } else {
+      free(writer->cores);
+    }
+  }
+  return num_writers;
+}
+
+static bool is_multicast_supported(struct device_drivers * active_device_drivers, struct load_stream * stream) {
+  if (stream->space == LOAD_CORE_INSTRUCTIONS) return active_device_drivers->device_write_core_set_instructions != NULL;
+  if (stream->space == LOAD_CORE_DATA) return active_device_drivers->device_write_core_set_data != NULL;
+  return false;
+}
+
+static void record_bank_write_time(int bank, double seconds) {
+  if (bank == LOAD_SHARED_WRITER) {
+    statistics.shared_write_seconds+=seconds;
+    return;
+  }
+  if (bank == LOAD_MULTICAST_WRITER) return;
+  if (bank >= statistics.num_banks) {
+    statistics.bank_write_seconds=(double*) realloc(statistics.bank_write_seconds, sizeof(double) * (bank+1));
+    for (int i=statistics.num_banks;i<=bank;i++) statistics.bank_write_seconds[i]=0.0;
+    statistics.num_banks=bank+1;
+  }
+  statistics.bank_write_seconds[bank]+=seconds;
+}
+
+static void * bank_streams_thread(void * args) {
+  struct bank_streams * bank=(struct bank_streams*) args;
+  for (int i=0;i<bank->num_streams;i++) stream_to_device(bank->device_config, bank->active_device_drivers, bank->streams[i]);
+  return NULL;
+}
+
+static void * read_chunks_thread(void * args) {
+  struct load_pipeline * pipeline=(struct load_pipeline*) args;
+  struct load_stream * stream=pipeline->stream;
+  for (uint64_t chunk_number=0;chunk_number<pipeline->num_chunks;chunk_number++) {
+    struct load_buffer * buffer=&pipeline->buffers[chunk_number % LOAD_NUM_BUFFERS];
+    pthread_mutex_lock(&pipeline->mutex);
+    while (buffer->filled) pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    struct timespec read_start;
+    clock_gettime(CLOCK_MONOTONIC, &read_start);
+    uint64_t offset=chunk_number * LOAD_CHUNK_SIZE;
+    buffer->length=stream->length - offset < LOAD_CHUNK_SIZE ? stream->length - offset : LOAD_CHUNK_SIZE;
+    if (stream->file_handle >= 0) {
+      read_chunk(stream, stream->file_offset + offset, buffer->data, buffer->length);
+    } else {
+      // Streams without a file zero the target memory
+      memset(buffer->data, 0, buffer->length);
+    }
+    if (pipeline->cached) hash_upload_blocks(stream->device_address + offset, buffer->data, buffer->length, stream->read_only, buffer->block_hashes);
+    pipeline->read_seconds+=get_seconds_since(&read_start);
+
+    pthread_mutex_lock(&pipeline->mutex);
+    buffer->chunk_number=chunk_number;
+    buffer->pending_writers=pipeline->num_writers;
+    buffer->filled=true;
+    pthread_cond_broadcast(&pipeline->cond);
+    pthread_mutex_unlock(&pipeline->mutex);
+  }
+  return NULL;
+}
+
+static void * write_chunks_thread(void * args) {
+  struct load_writer * writer=(struct load_writer*) args;
+  struct load_pipeline * pipeline=writer->pipeline;
+  initialise_transfer_queue(&writer->queue);
+  for (uint64_t chunk_number=0;chunk_number<pipeline->num_chunks;chunk_number++) {
+    struct load_buffer * buffer=&pipeline->buffers[chunk_number % LOAD_NUM_BUFFERS];
+    pthread_mutex_lock(&pipeline->mutex);
+    while (!buffer->filled || buffer->chunk_number != chunk_number) pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    struct timespec write_start;
+    clock_gettime(CLOCK_MONOTONIC, &write_start);
+    writer->bytes_written+=write_chunk(writer, pipeline->stream->device_address + (chunk_number * LOAD_CHUNK_SIZE), buffer);
+    writer->write_seconds+=get_seconds_since(&write_start);
+
+    pthread_mutex_lock(&pipeline->mutex);
+    buffer->pending_writers--;
+    if (buffer->pending_writers == 0) {
+      // The last bank to write this chunk releases the buffer back to the reader
+      buffer->filled=false;
+      pthread_cond_broadcast(&pipeline->cond);
+    }
+    pthread_mutex_unlock(&pipeline->mutex);
+  }
+  destroy_transfer_queue(&writer->queue);
+  return NULL;
+}
+
+static void read_chunk(struct load_stream * stream, uint64_t file_offset, char * buffer, uint64_t length) {
+  // Loops as pread can return fewer bytes than requested
+  uint64_t bytes_read=0;
+  while (bytes_read < length) {
+    ssize_t rc=pread(stream->file_handle, &buffer[bytes_read], length - bytes_read, file_offset + bytes_read);
+    if (rc == -1 && errno == EINTR) continue;
+    if (rc <= 0) {
+      fprintf(stderr, "Error reading file '%s', %s\n", stream->filename, rc == 0 ? "unexpected end of file" : "read failed");
+      exit(-1);
+    }
+    bytes_read+=rc;
+  }
+}
+
+/**
+ * Writes a chunk to the target memory space of each core (or the shared space), with the transfers to every core in
+ * flight together. Returns the number of bytes that were actually written which is less than requested when the
+ * upload cache skips unchanged blocks
+ */
+static uint64_t write_chunk(struct load_writer * writer, uint64_t address, struct load_buffer * buffer) {
+  struct load_pipeline * pipeline=writer->pipeline;
+  struct load_stream * stream=pipeline->stream;
+  char * data=buffer->data;
+  uint64_t length=buffer->length, bytes_written=0;
+  if (stream->space == LOAD_SHARED_INSTRUCTIONS && pipeline->cached) {
+    bytes_written=write_cached_instructions(&writer->queue, UPLOAD_CACHE_SHARED_SPACE, address, data, length, buffer->block_hashes);
+  } else if (stream->space == LOAD_SHARED_INSTRUCTIONS) {
+    submit_write(&writer->queue, LP_TRANSFER_WRITE_INSTRUCTIONS, 0, address, data, length);
+    bytes_written=length;
+  } else if (stream->space == LOAD_SHARED_DATA) {
+    submit_write(&writer->queue, LP_TRANSFER_WRITE_DATA, 0, address, data, length);
+    bytes_written=length;
+  }
+  if (writer->core_set != NULL) {
+    // The set's words are laid out as a driver core mask
+    if (stream->space == LOAD_CORE_INSTRUCTIONS && pipeline->cached) {
+      bytes_written=write_cached_core_set_instructions(&writer->queue, writer->cores, writer->num_cores, writer->core_set->words, address, data, length,
+        buffer->block_hashes);
+    } else {
+      submit_core_set_write(&writer->queue, stream->space == LOAD_CORE_INSTRUCTIONS ? LP_TRANSFER_WRITE_CORE_SET_INSTRUCTIONS : LP_TRANSFER_WRITE_CORE_SET_DATA,
+        writer->core_set->words, address, data, length);
+      bytes_written=length * writer->num_cores;
+    }
+    wait_all_transfers(&writer->queue);
+    return bytes_written;
+  }
+  for (int i=0;i<writer->num_cores;i++) {
+    if (stream->space == LOAD_CORE_INSTRUCTIONS && pipeline->cached) {
+      bytes_written+=write_cached_instructions(&writer->queue, writer->cores[i], address, data, length, buffer->block_hashes);
+    } else {
+      submit_write(&writer->queue, stream->space == LOAD_CORE_INSTRUCTIONS ? LP_TRANSFER_WRITE_CORE_INSTRUCTIONS : LP_TRANSFER_WRITE_CORE_DATA,
+        writer->cores[i], address, data, length);
+      bytes_written+=length;
+    }
+  }
+  // The buffer is only released back to the reader once every transfer from it has completed
+  wait_all_transfers(&writer->queue);
+  return bytes_written;
+}
+
+static void submit_write(struct transfer_queue * queue, enum LP_TRANSFER_TYPE type, int core_id, uint64_t address, char * data, uint64_t length) {
+  struct device_transfer_request request;
+  request.type=type;
+  request.core_id=core_id;
+  request.core_mask=NULL;
+  request.address=address;
+  request.size=length;
+  request.buffer=data;
+  request.tag=core_id;
+  submit_transfer(queue, &request);
+}
+
+static void submit_core_set_write(struct transfer_queue * queue, enum LP_TRANSFER_TYPE type, uint64_t * core_mask, uint64_t address, char * data, uint64_t length) {
+  struct device_transfer_request request;
+  request.type=type;
+  request.core_id=-1;
+  request.core_mask=core_mask;
+  request.address=address;
+  request.size=length;
+  request.buffer=data;
+  request.tag=address;
+  submit_transfer(queue, &request);
+}
+
+static void free_buffers(struct load_pipeline * pipeline) {
+  for (int i=0;i<LOAD_NUM_BUFFERS;i++) {
+    free(pipeline->buffers[i].data);
+    if (pipeline->buffers[i].block_hashes != NULL) free(pipeline->buffers[i].block_hashes);
+  }
+}
+
+static double get_seconds_since(struct timespec * start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + ((now.tv_nsec - start->tv_nsec) / 1e9);
+}
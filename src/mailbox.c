@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "mailbox.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "core_set.h"
+#include "device_lock.h"
+#include "core_sweeper.h"
+#include "util.h"
+#include "board.h"
+
+/**
+ * Drains the mailboxes that cores post bulk results into, a ring of slots in device memory, so results come back at
+ * memory bandwidth rather than at the rate of the UART. A core sweeper visits the polled cores, reading each
+ * mailbox's header and, where the core has posted, every slot up to its head in at most two bulk reads (either side of
+ * the ring's wrap). The new tail is written back and the core's doorbell rung before the lock is released, so a core
+ * waiting on a full ring carries on straight away, and the records are then appended to the core's file
+ * (core_n.mailbox) as [timestamp][type][length][payload] away from the device lock
+ */
+
+struct mailbox_core_state {
+  FILE * record_file;
+  uint64_t records_drained, bytes_drained;
+};
+
+static struct mailbox_core_state * mailbox_cores=NULL;
+static int number_mailbox_cores;
+static bool shared_mailboxes;
+static uint64_t data_space_size, shared_space_size;
+static char * mailbox_dir, * slot_buffer;
+static struct timespec mailbox_start_time;
+static uint64_t bulk_reads=0, doorbells=0;
+// Its lock is held for each sweep, so a sweep requested by the run finishing does not interleave with the drain thread
+static struct core_sweeper mailbox_sweeper;
+
+static bool sweep_mailboxes(struct core_sweeper*);
+static uint64_t drain_core_mailbox(int);
+static void write_mailbox_records(int, struct mailbox_header*, uint64_t);
+static bool is_valid_mailbox(struct mailbox_header*);
+static uint64_t get_mailbox_address(int);
+static void read_mailbox(int, uint64_t, char*, uint64_t);
+static void write_mailbox(int, uint64_t, const char*, uint64_t);
+static void lock_mailbox(int);
+static void unlock_mailbox(int);
+
+void start_mailbox_drain(struct launchpad_configuration * config, struct device_configuration * device_config, struct device_drivers * active_device_drivers) {
+  if (config->mailbox_dir == NULL) return;
+  shared_mailboxes=device_config->architecture_type == LP_ARCH_TYPE_SHARED_DATA_ONLY || device_config->architecture_type == LP_ARCH_TYPE_SHARED_EVERYTHING;
+  data_space_size=(uint64_t) device_config->per_core_data_space_mb * 1024 * 1024;
+  shared_space_size=(uint64_t) device_config->shared_data_space_kb * 1024;
+  if (shared_mailboxes) {
+    // Shared data is read from the first board but written to every board, so each board's mailboxes would clash
+    if (get_number_boards() > 1) {
+      fprintf(stderr, "Error, mailboxes in shared data memory are not supported across several boards\n");
+      exit(-1);
+    }
+    if ((uint64_t) device_config->number_cores * MAILBOX_REGION_SIZE > shared_space_size) {
+      fprintf(stderr, "Error, the shared data space of %dKB can not hold a %dKB mailbox for each of the %d cores\n",
+        device_config->shared_data_space_kb, MAILBOX_REGION_SIZE / 1024, device_config->number_cores);
+      exit(-1);
+    }
+  } else if (data_space_size < MAILBOX_REGION_SIZE) {
+    fprintf(stderr, "Error, the per core data space is too small to hold a %dKB mailbox\n", MAILBOX_REGION_SIZE / 1024);
+    exit(-1);
+  }
+  mailbox_dir=config->mailbox_dir;
+  mkdir(mailbox_dir, 0755);
+  number_mailbox_cores=device_config->number_cores;
+  clock_gettime(CLOCK_MONOTONIC, &mailbox_start_time);
+  slot_buffer=(char*) malloc(sizeof(char) * MAILBOX_REGION_SIZE);
+  initialise_core_sweeper(&mailbox_sweeper, config, device_config, active_device_drivers);
+  mailbox_cores=(struct mailbox_core_state*) malloc(sizeof(struct mailbox_core_state) * number_mailbox_cores);
+  memset(mailbox_cores, 0, sizeof(struct mailbox_core_state) * number_mailbox_cores);
+  start_core_sweeper(&mailbox_sweeper, MAILBOX_POLL_INTERVAL_MS * 1000, MAILBOX_POLL_INTERVAL_MS * 1000, sweep_mailboxes, "mailbox drain");
+}
+
+bool is_mailbox_enabled() {
+  return mailbox_cores != NULL;
+}
+
+/**
+ * Drains every mailbox until they are all empty, such as once the cores have finished so no results are left behind
+ */
+void drain_mailboxes() {
+  if (mailbox_cores == NULL) return;
+  while (run_core_sweep(&mailbox_sweeper));
+}
+
+void describe_mailboxes(char * target) {
+  if (mailbox_cores == NULL) {
+    sprintf(target, "Mailbox: disabled, enable it with -mailbox");
+    return;
+  }
+  lock_core_sweeper(&mailbox_sweeper);
+  uint64_t records=0, bytes=0;
+  int cores_posting=0;
+  for (int i=0;i<number_mailbox_cores;i++) {
+    records+=mailbox_cores[i].records_drained;
+    bytes+=mailbox_cores[i].bytes_drained;
+    if (mailbox_cores[i].records_drained > 0) cores_posting++;
+  }
+  sprintf(target, "Mailbox: %ld records (%ld bytes) drained from %d cores in %ld bulk reads, %ld doorbells rung", records, bytes,
+    cores_posting, bulk_reads, doorbells);
+  unlock_core_sweeper(&mailbox_sweeper);
+}
+
+/**
+ * Drains the mailbox of each polled core once, returning whether any records were drained
+ */
+static bool sweep_mailboxes(struct core_sweeper * sweeper) {
+  uint64_t drained=0;
+  for (int i=next_core_in_set(&sweeper->cores, 0);i>=0;i=next_core_in_set(&sweeper->cores, i+1)) {
+    drained+=drain_core_mailbox(i);
+  }
+  return drained > 0;
+}
+
+static uint64_t drain_core_mailbox(int core_id) {
+  struct mailbox_header header;
+  lock_mailbox(core_id);
+  if (!continue_core_sweep(&mailbox_sweeper)) {
+    unlock_mailbox(core_id);
+    return 0;
+  }
+  read_mailbox(core_id, 0, (char*) &header, sizeof(struct mailbox_header));
+  // A core that has not set its mailbox up, or has not posted since the last drain, is skipped
+  if (!is_valid_mailbox(&header) || header.head == header.tail || header.head - header.tail > header.number_slots) {
+    unlock_mailbox(core_id);
+    return 0;
+  }
+  uint64_t count=header.head - header.tail, first_slot=header.tail % header.number_slots;
+  uint64_t before_wrap=count < header.number_slots - first_slot ? count : header.number_slots - first_slot;
+  read_mailbox(core_id, MAILBOX_HEADER_SIZE + (first_slot * header.slot_size), slot_buffer, before_wrap * header.slot_size);
+  bulk_reads++;
+  if (count > before_wrap) {
+    read_mailbox(core_id, MAILBOX_HEADER_SIZE, &slot_buffer[before_wrap * header.slot_size], (count - before_wrap) * header.slot_size);
+    bulk_reads++;
+  }
+  write_mailbox(core_id, offsetof(struct mailbox_header, tail), (char*) &header.head, sizeof(uint64_t));
+  check_device_status(mailbox_sweeper.drivers.device_raise_interrupt(core_id, MAILBOX_DOORBELL_INTERRUPT));
+  doorbells++;
+  unlock_mailbox(core_id);
+  write_mailbox_records(core_id, &header, count);
+  return count;
+}
+
+static void write_mailbox_records(int core_id, struct mailbox_header * header, uint64_t count) {
+  struct mailbox_core_state * core=&mailbox_cores[core_id];
+  if (core->record_file == NULL) {
+    char filename[strlen(mailbox_dir) + BOARD_CORE_NAME_SIZE + 32], core_name[BOARD_CORE_NAME_SIZE];
+    describe_core(core_id, core_name);
+    sprintf(filename, "%s/core_%s.mailbox", mailbox_dir, core_name);
+    core->record_file=fopen(filename, "w");
+    if (core->record_file == NULL) {
+      fprintf(stderr, "Error opening mailbox records file for core %s in '%s'\n", core_name, mailbox_dir);
+      exit(-1);
+    }
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t timestamp_ns=((now.tv_sec - mailbox_start_time.tv_sec) * 1000000000) + (now.tv_nsec - mailbox_start_time.tv_nsec);
+  for (uint64_t i=0;i<count;i++) {
+    char * slot=&slot_buffer[i * header->slot_size];
+    uint32_t type, length;
+    memcpy(&type, slot, sizeof(uint32_t));
+    memcpy(&length, &slot[sizeof(uint32_t)], sizeof(uint32_t));
+    // A length beyond the slot is the core's error, only what the slot holds is kept
+    if (length > header->slot_size - MAILBOX_SLOT_HEADER_SIZE) length=header->slot_size - MAILBOX_SLOT_HEADER_SIZE;
+    fwrite(&timestamp_ns, sizeof(uint64_t), 1, core->record_file);
+    fwrite(&type, sizeof(uint32_t), 1, core->record_file);
+    fwrite(&length, sizeof(uint32_t), 1, core->record_file);
+    fwrite(&slot[MAILBOX_SLOT_HEADER_SIZE], sizeof(char), length, core->record_file);
+    core->bytes_drained+=length;
+  }
+  fflush(core->record_file);
+  core->records_drained+=count;
+}
+
+static bool is_valid_mailbox(struct mailbox_header * header) {
+  if (header->magic != MAILBOX_MAGIC || header->number_slots == 0 || header->slot_size < MAILBOX_SLOT_HEADER_SIZE) return false;
+  return MAILBOX_HEADER_SIZE + ((uint64_t) header->number_slots * header->slot_size) <= MAILBOX_REGION_SIZE;
+}
+
+static uint64_t get_mailbox_address(int core_id) {
+  if (shared_mailboxes) return shared_space_size - ((uint64_t) (core_id + 1) * MAILBOX_REGION_SIZE);
+  return data_space_size - MAILBOX_REGION_SIZE;
+}
+
+static void read_mailbox(int core_id, uint64_t offset, char * data, uint64_t size) {
+  if (shared_mailboxes) {
+    check_device_status(mailbox_sweeper.drivers.device_read_data(get_mailbox_address(core_id) + offset, data, size));
+  } else {
+    check_device_status(mailbox_sweeper.drivers.device_read_core_data(core_id, get_mailbox_address(core_id) + offset, data, size));
+  }
+}
+
+static void write_mailbox(int core_id, uint64_t offset, const char * data, uint64_t size) {
+  if (shared_mailboxes) {
+    check_device_status(mailbox_sweeper.drivers.device_write_data(get_mailbox_address(core_id) + offset, data, size));
+  } else {
+    check_device_status(mailbox_sweeper.drivers.device_write_core_data(core_id, get_mailbox_address(core_id) + offset, data, size));
+  }
+}
+
+// Shared data memory is not owned by any one core, so it is accessed under the whole device lock
+static void lock_mailbox(int core_id) {
+  if (shared_mailboxes) {
+    lock_device();
+  } else {
+    lock_device_core(core_id);
+  }
+}
+
+static void unlock_mailbox(int core_id) {
+  if (shared_mailboxes) {
+    unlock_device();
+  } else {
+    unlock_device_core(core_id);
+  }
+}
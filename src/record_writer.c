@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "record_writer.h"
+#include "uart_ring.h"
+
+/**
+ * Moves records (such as timestamped UART data or decoded frames) from the pollers to files without the pollers ever
+ * waiting on file I/O. A poller pushes each record whole into its core's ring, or drops it and counts its bytes if the
+ * ring is full, and a background thread per writer drains the rings through the owner's drain function. Whilst there
+ * are records to move the thread keeps draining, otherwise it checks back every interval. Everything still held is
+ * drained on exit, the writer's lock keeping that from interleaving with the thread. A drain that fails exits with the
+ * writer's lock held, so the exit flush passes over any writer the exiting thread is draining rather than waiting on
+ * itself
+ */
+
+static struct record_writer * writers[RECORD_WRITER_MAX_WRITERS];
+static int number_writers=0;
+
+static void * record_writer_thread(void*);
+static bool drain_record_writer(struct record_writer*, bool);
+static void flush_record_writers_at_exit(void);
+
+/**
+ * Creates the directory the writer's files go in if need be, failing up front if they could not be written there
+ * rather than once the writer's thread comes to open them
+ */
+void prepare_record_directory(char * directory, char * name) {
+  mkdir(directory, 0755);
+  if (access(directory, W_OK | X_OK) != 0) {
+    fprintf(stderr, "Error, can not write %s files in '%s'\n", name, directory);
+    exit(-1);
+  }
+}
+
+void initialise_record_writer(struct record_writer * writer, int number_rings, uint64_t ring_bytes) {
+  writer->number_rings=number_rings;
+  writer->rings=(struct uart_ring*) malloc(sizeof(struct uart_ring) * number_rings);
+  for (int i=0;i<number_rings;i++) initialise_uart_ring(&writer->rings[i], ring_bytes);
+  pthread_mutex_init(&writer->mutex, NULL);
+  writer->draining=false;
+}
+
+void start_record_writer(struct record_writer * writer, unsigned int interval_ms, record_drain drain, char * name) {
+  writer->interval_ms=interval_ms;
+  writer->drain=drain;
+  if (number_writers == RECORD_WRITER_MAX_WRITERS) {
+    fprintf(stderr, "Error, too many record writers to start the %s writer\n", name);
+    exit(-1);
+  }
+  if (number_writers == 0) atexit(flush_record_writers_at_exit);
+  writers[number_writers++]=writer;
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, &record_writer_thread, writer)) {
+    fprintf(stderr, "Error creating %s writer thread\n", name);
+    exit(-1);
+  }
+  pthread_detach(thread);
+}
+
+/**
+ * Called by the poller owning the ring, the record's header and data are pushed together so that once the drain sees
+ * a header the data is there too. Returns false if the ring is full, in which case the data's bytes are counted as
+ * dropped
+ */
+bool push_record(struct record_writer * writer, int ring_index, const char * header, unsigned int header_length, const char * data, unsigned int length) {
+  struct uart_ring * ring=&writer->rings[ring_index];
+  if (ring->capacity - uart_ring_used(ring) < header_length + length) {
+    atomic_fetch_add_explicit(&ring->dropped_bytes, length, memory_order_relaxed);
+    return false;
+  }
+  char record[header_length + length];
+  memcpy(record, header, header_length);
+  memcpy(&record[header_length], data, length);
+  uart_ring_push(ring, record, header_length + length);
+  return true;
+}
+
+uint64_t get_record_dropped_bytes(struct record_writer * writer, int ring_index) {
+  return atomic_load(&writer->rings[ring_index].dropped_bytes);
+}
+
+static void * record_writer_thread(void * args) {
+  struct record_writer * writer=(struct record_writer*) args;
+  while (true) {
+    if (!drain_record_writer(writer, false)) usleep(writer->interval_ms * 1000);
+  }
+  return NULL;
+}
+
+static bool drain_record_writer(struct record_writer * writer, bool flush_all) {
+  pthread_mutex_lock(&writer->mutex);
+  writer->drain_thread=pthread_self();
+  atomic_store(&writer->draining, true);
+  bool drained=writer->drain(writer, flush_all);
+  atomic_store(&writer->draining, false);
+  pthread_mutex_unlock(&writer->mutex);
+  return drained;
+}
+
+static void flush_record_writers_at_exit() {
+  for (int i=0;i<number_writers;i++) {
+    // Only this thread sets draining for itself, so if it is set with this thread as the drainer it is exiting mid drain
+    if (atomic_load(&writers[i]->draining) && pthread_equal(writers[i]->drain_thread, pthread_self())) continue;
+    drain_record_writer(writers[i], true);
+  }
+}
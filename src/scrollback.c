@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <string.h>
+#include "scrollback.h"
+
+/**
+ * Lines are held as text terminated by newlines in a circular arena, positions within it are offsets from the oldest
+ * byte held. The newest line may be incomplete, as the rest of it has not yet been received
+ */
+
+static char get_scrollback_byte(struct scrollback*, uint64_t);
+static void evict_oldest_line(struct scrollback*);
+
+void initialise_scrollback(struct scrollback * scrollback, uint64_t capacity) {
+  scrollback->buffer=(char*) malloc(sizeof(char) * capacity);
+  scrollback->capacity=capacity;
+  scrollback->start=0;
+  scrollback->length=0;
+  scrollback->total_lines=0;
+}
+
+/**
+ * Appends output, with carriage returns removed, evicting the oldest lines once the arena is full
+ */
+void append_scrollback(struct scrollback * scrollback, const char * data, uint64_t length) {
+  for (uint64_t i=0;i<length;i++) {
+    if (data[i] == '\r') continue;
+    if (scrollback->length == scrollback->capacity) evict_oldest_line(scrollback);
+    scrollback->buffer[(scrollback->start + scrollback->length) % scrollback->capacity]=data[i];
+    scrollback->length++;
+    if (data[i] == '\n') scrollback->total_lines++;
+  }
+}
+
+/**
+ * Returns the position of the start of the line the given number of lines back from the newest, 0 being the newest.
+ * Asking for more lines back than are held gives the oldest line
+ */
+uint64_t find_scrollback_line(struct scrollback * scrollback, uint64_t lines_back) {
+  uint64_t position=scrollback->length;
+  // The newest line ends at its newline, if it has been completed
+  if (position > 0 && get_scrollback_byte(scrollback, position - 1) == '\n') position--;
+  while (position > 0) {
+    if (get_scrollback_byte(scrollback, position - 1) == '\n') {
+      if (lines_back == 0) return position;
+      lines_back--;
+    }
+    position--;
+  }
+  return 0;
+}
+
+/**
+ * Copies the line at the position into the target, truncated to fit its size, and moves the position on to the next
+ * line. Returns false if there are no more lines
+ */
+bool read_scrollback_line(struct scrollback * scrollback, uint64_t * position, char * target, unsigned int target_size) {
+  if (*position >= scrollback->length) return false;
+  unsigned int copied=0;
+  while (*position < scrollback->length) {
+    char value=get_scrollback_byte(scrollback, (*position)++);
+    if (value == '\n') break;
+    if (copied < target_size - 1) target[copied++]=value;
+  }
+  target[copied]='\0';
+  return true;
+}
+
+static char get_scrollback_byte(struct scrollback * scrollback, uint64_t position) {
+  return scrollback->buffer[(scrollback->start + position) % scrollback->capacity];
+}
+
+// A line as long as the whole arena has no newline to stop at, so it is evicted entirely
+static void evict_oldest_line(struct scrollback * scrollback) {
+  uint64_t evicted=0;
+  while (evicted < scrollback->length && get_scrollback_byte(scrollback, evicted) != '\n') evicted++;
+  if (evicted < scrollback->length) evicted++;
+  scrollback->start=(scrollback->start + evicted) % scrollback->capacity;
+  scrollback->length-=evicted;
+}
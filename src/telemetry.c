@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include "telemetry.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "device_lock.h"
+
+/**
+ * Samples the host board status (temperature and power draw) in the background at the configured rate into a fixed
+ * size ring, the oldest samples being overwritten once it is full. Power is integrated into the energy used by each
+ * run, from the cores being started until they are stopped, with overlapping runs (such as queued jobs) counted as one
+ * run whilst any is in progress. The board status belongs to no core, so the sampler only holds up UART polling on
+ * backends that allow no concurrent access at all
+ */
+
+static struct telemetry_sample * samples=NULL;
+static uint64_t number_samples=0;
+// A copy, as the sampler may still be running whilst launchpad exits
+static struct device_drivers telemetry_drivers;
+static struct timespec sampler_start_time;
+static unsigned int sample_period_us;
+static char * exit_csv_filename=NULL;
+// Guards the ring and the run accounting, which the sampler updates and the start and stop paths drive
+static pthread_mutex_t telemetry_mutex=PTHREAD_MUTEX_INITIALIZER;
+static int run_depth=0;
+static bool run_active=false, run_sampled=false, have_last_sample=false;
+static double run_start_sec, run_end_sec, run_energy_joules, run_peak_temp, last_sample_sec;
+static float last_power_draw, last_temp;
+
+static void * telemetry_sampler_thread(void*);
+static void record_sample(double, struct host_board_status*);
+static void write_csv_at_exit(void);
+static double get_sampler_seconds(void);
+
+void start_telemetry_sampler(struct launchpad_configuration * config, struct device_drivers * active_device_drivers) {
+  if (config->telemetry_hz == 0) return;
+  telemetry_drivers=*active_device_drivers;
+  sample_period_us=config->telemetry_hz < 1000000 ? 1000000 / config->telemetry_hz : 1;
+  samples=(struct telemetry_sample*) malloc(sizeof(struct telemetry_sample) * TELEMETRY_RING_SAMPLES);
+  clock_gettime(CLOCK_MONOTONIC, &sampler_start_time);
+  if (config->telemetry_csv != NULL) {
+    exit_csv_filename=config->telemetry_csv;
+    atexit(write_csv_at_exit);
+  }
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, &telemetry_sampler_thread, NULL)) {
+    fprintf(stderr, "Error creating telemetry sampler thread\n");
+    exit(-1);
+  }
+  pthread_detach(thread);
+}
+
+void begin_energy_run() {
+  if (samples == NULL) return;
+  pthread_mutex_lock(&telemetry_mutex);
+  if (run_depth++ == 0) {
+    run_active=true;
+    run_sampled=true;
+    run_start_sec=get_sampler_seconds();
+    run_energy_joules=0.0;
+    run_peak_temp=have_last_sample ? last_temp : 0.0;
+  }
+  pthread_mutex_unlock(&telemetry_mutex);
+}
+
+/**
+ * The power last sampled is carried on to the end of the run, as it is between samples
+ */
+void end_energy_run() {
+  if (samples == NULL) return;
+  pthread_mutex_lock(&telemetry_mutex);
+  if (run_depth > 0 && --run_depth == 0) {
+    run_end_sec=get_sampler_seconds();
+    if (have_last_sample) {
+      double from=last_sample_sec > run_start_sec ? last_sample_sec : run_start_sec;
+      run_energy_joules+=last_power_draw * (run_end_sec - from);
+    }
+    run_active=false;
+  }
+  pthread_mutex_unlock(&telemetry_mutex);
+}
+
+void get_energy_summary(struct energy_summary * summary) {
+  memset(summary, 0, sizeof(struct energy_summary));
+  if (samples == NULL) return;
+  pthread_mutex_lock(&telemetry_mutex);
+  summary->sampled=run_sampled;
+  summary->run_active=run_active;
+  summary->energy_joules=run_energy_joules;
+  summary->peak_temp=run_peak_temp;
+  if (run_active) {
+    double now=get_sampler_seconds();
+    summary->run_seconds=now - run_start_sec;
+    if (have_last_sample) {
+      double from=last_sample_sec > run_start_sec ? last_sample_sec : run_start_sec;
+      summary->energy_joules+=last_power_draw * (now - from);
+    }
+  } else {
+    summary->run_seconds=run_end_sec - run_start_sec;
+  }
+  pthread_mutex_unlock(&telemetry_mutex);
+  summary->average_power=summary->run_seconds > 0 ? summary->energy_joules / summary->run_seconds : 0.0;
+}
+
+void describe_energy(char * target) {
+  struct energy_summary summary;
+  get_energy_summary(&summary);
+  if (samples == NULL) {
+    sprintf(target, "Energy: not sampled, board telemetry is disabled");
+  } else if (!summary.sampled) {
+    sprintf(target, "Energy: no run has been sampled yet");
+  } else {
+    sprintf(target, "Energy of %s run: %.3fJ over %.3fs, average power %.2fW, peak temperature %.1fC", summary.run_active ? "current" : "last",
+      summary.energy_joules, summary.run_seconds, summary.average_power, summary.peak_temp);
+  }
+}
+
+/**
+ * Writes the samples held in the ring to a CSV file, oldest first, returning false and setting the message on error
+ */
+bool export_telemetry_csv(char * filename, char * message) {
+  if (samples == NULL) {
+    snprintf(message, TELEMETRY_MESSAGE_SIZE, "Board telemetry is disabled, enable it with -telemetry");
+    return false;
+  }
+  FILE * csv_file=fopen(filename, "w");
+  if (csv_file == NULL) {
+    snprintf(message, TELEMETRY_MESSAGE_SIZE, "Can not open '%s' for writing", filename);
+    return false;
+  }
+  // Copied out so that the sampler is not held up by the file writes
+  struct telemetry_sample * copy=(struct telemetry_sample*) malloc(sizeof(struct telemetry_sample) * TELEMETRY_RING_SAMPLES);
+  pthread_mutex_lock(&telemetry_mutex);
+  uint64_t first=number_samples > TELEMETRY_RING_SAMPLES ? number_samples - TELEMETRY_RING_SAMPLES : 0, count=number_samples - first;
+  for (uint64_t i=0;i<count;i++) copy[i]=samples[(first + i) % TELEMETRY_RING_SAMPLES];
+  pthread_mutex_unlock(&telemetry_mutex);
+
+  fprintf(csv_file, "time_sec,temperature_c,power_w,in_run\n");
+  for (uint64_t i=0;i<count;i++) {
+    fprintf(csv_file, "%.6f,%.2f,%.3f,%d\n", copy[i].time_sec, copy[i].temp, copy[i].power_draw, copy[i].in_run ? 1 : 0);
+  }
+  fclose(csv_file);
+  free(copy);
+  snprintf(message, TELEMETRY_MESSAGE_SIZE, "Wrote %ld telemetry samples to '%s'", count, filename);
+  return true;
+}
+
+static void * telemetry_sampler_thread(void * args) {
+  struct timespec next_sample=sampler_start_time;
+  while (true) {
+    struct host_board_status board_status;
+    // A failed read is skipped rather than ending launchpad, the next sample is likely to succeed
+    lock_device_board_status();
+    LP_STATUS_CODE status=telemetry_drivers.device_get_host_board_status(&board_status);
+    unlock_device_board_status();
+    if (status == LP_SUCCESS) record_sample(get_sampler_seconds(), &board_status);
+    next_sample.tv_nsec+=(long) sample_period_us * 1000;
+    while (next_sample.tv_nsec >= 1000000000) {
+      next_sample.tv_nsec-=1000000000;
+      next_sample.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_sample, NULL);
+  }
+  return NULL;
+}
+
+/**
+ * Power is integrated with the trapezoidal rule between samples, the first sample of a run covers back to its start
+ */
+static void record_sample(double time_sec, struct host_board_status * board_status) {
+  pthread_mutex_lock(&telemetry_mutex);
+  struct telemetry_sample * sample=&samples[number_samples++ % TELEMETRY_RING_SAMPLES];
+  sample->time_sec=time_sec;
+  sample->temp=board_status->temp;
+  sample->power_draw=board_status->power_draw;
+  sample->in_run=run_active;
+  if (run_active) {
+    if (have_last_sample && last_sample_sec >= run_start_sec) {
+      run_energy_joules+=((last_power_draw + board_status->power_draw) / 2) * (time_sec - last_sample_sec);
+    } else {
+      run_energy_joules+=board_status->power_draw * (time_sec - run_start_sec);
+    }
+    if (board_status->temp > run_peak_temp) run_peak_temp=board_status->temp;
+  }
+  last_sample_sec=time_sec;
+  last_power_draw=board_status->power_draw;
+  last_temp=board_status->temp;
+  have_last_sample=true;
+  pthread_mutex_unlock(&telemetry_mutex);
+}
+
+static void write_csv_at_exit() {
+  char message[TELEMETRY_MESSAGE_SIZE];
+  if (!export_telemetry_csv(exit_csv_filename, message)) fprintf(stderr, "Error, %s\n", message);
+}
+
+static double get_sampler_seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - sampler_start_time.tv_sec) + ((now.tv_nsec - sampler_start_time.tv_nsec) / 1e9);
+}
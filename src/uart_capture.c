@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <zlib.h>
+#include "uart_capture.h"
+#include "record_writer.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "board.h"
+
+/**
+ * Captures everything the cores print to a log file per core, so output is kept after it has scrolled off the screen.
+ * The pollers stamp each batch of UART data with the host monotonic time and push it as a record to a record writer,
+ * which never blocks, a full ring drops the record and counts its bytes. The writer's thread drains the records into
+ * blocks, compresses each block and appends it to the core's log (core_n.log) along with an entry in the core's index
+ * (core_n.idx) holding the block's time span and offset, so a reader can seek straight to a time without decompressing
+ * what came before. Blocks are written once full or a second old, and whatever remains on exit
+ */
+
+struct capture_core_state {
+  FILE * log_file, * index_file;
+  char * block;
+  uint32_t block_length;
+  uint64_t block_first_ns, block_last_ns, file_offset;
+};
+
+struct capture_dump_state {
+  uint64_t from_ns, line_start_ns;
+  char * line_buffer;
+  unsigned int line_length;
+  bool partial_line;
+};
+
+static struct capture_core_state * capture_cores=NULL;
+static int number_capture_cores;
+static char * capture_dir;
+static struct timespec capture_start_time;
+static char * compressed_block;
+static struct record_writer capture_writer;
+
+static bool drain_capture_rings(struct record_writer*, bool);
+static void write_capture_block(int);
+static void open_capture_files(int);
+static bool dump_capture_block(FILE*, struct capture_index_entry*, char*, struct capture_dump_state*);
+static int encode_varint(char*, uint64_t);
+static bool decode_varint(char*, uint64_t, uint64_t*, uint64_t*);
+static uint64_t get_capture_ns(struct timespec*);
+
+void start_uart_capture(struct launchpad_configuration * config, struct device_configuration * device_config) {
+  if (config->capture_dir == NULL) return;
+  capture_dir=config->capture_dir;
+  prepare_record_directory(capture_dir, "UART capture");
+  number_capture_cores=device_config->number_cores;
+  clock_gettime(CLOCK_MONOTONIC, &capture_start_time);
+  compressed_block=(char*) malloc(sizeof(char) * compressBound(CAPTURE_BLOCK_SIZE));
+  struct capture_core_state * cores=(struct capture_core_state*) malloc(sizeof(struct capture_core_state) * number_capture_cores);
+  memset(cores, 0, sizeof(struct capture_core_state) * number_capture_cores);
+  initialise_record_writer(&capture_writer, number_capture_cores, (uint64_t) config->uart_buffer_kb * 1024);
+  capture_cores=cores;
+  start_record_writer(&capture_writer, CAPTURE_WRITER_INTERVAL_MS, drain_capture_rings, "UART capture");
+}
+
+bool is_uart_capture_enabled() {
+  return capture_cores != NULL;
+}
+
+/**
+ * Called by the poller owning the core with data just read and the time it was read, the record is pushed whole or
+ * not at all
+ */
+void capture_uart_data(int core_id, const char * data, unsigned int length, struct timespec * read_time) {
+  if (capture_cores == NULL) return;
+  char header[CAPTURE_RECORD_HEADER_SIZE];
+  uint64_t timestamp_ns=get_capture_ns(read_time);
+  uint32_t record_length=length;
+  memcpy(header, &timestamp_ns, sizeof(uint64_t));
+  memcpy(&header[sizeof(uint64_t)], &record_length, sizeof(uint32_t));
+  push_record(&capture_writer, core_id, header, CAPTURE_RECORD_HEADER_SIZE, data, length);
+}
+
+uint64_t get_capture_dropped_bytes(int core_id) {
+  if (capture_cores == NULL) return 0;
+  return get_record_dropped_bytes(&capture_writer, core_id);
+}
+
+/**
+ * Prints a core's captured output from a point in time, given as core[@seconds], with each line tagged by the time
+ * its first byte was read. The index locates the first block that reaches that time, so only blocks from there on
+ * are decompressed
+ */
+int dump_uart_capture(struct launchpad_configuration * config) {
+  if (config->capture_dir == NULL) {
+    fprintf(stderr, "Error, reading a capture requires its directory to be given with -capture\n");
+    return -1;
+  }
+  char core_name[strlen(config->capture_dump_spec) + 1];
+  strcpy(core_name, config->capture_dump_spec);
+  uint64_t from_ns=0;
+  char * time_separator=strchr(core_name, '@');
+  if (time_separator != NULL) {
+    *time_separator='\0';
+    from_ns=(uint64_t) (atof(time_separator+1) * 1e9);
+  }
+  char filename[strlen(config->capture_dir) + strlen(core_name) + 32];
+  sprintf(filename, "%s/core_%s.idx", config->capture_dir, core_name);
+  FILE * index_file=fopen(filename, "r");
+  sprintf(filename, "%s/core_%s.log", config->capture_dir, core_name);
+  FILE * log_file=fopen(filename, "r");
+  if (index_file == NULL || log_file == NULL) {
+    fprintf(stderr, "Error, no capture of core %s in '%s'\n", core_name, config->capture_dir);
+    return -1;
+  }
+  char * block=(char*) malloc(sizeof(char) * CAPTURE_BLOCK_SIZE);
+  struct capture_dump_state state;
+  memset(&state, 0, sizeof(struct capture_dump_state));
+  state.from_ns=from_ns;
+  state.line_buffer=(char*) malloc(sizeof(char) * (CAPTURE_LINE_SIZE + 1));
+  struct capture_index_entry entry;
+  bool found=false, valid=true;
+  while (valid && fread(&entry, sizeof(struct capture_index_entry), 1, index_file) == 1) {
+    if (!found && entry.last_timestamp_ns < from_ns) continue;
+    if (!found && entry.first_timestamp_ns < from_ns) state.partial_line=true;
+    found=true;
+    valid=dump_capture_block(log_file, &entry, block, &state);
+  }
+  if (state.line_length > 0) {
+    state.line_buffer[state.line_length]='\0';
+    printf("[+%.6fs]: %s\n", state.line_start_ns / 1e9, state.line_buffer);
+  }
+  fclose(index_file);
+  fclose(log_file);
+  free(block);
+  free(state.line_buffer);
+  if (!valid) {
+    fprintf(stderr, "Error, the capture of core %s is corrupt\n", core_name);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Moves the records from each core's ring into its block, writing the block out when full, when it has been held for
+ * the flush interval or, if requested, whenever it holds anything. In a block each record's timestamp is encoded as the
+ * variable length difference in microseconds from the previous one, which compresses far better than the raw times.
+ * Returns whether any records were moved
+ */
+static bool drain_capture_rings(struct record_writer * writer, bool flush_all) {
+  bool drained=false;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t now_ns=get_capture_ns(&now);
+  for (int i=0;i<number_capture_cores;i++) {
+    struct capture_core_state * core=&capture_cores[i];
+    struct uart_ring * ring=&writer->rings[i];
+    char header[CAPTURE_RECORD_HEADER_SIZE];
+    while (uart_ring_used(ring) >= CAPTURE_RECORD_HEADER_SIZE) {
+      if (core->block == NULL) {
+        open_capture_files(i);
+        core->block=(char*) malloc(sizeof(char) * CAPTURE_BLOCK_SIZE);
+      }
+      // Records are pushed whole, so once the header is there so is the data
+      uart_ring_pop(ring, header, CAPTURE_RECORD_HEADER_SIZE);
+      drained=true;
+      uint64_t timestamp_ns;
+      uint32_t length;
+      memcpy(&timestamp_ns, header, sizeof(uint64_t));
+      memcpy(&length, &header[sizeof(uint64_t)], sizeof(uint32_t));
+      if (core->block_length + CAPTURE_MAX_ENCODED_HEADER_SIZE + length > CAPTURE_BLOCK_SIZE) write_capture_block(i);
+      if (core->block_length == 0) core->block_first_ns=timestamp_ns;
+      uint64_t previous_ns=core->block_length == 0 ? core->block_first_ns : core->block_last_ns;
+      core->block_length+=encode_varint(&core->block[core->block_length], (timestamp_ns / 1000) - (previous_ns / 1000));
+      core->block_length+=encode_varint(&core->block[core->block_length], length);
+      core->block_last_ns=timestamp_ns;
+      uart_ring_pop(ring, &core->block[core->block_length], length);
+      core->block_length+=length;
+    }
+    if (core->block_length > 0 && (flush_all || now_ns - core->block_first_ns >= (uint64_t) CAPTURE_FLUSH_INTERVAL_MS * 1000000)) {
+      write_capture_block(i);
+    }
+  }
+  return drained;
+}
+
+static void write_capture_block(int core_id) {
+  struct capture_core_state * core=&capture_cores[core_id];
+  uLongf compressed_length=compressBound(CAPTURE_BLOCK_SIZE);
+  if (compress2((Bytef*) compressed_block, &compressed_length, (Bytef*) core->block, core->block_length, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    fprintf(stderr, "Error compressing UART capture block\n");
+    exit(-1);
+  }
+  struct capture_index_entry entry;
+  entry.first_timestamp_ns=core->block_first_ns;
+  entry.last_timestamp_ns=core->block_last_ns;
+  entry.file_offset=core->file_offset;
+  entry.compressed_length=compressed_length;
+  entry.raw_length=core->block_length;
+  // Each block also carries its lengths, so the log can be read without the index
+  fwrite(&entry.compressed_length, sizeof(uint32_t), 1, core->log_file);
+  fwrite(&entry.raw_length, sizeof(uint32_t), 1, core->log_file);
+  fwrite(compressed_block, sizeof(char), compressed_length, core->log_file);
+  fwrite(&entry, sizeof(struct capture_index_entry), 1, core->index_file);
+  fflush(core->log_file);
+  fflush(core->index_file);
+  core->file_offset+=CAPTURE_BLOCK_HEADER_SIZE + compressed_length;
+  core->block_length=0;
+}
+
+static void open_capture_files(int core_id) {
+  char filename[strlen(capture_dir) + BOARD_CORE_NAME_SIZE + 32], core_name[BOARD_CORE_NAME_SIZE];
+  describe_core(core_id, core_name);
+  sprintf(filename, "%s/core_%s.log", capture_dir, core_name);
+  capture_cores[core_id].log_file=fopen(filename, "w");
+  sprintf(filename, "%s/core_%s.idx", capture_dir, core_name);
+  capture_cores[core_id].index_file=fopen(filename, "w");
+  if (capture_cores[core_id].log_file == NULL || capture_cores[core_id].index_file == NULL) {
+    fprintf(stderr, "Error opening UART capture files for core %s in '%s'\n", core_name, capture_dir);
+    exit(-1);
+  }
+}
+
+/**
+ * Decompresses the block and prints the lines in it from the dump's start time, a line carrying on from the previous
+ * block is continued in the line buffer. Returns false if the block can not be read
+ */
+static bool dump_capture_block(FILE * log_file, struct capture_index_entry * entry, char * block, struct capture_dump_state * state) {
+  char compressed[entry->compressed_length];
+  uLongf raw_length=CAPTURE_BLOCK_SIZE;
+  if (fseek(log_file, entry->file_offset + CAPTURE_BLOCK_HEADER_SIZE, SEEK_SET) != 0) return false;
+  if (fread(compressed, sizeof(char), entry->compressed_length, log_file) != entry->compressed_length) return false;
+  if (uncompress((Bytef*) block, &raw_length, (Bytef*) compressed, entry->compressed_length) != Z_OK || raw_length != entry->raw_length) return false;
+  uint64_t position=0, timestamp_ns=(entry->first_timestamp_ns / 1000) * 1000;
+  while (position < raw_length) {
+    uint64_t delta_us, length;
+    if (!decode_varint(block, raw_length, &position, &delta_us) || !decode_varint(block, raw_length, &position, &length)) return false;
+    if (position + length > raw_length) return false;
+    timestamp_ns+=delta_us * 1000;
+    char * data=&block[position];
+    position+=length;
+    for (uint64_t i=0;i<length;i++) {
+      if (timestamp_ns < state->from_ns || state->partial_line) {
+        // Output starts at the first whole line from the start time
+        state->partial_line=data[i] != '\n';
+        continue;
+      }
+      if (state->line_length == 0) state->line_start_ns=timestamp_ns;
+      if (data[i] != '\r' && data[i] != '\n') state->line_buffer[state->line_length++]=data[i];
+      if (data[i] == '\n' || state->line_length == CAPTURE_LINE_SIZE) {
+        state->line_buffer[state->line_length]='\0';
+        printf("[+%.6fs]: %s\n", state->line_start_ns / 1e9, state->line_buffer);
+        state->line_length=0;
+      }
+    }
+  }
+  return true;
+}
+
+static int encode_varint(char * target, uint64_t value) {
+  int length=0;
+  while (value >= 0x80) {
+    target[length++]=(char) ((value & 0x7f) | 0x80);
+    value>>=7;
+  }
+  target[length++]=(char) value;
+  return length;
+}
+
+static bool decode_varint(char * source, uint64_t source_length, uint64_t * position, uint64_t * value) {
+  *value=0;
+  for (int shift=0;shift<64 && *position<source_length;shift+=7) {
+    unsigned char byte=(unsigned char) source[(*position)++];
+    *value|=((uint64_t) (byte & 0x7f)) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+static uint64_t get_capture_ns(struct timespec * time) {
+  return ((time->tv_sec - capture_start_time.tv_sec) * 1000000000) + (time->tv_nsec - capture_start_time.tv_nsec);
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "uart_frame.h"
+#include "record_writer.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "board.h"
+#include "counter.h"
+
+/**
+ * Decodes binary frames that cores interleave with their text output, so numbers can be sent without being printed
+ * and parsed. The poller owning a core runs the core's data through its decoder, which separates the frames out and
+ * passes only the text on to the display, capture and line counts. A frame can span any number of reads, the decoder
+ * keeping its place between them. Each decoded frame is handed to the consumer callback, if one is set, and with
+ * -frames pushed as a record to a record writer that drains them to the core's stream file (core_n.frames), so the
+ * poller never waits on file I/O. A frame with a bad checksum or length is dropped and counted
+ */
+
+enum frame_decoder_stage {FRAME_TEXT, FRAME_SYNC, FRAME_HEADER, FRAME_PAYLOAD, FRAME_CHECKSUM};
+
+// Only ever touched by the poller owning the core, apart from the counters which are read for the statistics
+struct frame_decoder_state {
+  _Alignas(64) _Atomic uint64_t frames_received, frame_bytes, frame_errors;
+  enum frame_decoder_stage stage;
+  unsigned char header[UART_FRAME_HEADER_SIZE], checksum[UART_FRAME_CHECKSUM_SIZE];
+  unsigned int position, payload_length, sum1, sum2;
+  char payload[UART_FRAME_MAX_PAYLOAD];
+};
+
+static struct frame_decoder_state * decoders=NULL;
+// Each core's stream file, opened on its first frame
+static FILE ** streams=NULL;
+static int number_frame_cores;
+static char * frames_dir;
+static uart_frame_consumer frame_consumer=NULL;
+static struct timespec decoding_start_time;
+static struct record_writer frame_writer;
+
+static void deliver_frame(int, struct frame_decoder_state*, struct timespec*);
+static void update_frame_checksum(struct frame_decoder_state*, unsigned char);
+static bool drain_frame_rings(struct record_writer*, bool);
+static void open_frame_stream(int);
+
+/**
+ * Sets the callback receiving every decoded frame, which must be done before decoding is started. It is called with the
+ * core's device lock held, so must not take device locks itself
+ */
+void set_uart_frame_consumer(uart_frame_consumer consumer) {
+  frame_consumer=consumer;
+}
+
+void start_uart_frame_decoding(struct launchpad_configuration * config, struct device_configuration * device_config) {
+  if (config->frames_dir == NULL && frame_consumer == NULL) return;
+  number_frame_cores=device_config->number_cores;
+  clock_gettime(CLOCK_MONOTONIC, &decoding_start_time);
+  struct frame_decoder_state * core_decoders=(struct frame_decoder_state*) aligned_alloc(64, sizeof(struct frame_decoder_state) * number_frame_cores);
+  memset(core_decoders, 0, sizeof(struct frame_decoder_state) * number_frame_cores);
+  if (config->frames_dir != NULL) {
+    frames_dir=config->frames_dir;
+    prepare_record_directory(frames_dir, "UART frame");
+    initialise_record_writer(&frame_writer, number_frame_cores, (uint64_t) config->uart_buffer_kb * 1024);
+    streams=(FILE**) calloc(number_frame_cores, sizeof(FILE*));
+    start_record_writer(&frame_writer, UART_FRAME_WRITER_INTERVAL_MS, drain_frame_rings, "UART frame");
+  }
+  decoders=core_decoders;
+}
+
+bool is_uart_frame_decoding_enabled() {
+  return decoders != NULL;
+}
+
+/**
+ * Called by the poller owning the core with data just read and the time it was read. The text around any frames is
+ * copied to text, which must hold a byte more than the data as a sync byte held back from the last read may turn out
+ * to be text, returning the number of text bytes
+ */
+unsigned int decode_uart_frames(int core_id, const char * data, unsigned int length, char * text, struct timespec * read_time) {
+  struct frame_decoder_state * decoder=&decoders[core_id];
+  unsigned int text_length=0;
+  for (unsigned int i=0;i<length;i++) {
+    unsigned char byte=(unsigned char) data[i];
+    switch (decoder->stage) {
+      case FRAME_TEXT:
+        if (byte == UART_FRAME_SYNC_0) {
+          decoder->stage=FRAME_SYNC;
+        } else {
+          text[text_length++]=data[i];
+        }
+        break;
+      case FRAME_SYNC:
+        if (byte == UART_FRAME_SYNC_1) {
+          decoder->stage=FRAME_HEADER;
+          decoder->position=2;
+          decoder->sum1=decoder->sum2=0;
+        } else {
+          // Not a frame after all, so the held back byte was text
+          text[text_length++]=(char) UART_FRAME_SYNC_0;
+          if (byte == UART_FRAME_SYNC_0) break;
+          text[text_length++]=data[i];
+          decoder->stage=FRAME_TEXT;
+        }
+        break;
+      case FRAME_HEADER:
+        decoder->header[decoder->position++]=byte;
+        update_frame_checksum(decoder, byte);
+        if (decoder->position == UART_FRAME_HEADER_SIZE) {
+          decoder->payload_length=decoder->header[3] | (decoder->header[4] << 8);
+          decoder->position=0;
+          if (decoder->payload_length > UART_FRAME_MAX_PAYLOAD) {
+            add_to_counter(&decoder->frame_errors, 1);
+            decoder->stage=FRAME_TEXT;
+          } else {
+            decoder->stage=decoder->payload_length > 0 ? FRAME_PAYLOAD : FRAME_CHECKSUM;
+          }
+        }
+        break;
+      case FRAME_PAYLOAD:
+        decoder->payload[decoder->position++]=(char) byte;
+        update_frame_checksum(decoder, byte);
+        if (decoder->position == decoder->payload_length) {
+          decoder->position=0;
+          decoder->stage=FRAME_CHECKSUM;
+        }
+        break;
+      case FRAME_CHECKSUM:
+        decoder->checksum[decoder->position++]=byte;
+        if (decoder->position == UART_FRAME_CHECKSUM_SIZE) {
+          if (decoder->checksum[0] == decoder->sum1 && decoder->checksum[1] == decoder->sum2) {
+            deliver_frame(core_id, decoder, read_time);
+          } else {
+            add_to_counter(&decoder->frame_errors, 1);
+          }
+          decoder->stage=FRAME_TEXT;
+        }
+        break;
+    }
+  }
+  return text_length;
+}
+
+void get_uart_frame_statistics(int core_id, uint64_t * frames_received, uint64_t * frame_bytes, uint64_t * frame_errors) {
+  if (decoders == NULL) {
+    *frames_received=*frame_bytes=*frame_errors=0;
+    return;
+  }
+  *frames_received=atomic_load(&decoders[core_id].frames_received);
+  *frame_bytes=atomic_load(&decoders[core_id].frame_bytes);
+  *frame_errors=atomic_load(&decoders[core_id].frame_errors);
+}
+
+/**
+ * The frame's record is pushed whole or not at all, a full ring drops it and counts it as an error
+ */
+static void deliver_frame(int core_id, struct frame_decoder_state * decoder, struct timespec * read_time) {
+  uint64_t timestamp_ns=((read_time->tv_sec - decoding_start_time.tv_sec) * 1000000000) + (read_time->tv_nsec - decoding_start_time.tv_nsec);
+  uint8_t type=decoder->header[2];
+  add_to_counter(&decoder->frames_received, 1);
+  add_to_counter(&decoder->frame_bytes, UART_FRAME_HEADER_SIZE + decoder->payload_length + UART_FRAME_CHECKSUM_SIZE);
+  if (frame_consumer != NULL) frame_consumer(core_id, type, decoder->payload, decoder->payload_length, timestamp_ns);
+  if (streams == NULL) return;
+  char header[UART_FRAME_RECORD_HEADER_SIZE];
+  uint16_t payload_length=decoder->payload_length;
+  memcpy(header, &timestamp_ns, sizeof(uint64_t));
+  header[sizeof(uint64_t)]=(char) type;
+  memcpy(&header[sizeof(uint64_t) + 1], &payload_length, sizeof(uint16_t));
+  if (!push_record(&frame_writer, core_id, header, UART_FRAME_RECORD_HEADER_SIZE, decoder->payload, decoder->payload_length)) {
+    add_to_counter(&decoder->frame_errors, 1);
+  }
+}
+
+// Fletcher-16 over the type, length and payload, kept up to date byte by byte as a frame can span reads
+static void update_frame_checksum(struct frame_decoder_state * decoder, unsigned char byte) {
+  decoder->sum1=(decoder->sum1 + byte) % 255;
+  decoder->sum2=(decoder->sum2 + decoder->sum1) % 255;
+}
+
+/**
+ * Moves the frame records from each core's ring to its stream file, which is flushed after every drain so there is
+ * nothing more to write out on exit. Returns whether any were moved
+ */
+static bool drain_frame_rings(struct record_writer * writer, bool flush_all) {
+  bool drained=false;
+  char buffer[UART_FRAME_RECORD_HEADER_SIZE + UART_FRAME_MAX_PAYLOAD];
+  for (int i=0;i<number_frame_cores;i++) {
+    struct uart_ring * ring=&writer->rings[i];
+    bool core_drained=false;
+    while (uart_ring_used(ring) >= UART_FRAME_RECORD_HEADER_SIZE) {
+      if (streams[i] == NULL) open_frame_stream(i);
+      // Records are pushed whole, so once the header is there so is the payload
+      uart_ring_pop(ring, buffer, UART_FRAME_RECORD_HEADER_SIZE);
+      uint16_t payload_length;
+      memcpy(&payload_length, &buffer[sizeof(uint64_t) + 1], sizeof(uint16_t));
+      uart_ring_pop(ring, &buffer[UART_FRAME_RECORD_HEADER_SIZE], payload_length);
+      fwrite(buffer, sizeof(char), UART_FRAME_RECORD_HEADER_SIZE + payload_length, streams[i]);
+      core_drained=true;
+    }
+    if (core_drained) {
+      fflush(streams[i]);
+      drained=true;
+    }
+  }
+  return drained;
+}
+
+static void open_frame_stream(int core_id) {
+  char filename[strlen(frames_dir) + BOARD_CORE_NAME_SIZE + 32], core_name[BOARD_CORE_NAME_SIZE];
+  describe_core(core_id, core_name);
+  sprintf(filename, "%s/core_%s.frames", frames_dir, core_name);
+  streams[core_id]=fopen(filename, "w");
+  if (streams[core_id] == NULL) {
+    fprintf(stderr, "Error opening UART frame stream for core %s in '%s'\n", core_name, frames_dir);
+    exit(-1);
+  }
+}
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "uart_headless.h"
+#include "uart_poll.h"
+#include "uart_ring.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "util.h"
+#include "device_lock.h"
+#include "board.h"
+#include "loader.h"
+#include "telemetry.h"
+#include "mailbox.h"
+#include "file_proxy.h"
+
+#define OUTPUT_FILE_BUFFER_SIZE 1048576
+#define HEADLESS_CHECK_INTERVAL_MS 100
+
+/**
+ * Non-interactive mode, streams each core's UART output to stdout (with every line tagged by the core id) or to a
+ * separate file per core, without ncurses. Completes when every active core has printed the sentinel string or
+ * stopped, or when the timeout expires, and returns the corresponding exit code. The daemon streams to its clients
+ * in the same way, and queued jobs capture the output of their cores with the same per core state
+ */
+
+static volatile sig_atomic_t interrupted=0;
+
+static void handle_interrupt(int);
+static FILE* open_core_output_file(char*, int);
+static void write_output_lines(FILE*, int, struct headless_core_state*, char*, uint64_t);
+static bool match_sentinel(struct headless_core_state*, char*, int*, char*, uint64_t);
+static double get_elapsed_seconds(struct timespec*);
+
+int headless_uart(struct launchpad_configuration * config, struct device_configuration * device_config,
+      struct device_drivers * active_device_drivers, struct current_device_status * device_status) {
+  if (!device_status->running) {
+    fprintf(stderr, "Error, batch mode requires an executable and active cores so that the cores are started\n");
+    return LP_BATCH_EXIT_ERROR;
+  }
+  if (config->batch_sentinel == NULL && config->batch_timeout_sec == 0 && active_device_drivers->device_get_core_running == NULL) {
+    fprintf(stderr, "Warning, no sentinel or timeout provided and the device can not report stopped cores, will run until interrupted\n");
+  }
+  char load_summary[1024];
+  describe_load_statistics(load_summary);
+  fprintf(stderr, "%s\n", load_summary);
+  signal(SIGINT, handle_interrupt);
+  signal(SIGTERM, handle_interrupt);
+
+  setvbuf(stdout, NULL, _IOFBF, OUTPUT_FILE_BUFFER_SIZE);
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  start_uart_pollers(config, device_config, active_device_drivers, true);
+  int exit_code=stream_uart_output(config, device_config, active_device_drivers, device_status, stdout, true);
+  // Records posted just before the cores finished are still to be drained
+  drain_mailboxes();
+  if (exit_code == LP_BATCH_EXIT_TIMEOUT) fprintf(stderr, "Batch run timed out after %d seconds\n", config->batch_timeout_sec);
+  fprintf(stderr, "Batch run finished in %.3f seconds\n", get_elapsed_seconds(&start_time));
+  // The pollers' statistics, as the interactive display shows on quitting
+  char * statistics=(char*) malloc(sizeof(char) * UART_STATISTICS_LINE_SIZE * (device_config->number_cores + 2));
+  describe_uart_statistics(config, device_config, statistics);
+  fprintf(stderr, "%s", statistics);
+  free(statistics);
+  if (config->telemetry_hz > 0) {
+    char energy_summary[TELEMETRY_MESSAGE_SIZE];
+    describe_energy(energy_summary);
+    fprintf(stderr, "%s\n", energy_summary);
+  }
+  if (is_mailbox_enabled()) {
+    char mailbox_summary[MAILBOX_MESSAGE_SIZE];
+    describe_mailboxes(mailbox_summary);
+    fprintf(stderr, "%s\n", mailbox_summary);
+  }
+  if (is_file_proxy_enabled()) {
+    char file_proxy_summary[FILE_PROXY_MESSAGE_SIZE];
+    describe_file_proxy(file_proxy_summary);
+    fprintf(stderr, "%s\n", file_proxy_summary);
+  }
+  return exit_code;
+}
+
+/**
+ * Streams the active cores' UART output, which the pollers must already be collecting, to the output (or the
+ * configured output directory) until the cores have completed, the timeout expires or the output can not be written.
+ * The cores are stopped at the end if requested, before their trailing output is collected
+ */
+int stream_uart_output(struct launchpad_configuration * config, struct device_configuration * device_config,
+      struct device_drivers * active_device_drivers, struct current_device_status * device_status, FILE * output, bool stop_cores) {
+  if (config->batch_output_dir != NULL) mkdir(config->batch_output_dir, 0755);
+  struct headless_core_state * core_states=(struct headless_core_state*) malloc(sizeof(struct headless_core_state) * device_config->number_cores);
+  for (int i=0;i<device_config->number_cores;i++) {
+    memset(&core_states[i], 0, sizeof(struct headless_core_state));
+    core_states[i].finished=!is_core_in_set(&config->active_cores, i);
+    if (!core_states[i].finished) {
+      if (config->batch_output_dir != NULL) {
+        core_states[i].output_file=open_core_output_file(config->batch_output_dir, i);
+      } else {
+        core_states[i].line_buffer=(char*) malloc(sizeof(char) * (HEADLESS_LINE_SIZE + 1));
+      }
+    }
+  }
+  int * sentinel_failure=config->batch_sentinel != NULL ? build_sentinel_failure_table(config->batch_sentinel) : NULL;
+  char * chunk=(char*) malloc(sizeof(char) * HEADLESS_CHUNK_SIZE);
+
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+  int exit_code=LP_BATCH_EXIT_COMPLETE;
+  bool all_finished=false;
+  while (!all_finished) {
+    bool new_output=wait_for_uart_output(HEADLESS_CHECK_INTERVAL_MS);
+    all_finished=true;
+    for (int i=next_core_in_set(&config->active_cores, 0);i>=0;i=next_core_in_set(&config->active_cores, i+1)) {
+      drain_core_output(output, i, &core_states[i], chunk, config->batch_sentinel, sentinel_failure);
+      // Stopped cores are only treated as finished once their output has gone quiet, so trailing UART data is not lost
+      if (!core_states[i].finished && !new_output && has_core_stopped(active_device_drivers, i)) core_states[i].finished=true;
+      if (!core_states[i].finished) all_finished=false;
+    }
+    // Whilst the cores are quiet their output so far is passed on, and an output that has gone away ends the stream
+    if (!new_output) fflush(output);
+    if (interrupted || ferror(output)) {
+      exit_code=LP_BATCH_EXIT_INTERRUPTED;
+      break;
+    }
+    if (!all_finished && config->batch_timeout_sec > 0 && get_elapsed_seconds(&start_time) >= config->batch_timeout_sec) {
+      exit_code=LP_BATCH_EXIT_TIMEOUT;
+      break;
+    }
+  }
+
+  if (stop_cores) {
+    lock_device();
+    check_device_status(active_device_drivers->device_stop_allcores());
+    unlock_device();
+    end_energy_run();
+    // Only once what the cores sent before stopping has been polled into the rings is polling stopped
+    flush_uart_poll_cores(config, &config->active_cores);
+    set_uart_polling(false);
+  }
+  for (int i=next_core_in_set(&config->active_cores, 0);i>=0;i=next_core_in_set(&config->active_cores, i+1)) {
+    finish_core_output(output, i, &core_states[i], chunk);
+  }
+  if (stop_cores) {
+    clear_core_set(&device_status->cores_active);
+    device_status->running=false;
+  }
+  fflush(output);
+  free(core_states);
+  free(chunk);
+  if (sentinel_failure != NULL) free(sentinel_failure);
+  return exit_code;
+}
+
+static void handle_interrupt(int signal_number) {
+  interrupted=1;
+}
+
+static FILE* open_core_output_file(char * output_dir, int core_id) {
+  char filename[strlen(output_dir) + BOARD_CORE_NAME_SIZE + 32], core_name[BOARD_CORE_NAME_SIZE];
+  describe_core(core_id, core_name);
+  sprintf(filename, "%s/core_%s.out", output_dir, core_name);
+  FILE * output_file=fopen(filename, "w");
+  if (output_file == NULL) {
+    fprintf(stderr, "Error opening output file '%s'\n", filename);
+    exit(LP_BATCH_EXIT_ERROR);
+  }
+  setvbuf(output_file, NULL, _IOFBF, OUTPUT_FILE_BUFFER_SIZE);
+  return output_file;
+}
+
+/**
+ * Passes on the UART output that the core has produced so far, matching it against the sentinel if one is given
+ */
+void drain_core_output(FILE * output, int core_id, struct headless_core_state * core_state, char * chunk, char * sentinel, int * sentinel_failure) {
+  struct uart_ring * ring=get_uart_output_ring(core_id);
+  uint64_t bytes_read;
+  while ((bytes_read=uart_ring_pop(ring, chunk, HEADLESS_CHUNK_SIZE)) > 0) {
+    if (core_state->output_file != NULL) {
+      fwrite(chunk, sizeof(char), bytes_read, core_state->output_file);
+    } else {
+      write_output_lines(output, core_id, core_state, chunk, bytes_read);
+    }
+    if (sentinel != NULL && !core_state->finished) {
+      core_state->finished=match_sentinel(core_state, sentinel, sentinel_failure, chunk, bytes_read);
+    }
+  }
+  uint64_t dropped=atomic_load(&ring->dropped_bytes);
+  if (dropped > core_state->reported_dropped_bytes) {
+    char core_name[BOARD_CORE_NAME_SIZE];
+    describe_core(core_id, core_name);
+    fprintf(stderr, "Warning, %ld bytes of UART output dropped for core %s as the buffer was full\n", dropped - core_state->reported_dropped_bytes, core_name);
+    core_state->reported_dropped_bytes=dropped;
+  }
+}
+
+/**
+ * Collects the core's trailing output, including any incomplete line, and releases its state
+ */
+void finish_core_output(FILE * output, int core_id, struct headless_core_state * core_state, char * chunk) {
+  drain_core_output(output, core_id, core_state, chunk, NULL, NULL);
+  if (core_state->line_buffer != NULL && core_state->line_length > 0) {
+    char core_name[BOARD_CORE_NAME_SIZE];
+    describe_core(core_id, core_name);
+    core_state->line_buffer[core_state->line_length]='\0';
+    fprintf(output, "[%s]: %s\n", core_name, core_state->line_buffer);
+  }
+  if (core_state->output_file != NULL) fclose(core_state->output_file);
+  if (core_state->line_buffer != NULL) free(core_state->line_buffer);
+  core_state->output_file=NULL;
+  core_state->line_buffer=NULL;
+}
+
+static void write_output_lines(FILE * output, int core_id, struct headless_core_state * core_state, char * data, uint64_t length) {
+  char core_name[BOARD_CORE_NAME_SIZE];
+  describe_core(core_id, core_name);
+  for (uint64_t i=0;i<length;i++) {
+    if (data[i] != '\r' && data[i] != '\n') core_state->line_buffer[core_state->line_length++]=data[i];
+    if (data[i] == '\n' || core_state->line_length == HEADLESS_LINE_SIZE) {
+      core_state->line_buffer[core_state->line_length]='\0';
+      fprintf(output, "[%s]: %s\n", core_name, core_state->line_buffer);
+      core_state->line_length=0;
+    }
+  }
+}
+
+/**
+ * Streaming (Knuth-Morris-Pratt) match so the sentinel is found even when split across chunks
+ */
+static bool match_sentinel(struct headless_core_state * core_state, char * sentinel, int * failure, char * data, uint64_t length) {
+  int sentinel_length=strlen(sentinel);
+  for (uint64_t i=0;i<length;i++) {
+    while (core_state->sentinel_match > 0 && data[i] != sentinel[core_state->sentinel_match]) {
+      core_state->sentinel_match=failure[core_state->sentinel_match-1];
+    }
+    if (data[i] == sentinel[core_state->sentinel_match]) core_state->sentinel_match++;
+    if (core_state->sentinel_match == sentinel_length) return true;
+  }
+  return false;
+}
+
+int * build_sentinel_failure_table(char * sentinel) {
+  int sentinel_length=strlen(sentinel);
+  int * failure=(int*) malloc(sizeof(int) * (sentinel_length > 0 ? sentinel_length : 1));
+  failure[0]=0;
+  int k=0;
+  for (int i=1;i<sentinel_length;i++) {
+    while (k > 0 && sentinel[i] != sentinel[k]) k=failure[k-1];
+    if (sentinel[i] == sentinel[k]) k++;
+    failure[i]=k;
+  }
+  return failure;
+}
+
+bool has_core_stopped(struct device_drivers * active_device_drivers, int core_id) {
+  if (active_device_drivers->device_get_core_running == NULL) return false;
+  int running=1;
+  lock_device_core(core_id);
+  check_device_status(active_device_drivers->device_get_core_running(core_id, &running));
+  unlock_device_core(core_id);
+  return !running;
+}
+
+static double get_elapsed_seconds(struct timespec * start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + ((now.tv_nsec - start->tv_nsec) / 1e9);
+}
@@ -1,44 +1,76 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <ncurses.h>
 #include <stdbool.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <unistd.h>
+#include <time.h>
 #include "uart_interactive.h"
 #include "launchpad_common.h"
 #include "configuration.h"
 #include "util.h"
+#include "device_lock.h"
+#include "board.h"
+#include "uart_poll.h"
+#include "uart_ring.h"
+#include "loader.h"
+#include "upload_cache.h"
+#include "dataset.h"
+#include "telemetry.h"
+#include "mailbox.h"
+#include "file_proxy.h"
+#include "uart_panes.h"
+#include "counter.h"
 
 #define MAX_BUFFER_SIZE 2048
-#define OUT_PAUSED_BUFFER_SIZE 1048576
+#define RENDER_CHUNK_SIZE 4096
+// Commands take file paths, so the line is sized to hold a path with room for the command around it
+#define COMMAND_BUFFER_SIZE 4096
 
-enum handle_command_status { COMMAND_SUCCESS, COMMAND_NOT_RECOGNISED, COMMAND_ERROR, COMMAND_NEW_SCREEN, COMMAND_IGNORE };
+enum handle_command_status { COMMAND_SUCCESS, COMMAND_NOT_RECOGNISED, COMMAND_ERROR, COMMAND_NEW_SCREEN, COMMAND_NEW_VIEW, COMMAND_IGNORE };
 
 // Denotes whether we can update the screen or not (e.g. pause updates if in escape mode)
-_Atomic bool screenUpdateOk, continuePoll, killBufferedOutput;
+_Atomic bool screenUpdateOk, killBufferedOutput;
+// Whilst a command's output is shown over the panes they are not drawn, until a key is pressed to return to them
+_Atomic bool paneOverlay;
 
-sem_t device_semaphore;
+// Serialises ncurses calls between the render thread and the main (keyboard and command) thread
+pthread_mutex_t display_mutex=PTHREAD_MUTEX_INITIALIZER;
 
 int main_screen_row, main_screen_col;
 
-void * poll_uart_thread(void*);
+// Written only by the render thread and read when the statistics are shown, output held in the rings is dropped either whilst paused in escape mode or
+// whilst displaying (the display falling behind), and lines too long for the line buffer are split
+struct render_statistics {
+  _Atomic uint64_t frames, total_render_ns, max_render_ns, dropped_whilst_paused, dropped_whilst_displaying, lines_split;
+};
+
+static struct render_statistics render_stats;
+
+static void * render_uart_thread(void*);
+static void render_core_output(int, char*, uint64_t, bool, char**, unsigned int*);
+static void sleep_until_next_frame(struct timespec*, unsigned int);
 static void write_uart_data(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, char);
-static int get_number_active_cores(struct launchpad_configuration*, struct device_configuration*);
-static void poll_core_for_uart(int core_id, struct device_drivers*, int, char**, unsigned int*, char *, unsigned int*);
 static enum handle_command_status handle_command(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, struct current_device_status*, char*);
 static void display_config(struct device_configuration*, struct device_drivers*);
 static enum handle_command_status handle_disable_cores(struct launchpad_configuration*, struct device_configuration*, struct current_device_status*, char*);
 static enum handle_command_status handle_enable_specify_executable(struct launchpad_configuration*, struct current_device_status*, char*);
 static enum handle_command_status handle_enable_cores(struct launchpad_configuration*, struct device_configuration*, struct current_device_status*, char*, bool);
-static int check_enabled_cores(struct launchpad_configuration*, struct device_configuration*);
 static enum handle_command_status handle_start_cores(struct launchpad_configuration*, struct device_configuration*, struct device_drivers*, struct current_device_status*);
+static enum handle_command_status handle_dataset(struct device_configuration*, char*);
+static enum handle_command_status handle_telemetry_export(char*);
+static enum handle_command_status handle_pane_view(struct device_configuration*, char*);
+static enum handle_command_status handle_scroll_pane(char*);
+static enum handle_command_status handle_search_scrollback(char*);
 static void reset_device(struct device_drivers*, struct device_configuration*, struct current_device_status*);
-static int get_num_active_cores(struct launchpad_configuration*, struct device_configuration*);
 static enum handle_command_status handle_stop_cores(struct device_drivers*, struct device_configuration*, struct current_device_status*);
 static void display_help_screen();
 static void display_status_screen(struct launchpad_configuration*, struct device_configuration*, struct current_device_status*);
+static void display_poll_statistics(struct launchpad_configuration*);
+static void display_uart_statistics(struct launchpad_configuration*, struct device_configuration*);
+static char * generate_uart_statistics(struct launchpad_configuration*, struct device_configuration*);
 static void display_message(char*);
 static bool check_command_portion(char*, char*);
 static char * get_arg_portion(char*);
@@ -52,16 +84,9 @@ struct ThreadArgsStruct {
 
 void interactive_uart(struct launchpad_configuration * config, struct device_configuration * device_config,
       struct device_drivers * active_device_drivers, struct current_device_status * device_status) {
-  struct ThreadArgsStruct * threadArgs=(struct ThreadArgsStruct*) malloc(sizeof(struct ThreadArgsStruct));
-  threadArgs->config=config;
-  threadArgs->device_config=device_config;
-  threadArgs->active_device_drivers=active_device_drivers;
-
-  sem_init(&device_semaphore, 0, 1);
-
   screenUpdateOk=true;
-  continuePoll=true;
   killBufferedOutput=false;
+  paneOverlay=false;
 
   // Initialise ncurses
   initscr();
@@ -81,28 +106,48 @@ void interactive_uart(struct launchpad_configuration * config, struct device_con
   if (!device_status->running) {
     printw("Launchpad> Launchpad started but cores idle, use ':h' command for help\n");
     if (config->executable_filename == NULL) printw("Launchpad> No executable specified, provide one via the ':exe' command\n");
-    if (get_num_active_cores(config, device_config) == 0) printw("Launchpad> No cores enabled, enable these via the ':e' or ':c' commands\n");
+    if (count_cores_in_set(&config->active_cores) == 0) printw("Launchpad> No cores enabled, enable these via the ':e' or ':c' commands\n");
   } else {
-    printw("Launchpad> %d cores running with executable '%s'\n", get_num_active_cores(config, device_config), config->executable_filename);
+    char load_summary[1024];
+    describe_load_statistics(load_summary);
+    printw("Launchpad> %s\n", load_summary);
+    printw("Launchpad> %d cores running with executable '%s'\n", count_cores_in_set(&config->active_cores), config->executable_filename);
   }
   attroff(COLOR_PAIR(3));
 
+  initialise_panes(config, device_config);
+  start_uart_pollers(config, device_config, active_device_drivers, device_status->running);
+
+  struct ThreadArgsStruct * threadArgs=(struct ThreadArgsStruct*) malloc(sizeof(struct ThreadArgsStruct));
+  threadArgs->config=config;
+  threadArgs->device_config=device_config;
+  threadArgs->active_device_drivers=active_device_drivers;
   pthread_t threadId;
-  int err = pthread_create(&threadId, NULL, &poll_uart_thread, threadArgs);
+  int err = pthread_create(&threadId, NULL, &render_uart_thread, threadArgs);
   if (err) {
     fprintf(stderr, "Error calling device function\n");
     raise(SIGABRT);
     exit(-1);
   }
 
-  char command_buffer[50];
+  char command_buffer[COMMAND_BUFFER_SIZE];
   bool escapeMode=false;
   int x_pos;
   while(1==1) {
     char ch=getch();
     if (ch != ERR) {
-      if (ch == 27 && !escapeMode) {
+      if (paneOverlay) {
+        // The key is swallowed, it only returns from the command's output to the panes
+        pthread_mutex_lock(&display_mutex);
+        paneOverlay=false;
+        redraw_all_panes();
+        pthread_mutex_unlock(&display_mutex);
+        notify_uart_output();
+      } else if (ch == 27 && !escapeMode) {
+        // Taking the display lock ensures any frame being rendered completes before the command line is drawn
+        pthread_mutex_lock(&display_mutex);
         screenUpdateOk=false;
+        pthread_mutex_unlock(&display_mutex);
         escapeMode=true;
         x_pos=0;
         getyx(stdscr, main_screen_row, main_screen_col);
@@ -115,8 +160,15 @@ void interactive_uart(struct launchpad_configuration * config, struct device_con
       } else if (escapeMode && ch == '\n') {
         escapeMode=false;
         enum handle_command_status command_status=COMMAND_IGNORE;
+        bool panes_shown=get_pane_view() != PANE_VIEW_STREAM;
         if (x_pos > 0) {
           command_buffer[x_pos]='\0';
+          if (panes_shown) {
+            // Any output of the command is shown on a blank screen in place of the panes
+            erase();
+            main_screen_row=0;
+            main_screen_col=0;
+          }
           command_status=handle_command(config, device_config, active_device_drivers, device_status, command_buffer);
           if (command_status == COMMAND_NOT_RECOGNISED) {
             display_command_error_message("Command not recognised");
@@ -124,12 +176,26 @@ void interactive_uart(struct launchpad_configuration * config, struct device_con
             deleteln();
           }
         }
-        if (command_status == COMMAND_NEW_SCREEN) {
+        if (panes_shown && (command_status == COMMAND_SUCCESS || command_status == COMMAND_ERROR || command_status == COMMAND_NOT_RECOGNISED)) {
+          if (command_status == COMMAND_SUCCESS) {
+            attron(COLOR_PAIR(3));
+            mvprintw(LINES-1, 0, "Launchpad> Press any key to return to the panes");
+            attroff(COLOR_PAIR(3));
+            refresh();
+          }
+          paneOverlay=true;
+        } else if (get_pane_view() != PANE_VIEW_STREAM) {
+          pthread_mutex_lock(&display_mutex);
+          redraw_all_panes();
+          pthread_mutex_unlock(&display_mutex);
+        } else if (command_status == COMMAND_NEW_SCREEN || panes_shown) {
           move(0,0);
         } else {
           move(main_screen_row, main_screen_col);
         }
         screenUpdateOk=true;
+        // Any output buffered whilst in escape mode can now be displayed
+        notify_uart_output();
       } else if (escapeMode && (ch == KEY_BACKSPACE || ch == KEY_DC || ch == 127)) {
         // Handle backspace for escape mode command
         int my_row, my_col;
@@ -139,15 +205,23 @@ void interactive_uart(struct launchpad_configuration * config, struct device_con
           move(my_row, my_col-1);
           x_pos--;
         }
+      } else if (escapeMode && x_pos >= COMMAND_BUFFER_SIZE - 1) {
+        // The command line is full, leaving room for the terminator, so further characters are ignored
       } else {
-        printw("%c", ch);
-        refresh();
+        // The panes show what the cores echo back, so typing is only echoed locally on the command line or stream
+        if (escapeMode || get_pane_view() == PANE_VIEW_STREAM) {
+          pthread_mutex_lock(&display_mutex);
+          printw("%c", ch);
+          refresh();
+          pthread_mutex_unlock(&display_mutex);
+        }
         if (escapeMode) {
           command_buffer[x_pos]=ch;
           x_pos++;
         } else {
-          // If not in escape mode then write the character to UART
+          // If not in escape mode then write the character to UART, the core is likely to respond so wake the poller
           write_uart_data(config, device_config, active_device_drivers, ch);
+          wake_uart_poller();
         }
       }
     }
@@ -155,105 +229,143 @@ void interactive_uart(struct launchpad_configuration * config, struct device_con
   pthread_join(threadId, NULL);
 }
 
-void * poll_uart_thread(void * args) {
+/**
+ * Drains the per core UART rings filled by the pollers into each core's scrollback and displays their contents,
+ * refreshing the screen at most once per frame. Whilst in escape mode the stream is not drained, so output is held in
+ * the rings (and counted as dropped if these fill), whereas the panes carry on draining into the scrollback and are
+ * drawn once the screen is theirs again
+ */
+static void * render_uart_thread(void * args) {
   struct ThreadArgsStruct * threadArgs = (struct ThreadArgsStruct*) args;
-
-  int num_active_cores=get_number_active_cores(threadArgs->config, threadArgs->device_config);
-  char ** output_buffers=NULL;
-  unsigned int * output_buffer_locals=NULL;
-  if (num_active_cores > 1) {
-    // Only buffer and output if number cores is greater than one, otherwise just dumb display
-    output_buffers=(char**) malloc(sizeof(char*) * threadArgs->device_config->number_cores);
-    output_buffer_locals=(unsigned int*) malloc(sizeof(unsigned int) * threadArgs->device_config->number_cores);
-    for (int i=0;i<threadArgs->device_config->number_cores;i++) {
-      if (threadArgs->config->active_cores[i]) {
-        output_buffers[i]=(char*) malloc(sizeof(char) * MAX_BUFFER_SIZE);
-        output_buffer_locals[i]=0;
-      }
-    }
+  int number_cores=threadArgs->device_config->number_cores;
+
+  char ** line_buffers=(char**) malloc(sizeof(char*) * number_cores);
+  unsigned int * line_buffer_lengths=(unsigned int*) malloc(sizeof(unsigned int) * number_cores);
+  uint64_t * reported_dropped_bytes=(uint64_t*) malloc(sizeof(uint64_t) * number_cores);
+  for (int i=0;i<number_cores;i++) {
+    line_buffers[i]=(char*) malloc(sizeof(char) * (MAX_BUFFER_SIZE + 1));
+    line_buffer_lengths[i]=0;
+    reported_dropped_bytes[i]=0;
   }
-
-  char * out_paused_buffer=(char*) malloc(sizeof(char*) * OUT_PAUSED_BUFFER_SIZE);
-  unsigned int out_paused_buffer_idx=0;
+  char chunk[RENDER_CHUNK_SIZE];
+  unsigned int frame_period_us=1000000 / (threadArgs->config->render_fps > 0 ? threadArgs->config->render_fps : 1);
+  struct timespec last_frame;
+  clock_gettime(CLOCK_MONOTONIC, &last_frame);
+  bool paused=false;
   while (1==1) {
-    for (int i=0;i<threadArgs->device_config->number_cores;i++) {
-      if (threadArgs->config->active_cores[i]) {
-        poll_core_for_uart(i, threadArgs->active_device_drivers, num_active_cores, output_buffers, output_buffer_locals, out_paused_buffer, &out_paused_buffer_idx);
+    wait_for_uart_output(1000);
+    if (!screenUpdateOk && get_pane_view() == PANE_VIEW_STREAM) {
+      paused=true;
+      continue;
+    }
+    pthread_mutex_lock(&display_mutex);
+    bool panes_shown=get_pane_view() != PANE_VIEW_STREAM;
+    // Checked again under the lock as escape mode might have been entered whilst waiting
+    if (screenUpdateOk || panes_shown) {
+      struct timespec render_start;
+      clock_gettime(CLOCK_MONOTONIC, &render_start);
+      bool prefix_output=count_cores_in_set(&threadArgs->config->active_cores) > 1;
+      bool updated=false;
+      for (int i=0;i<number_cores;i++) {
+        struct uart_ring * ring=get_uart_output_ring(i);
+        if (killBufferedOutput) {
+          uart_ring_discard(ring);
+          line_buffer_lengths[i]=0;
+          continue;
+        }
+        // Bounded by the ring's capacity so a chatty core can not hold up the frame indefinitely
+        uint64_t budget=ring->capacity, bytes_read;
+        while (budget > 0 && (bytes_read=uart_ring_pop(ring, chunk, RENDER_CHUNK_SIZE)) > 0) {
+          append_pane_output(i, chunk, bytes_read);
+          if (!panes_shown) render_core_output(i, chunk, bytes_read, prefix_output, line_buffers, line_buffer_lengths);
+          budget=bytes_read < budget ? budget - bytes_read : 0;
+          updated=true;
+        }
+        uint64_t dropped=atomic_load(&ring->dropped_bytes);
+        if (dropped > reported_dropped_bytes[i]) {
+          if (paused) {
+            add_to_counter(&render_stats.dropped_whilst_paused, dropped - reported_dropped_bytes[i]);
+          } else {
+            add_to_counter(&render_stats.dropped_whilst_displaying, dropped - reported_dropped_bytes[i]);
+          }
+          if (panes_shown) {
+            // The pane's title carries the count of dropped bytes
+            mark_pane_dirty(i);
+          } else {
+            char core_name[BOARD_CORE_NAME_SIZE];
+            describe_core(i, core_name);
+            attron(COLOR_PAIR(1));
+            printw("[%s]: %ld bytes of UART output dropped as the buffer was full\n", core_name, dropped - reported_dropped_bytes[i]);
+            attroff(COLOR_PAIR(1));
+          }
+          reported_dropped_bytes[i]=dropped;
+          updated=true;
+        }
+      }
+      if (panes_shown) {
+        // Only the panes of cores with new output are drawn, and nothing at all whilst the screen is in use for commands
+        updated=screenUpdateOk && !paneOverlay && render_panes(threadArgs->config);
+      } else if (updated) {
+        refresh();
       }
+      if (updated) {
+        struct timespec render_end;
+        clock_gettime(CLOCK_MONOTONIC, &render_end);
+        uint64_t render_ns=((render_end.tv_sec - render_start.tv_sec) * 1000000000) + (render_end.tv_nsec - render_start.tv_nsec);
+        add_to_counter(&render_stats.frames, 1);
+        add_to_counter(&render_stats.total_render_ns, render_ns);
+        if (render_ns > atomic_load_explicit(&render_stats.max_render_ns, memory_order_relaxed)) {
+          atomic_store_explicit(&render_stats.max_render_ns, render_ns, memory_order_relaxed);
+        }
+      }
+      paused=false;
     }
+    pthread_mutex_unlock(&display_mutex);
+    sleep_until_next_frame(&last_frame, frame_period_us);
   }
   return NULL;
 }
 
-static void write_uart_data(struct launchpad_configuration * config, struct device_configuration * device_config, struct device_drivers * active_device_drivers, char data) {
-  for (int i=0;i<device_config->number_cores;i++) {
-    if (config->active_cores[i]) {
-      active_device_drivers->device_write_uart(i, data);
+static void render_core_output(int core_id, char * data, uint64_t length, bool prefix_output, char ** line_buffers, unsigned int * line_buffer_lengths) {
+  if (!prefix_output) {
+    // Strip carriage returns in place, then display the whole chunk at once
+    uint64_t num_chars=0;
+    for (uint64_t i=0;i<length;i++) {
+      if (data[i] != '\r') data[num_chars++]=data[i];
+    }
+    addnstr(data, num_chars);
+    return;
+  }
+  for (uint64_t i=0;i<length;i++) {
+    if (data[i] != '\r') {
+      line_buffers[core_id][line_buffer_lengths[core_id]]=data[i];
+      line_buffer_lengths[core_id]++;
+    }
+    if (data[i] == '\n' || line_buffer_lengths[core_id] == MAX_BUFFER_SIZE) {
+      // This is a flush, lines longer than the buffer are split rather than dropped
+      if (data[i] != '\n') add_to_counter(&render_stats.lines_split, 1);
+      char core_name[BOARD_CORE_NAME_SIZE];
+      describe_core(core_id, core_name);
+      line_buffers[core_id][line_buffer_lengths[core_id]]='\0';
+      printw("[%s]: %s%s", core_name, line_buffers[core_id], data[i] == '\n' ? "" : "\n");
+      line_buffer_lengths[core_id]=0;
     }
   }
 }
 
-static int get_number_active_cores(struct launchpad_configuration * config, struct device_configuration * device_config) {
-  int num_active_cores=0;
-  for (int i=0;i<device_config->number_cores;i++) {
-    if (config->active_cores[i]) num_active_cores++;
-  }
-  return num_active_cores;
+static void sleep_until_next_frame(struct timespec * last_frame, unsigned int frame_period_us) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t elapsed_us=((now.tv_sec - last_frame->tv_sec) * 1000000) + ((now.tv_nsec - last_frame->tv_nsec) / 1000);
+  if (elapsed_us < frame_period_us) usleep(frame_period_us - elapsed_us);
+  clock_gettime(CLOCK_MONOTONIC, last_frame);
 }
 
-static void poll_core_for_uart(int core_id, struct device_drivers * active_device_drivers, int num_active_cores, char ** output_buffers, unsigned int * output_buffer_locals,
-      char * out_paused_buffer, unsigned int * out_paused_buffer_idx) {
-  if (*out_paused_buffer_idx > 0 && screenUpdateOk) {
-    out_paused_buffer[*out_paused_buffer_idx]='\0';
-    if (!killBufferedOutput) {
-      printw("%s", out_paused_buffer);
-      refresh();
-    }
-    *out_paused_buffer_idx=0;
-  }
-  if (!continuePoll) return;
-  int uart_data_present=0;
-  sem_wait(&device_semaphore);
-  check_device_status(active_device_drivers->device_uart_has_data(core_id, &uart_data_present));
-  if (uart_data_present) {
-    char data=0x0;
-    check_device_status(active_device_drivers->device_read_uart(core_id, &data));
-    sem_post(&device_semaphore);
-    if (num_active_cores > 1) {
-      if (output_buffer_locals[core_id] < MAX_BUFFER_SIZE) {
-        if (data != '\r') {
-          output_buffers[core_id][output_buffer_locals[core_id]]=data;
-          output_buffer_locals[core_id]++;
-        }
-        if (data == '\n') {
-          // This is a flush
-          if (screenUpdateOk) {
-            output_buffers[core_id][output_buffer_locals[core_id]]='\0';
-            printw("[%d]: %s", core_id, output_buffers[core_id]);
-            refresh();
-          } else {
-            memcpy(&out_paused_buffer[*out_paused_buffer_idx], output_buffers[core_id], output_buffer_locals[core_id]);
-            (*out_paused_buffer_idx)+=output_buffer_locals[core_id];
-          }
-          output_buffers[core_id][0]='\0';
-          output_buffer_locals[core_id]=0;
-        }
-      } else {
-        printf("Warning, UART buffer length of %d bytes exceeded for core %d, ignoring data '%c'\n", MAX_BUFFER_SIZE, core_id, data);
-      }
-    } else {
-      if (data != '\r') {
-        if (screenUpdateOk) {
-          printw("%c", data);
-          refresh();
-        } else {
-          out_paused_buffer[*out_paused_buffer_idx]=data;
-          (*out_paused_buffer_idx)++;
-        }
-      }
-    }
-  } else {
-    sem_post(&device_semaphore);
+static void write_uart_data(struct launchpad_configuration * config, struct device_configuration * device_config, struct device_drivers * active_device_drivers, char data) {
+  for (int i=next_core_in_set(&config->active_cores, 0);i>=0;i=next_core_in_set(&config->active_cores, i+1)) {
+    lock_device_core(i);
+    check_device_status(active_device_drivers->device_write_uart(i, data));
+    unlock_device_core(i);
   }
 }
 
@@ -261,11 +373,20 @@ static enum handle_command_status handle_command(struct launchpad_configuration
         struct device_drivers * active_device_drivers, struct current_device_status * device_status, char * buffer) {
   if (strcmp(buffer, ":q")==0 || strcmp(buffer, ":quit")==0) {
     endwin();
+    char * statistics=generate_uart_statistics(config, device_config);
+    fprintf(stderr, "%s", statistics);
+    free(statistics);
     exit(0);
   } else if (strcmp(buffer, ":clear")==0) {
     clear();
     refresh();
     return COMMAND_NEW_SCREEN;
+  } else if (strcmp(buffer, ":tile")==0 || strcmp(buffer, ":stream")==0 || check_command_portion(buffer, ":focus")) {
+    return handle_pane_view(device_config, buffer);
+  } else if (check_command_portion(buffer, ":scroll")) {
+    return handle_scroll_pane(buffer);
+  } else if (check_command_portion(buffer, ":grep")) {
+    return handle_search_scrollback(buffer);
   } else if (strcmp(buffer, ":h")==0 || strcmp(buffer, ":help")==0) {
     display_help_screen();
     return COMMAND_SUCCESS;
@@ -275,6 +396,9 @@ static enum handle_command_status handle_command(struct launchpad_configuration
   } else if (strcmp(buffer, ":config")==0) {
     display_config(device_config, active_device_drivers);
     return COMMAND_SUCCESS;
+  } else if (strcmp(buffer, ":stats")==0) {
+    display_uart_statistics(config, device_config);
+    return COMMAND_SUCCESS;
   } else if (strcmp(buffer, ":reset")==0) {
     reset_device(active_device_drivers, device_config, device_status);
     return COMMAND_SUCCESS;
@@ -288,8 +412,12 @@ static enum handle_command_status handle_command(struct launchpad_configuration
     return handle_enable_cores(config, device_config, device_status, buffer, false);
   } else if (check_command_portion(buffer, ":d") || check_command_portion(buffer, ":disable")) {
     return handle_disable_cores(config, device_config, device_status, buffer);
+  } else if (strcmp(buffer, ":data")==0 || check_command_portion(buffer, ":data") || check_command_portion(buffer, ":shard")) {
+    return handle_dataset(device_config, buffer);
   } else if (check_command_portion(buffer, ":bin") || check_command_portion(buffer, ":exe")) {
     return handle_enable_specify_executable(config, device_status, buffer);
+  } else if (check_command_portion(buffer, ":telemetry")) {
+    return handle_telemetry_export(buffer);
   }
   return COMMAND_NOT_RECOGNISED;
 }
@@ -323,7 +451,7 @@ static enum handle_command_status handle_enable_specify_executable(struct launch
       config->executable_filename=(char*) malloc(sizeof(char) * strlen(args)+1);
       strcpy(config->executable_filename, args);
       char message[250];
-      sprintf(message, "Successfully changed executable to '%s'", config->executable_filename);
+      snprintf(message, sizeof(message), "Successfully changed executable to '%s'", config->executable_filename);
       display_message(message);
       return COMMAND_SUCCESS;
     } else {
@@ -344,16 +472,18 @@ static enum handle_command_status handle_disable_cores(struct launchpad_configur
     display_command_error_message("Must provide arguments with enable or core command");
     return COMMAND_ERROR;
   } else {
-    bool disabledCores[device_config->number_cores];
-    parseCoreInfoString(args, disabledCores, device_config->number_cores);
-    bool hasDisabled=false;
-    for (int i=0;i<device_config->number_cores;i++) {
-      if (disabledCores[i]) {
-        if (config->active_cores[i]) hasDisabled=true;
-        config->active_cores[i]=false;
-      }
+    struct core_set disabledCores;
+    initialise_core_set(&disabledCores, device_config->number_cores);
+    if (!parseCoreInfoString(args, &disabledCores)) {
+      free_core_set(&disabledCores);
+      display_command_error_message("Invalid core list, cores are given as a single id, all, a range (a:b) or a list of these");
+      return COMMAND_ERROR;
     }
-    int num_active=check_enabled_cores(config, device_config);
+    int num_previously_active=count_cores_in_set(&config->active_cores);
+    subtract_core_sets(&config->active_cores, &disabledCores);
+    free_core_set(&disabledCores);
+    int num_active=count_cores_in_set(&config->active_cores);
+    bool hasDisabled=num_active < num_previously_active;
     char message[100];
     if (hasDisabled) {
       sprintf(message, "Core(s) disabled, there are now %d cores enabled", num_active);
@@ -376,18 +506,18 @@ static enum handle_command_status handle_enable_cores(struct launchpad_configura
     display_command_error_message("Must provide arguments with enable or core command");
     return COMMAND_ERROR;
   } else {
-    bool activeCorePrev[device_config->number_cores];
-    if (additive) {
-      memcpy(activeCorePrev, config->active_cores, sizeof(bool) * device_config->number_cores);
-    }
-    parseCoreActiveInfo(config, args);
-    if (additive) {
-      // Applies AND relation here as we are enabling in additive fashion
-      for (int i=0;i<device_config->number_cores;i++) {
-        if (activeCorePrev[i]) config->active_cores[i]=true;
-      }
+    struct core_set activeCorePrev;
+    initialise_core_set(&activeCorePrev, device_config->number_cores);
+    if (additive) copy_core_set(&activeCorePrev, &config->active_cores);
+    if (!parseCoreActiveInfo(config, args)) {
+      free_core_set(&activeCorePrev);
+      display_command_error_message("Invalid core list, cores are given as a single id, all, a range (a:b) or a list of these");
+      return COMMAND_ERROR;
     }
-    int num_active=check_enabled_cores(config, device_config);
+    // Enabling is additive, so the result is the union with those previously enabled
+    if (additive) union_core_sets(&config->active_cores, &activeCorePrev);
+    free_core_set(&activeCorePrev);
+    int num_active=count_cores_in_set(&config->active_cores);
     char message[50];
     sprintf(message, "There are now %d cores enabled", num_active);
     display_message(message);
@@ -395,35 +525,13 @@ static enum handle_command_status handle_enable_cores(struct launchpad_configura
   }
 }
 
-static int check_enabled_cores(struct launchpad_configuration * config, struct device_configuration * device_config) {
-  for (int i=device_config->number_cores;i<MAX_NUM_CORES;i++) {
-    if (config->active_cores[i]) {
-      char message[100];
-      sprintf(message, "Core %d enabled but the device only has %d cores, will be ignored", i, device_config->number_cores);
-      display_message(message);
-    }
-  }
-
-  return get_num_active_cores(config, device_config);
-}
-
-static int get_num_active_cores(struct launchpad_configuration * config, struct device_configuration * device_config) {
-  int num_active_cores=0;
-  for (int i=0;i<device_config->number_cores;i++) {
-    if (config->active_cores[i]) {
-      num_active_cores++;
-    }
-  }
-  return num_active_cores;
-}
-
 static enum handle_command_status handle_start_cores(struct launchpad_configuration * config, struct device_configuration * device_config,
       struct device_drivers * active_device_drivers, struct current_device_status * device_status) {
   if (device_status->running) {
     display_command_error_message("Cores are already running");
     return COMMAND_ERROR;
   }
-  int num_enabled_cores=get_num_active_cores(config, device_config);
+  int num_enabled_cores=count_cores_in_set(&config->active_cores);
   if (num_enabled_cores == 0) {
     display_command_error_message("No cores are enabled, enable at-least one before starting");
     return COMMAND_ERROR;
@@ -433,27 +541,147 @@ static enum handle_command_status handle_start_cores(struct launchpad_configurat
     return COMMAND_ERROR;
   }
   killBufferedOutput=false;
-  sem_wait(&device_semaphore);
+  // Uploads take the device lock per transfer, so other device access continues whilst they are in progress
   transfer_executable_to_device(config, device_config, active_device_drivers);
+  char message[1024];
+  if (!stage_datasets(config, device_config, active_device_drivers, message)) {
+    display_command_error_message(message);
+    return COMMAND_ERROR;
+  }
+  lock_device();
   int num_started=start_cores(config, device_config, active_device_drivers, device_status);
-  continuePoll=true;
-  sem_post(&device_semaphore);
-  char message[25];
+  set_uart_polling(true);
+  unlock_device();
+  describe_load_statistics(message);
+  display_message(message);
   sprintf(message, "%d cores started", num_started);
   display_message(message);
   return COMMAND_SUCCESS;
 }
 
+/**
+ * Lists, clears or adds datasets, these are staged into data memory on each start
+ */
+static enum handle_command_status handle_dataset(struct device_configuration * device_config, char * buffer) {
+  char message[DATASET_MESSAGE_SIZE];
+  char * args=get_arg_portion(buffer);
+  if (args == NULL || strlen(args) == 0) {
+    size_t description_size=get_datasets_description_size();
+    char * description=(char*) malloc(sizeof(char) * description_size);
+    describe_datasets(description, description_size);
+    display_message(description);
+    free(description);
+    return COMMAND_SUCCESS;
+  }
+  if (strcmp(args, "clear") == 0) {
+    clear_datasets();
+    display_message("All datasets removed");
+    return COMMAND_SUCCESS;
+  }
+  if (!add_dataset(device_config, args, check_command_portion(buffer, ":shard"), message)) {
+    display_command_error_message(message);
+    return COMMAND_ERROR;
+  }
+  display_message(message);
+  return COMMAND_SUCCESS;
+}
+
+static enum handle_command_status handle_telemetry_export(char * buffer) {
+  char message[TELEMETRY_MESSAGE_SIZE];
+  if (!export_telemetry_csv(get_arg_portion(buffer), message)) {
+    display_command_error_message(message);
+    return COMMAND_ERROR;
+  }
+  display_message(message);
+  return COMMAND_SUCCESS;
+}
+
+/**
+ * Switches between the single stream of output, a pane for each enabled core and a single core's pane
+ */
+static enum handle_command_status handle_pane_view(struct device_configuration * device_config, char * buffer) {
+  if (strcmp(buffer, ":stream")==0) {
+    pthread_mutex_lock(&display_mutex);
+    set_pane_view(PANE_VIEW_STREAM, 0);
+    clear();
+    refresh();
+    pthread_mutex_unlock(&display_mutex);
+    return COMMAND_NEW_VIEW;
+  }
+  enum pane_view view=PANE_VIEW_TILE;
+  int focus_core=0;
+  if (check_command_portion(buffer, ":focus")) {
+    struct core_set focusCores;
+    initialise_core_set(&focusCores, device_config->number_cores);
+    bool valid=parseCoreInfoString(get_arg_portion(buffer), &focusCores) && count_cores_in_set(&focusCores) == 1;
+    focus_core=next_core_in_set(&focusCores, 0);
+    free_core_set(&focusCores);
+    if (!valid) {
+      display_command_error_message("Invalid core, focus is given a single core id");
+      return COMMAND_ERROR;
+    }
+    view=PANE_VIEW_FOCUS;
+  }
+  pthread_mutex_lock(&display_mutex);
+  set_pane_view(view, focus_core);
+  pthread_mutex_unlock(&display_mutex);
+  return COMMAND_NEW_VIEW;
+}
+
+static enum handle_command_status handle_scroll_pane(char * buffer) {
+  if (get_pane_view() != PANE_VIEW_FOCUS) {
+    display_command_error_message("Scrolling applies to a single core's pane, choose the core with :focus first");
+    return COMMAND_ERROR;
+  }
+  char * args=get_arg_portion(buffer), * end;
+  long lines_back=strtol(args, &end, 10);
+  if (end == args || *end != '\0' || lines_back < 0) {
+    display_command_error_message("Must provide the number of lines back to scroll to, 0 returns to the latest output");
+    return COMMAND_ERROR;
+  }
+  pthread_mutex_lock(&display_mutex);
+  set_pane_scroll((uint64_t) lines_back);
+  pthread_mutex_unlock(&display_mutex);
+  return COMMAND_NEW_VIEW;
+}
+
+/**
+ * Lists the lines of every core's scrollback containing the text, as many as fit on the screen
+ */
+static enum handle_command_status handle_search_scrollback(char * buffer) {
+  char * pattern=get_arg_portion(buffer);
+  if (*pattern == '\0') {
+    display_command_error_message("Must provide the text to search the scrollback for");
+    return COMMAND_ERROR;
+  }
+  pthread_mutex_lock(&display_mutex);
+  char * matches=generate_scrollback_matches(pattern, LINES > 6 ? LINES - 6 : 1, COLS > 1 ? COLS - 1 : 1);
+  pthread_mutex_unlock(&display_mutex);
+  int row, col;
+  getyx(stdscr, row, col);
+  move(main_screen_row+1, 0);
+  printw("Launchpad Scrollback Search\n");
+  printw("---------------------------\n");
+  printw("%s", matches);
+  free(matches);
+  refresh();
+  getyx(stdscr, main_screen_row, main_screen_col);
+  main_screen_col=0;
+  move(row, col);
+  return COMMAND_SUCCESS;
+}
+
 static enum handle_command_status handle_stop_cores(struct device_drivers * active_device_drivers, struct device_configuration * device_config, struct current_device_status * device_status) {
     if (!device_status->running) {
     display_command_error_message("Cores are already stopped");
     return COMMAND_ERROR;
   }
-  sem_wait(&device_semaphore);
+  lock_device();
   check_device_status(active_device_drivers->device_stop_allcores());
-  continuePoll=false;
-  sem_post(&device_semaphore);
-  for (int i=0;i<device_config->number_cores;i++) device_status->cores_active[i]=false;
+  set_uart_polling(false);
+  unlock_device();
+  end_energy_run();
+  clear_core_set(&device_status->cores_active);
   device_status->running=false;
   display_message("All cores stopped and idle");
   killBufferedOutput=true;
@@ -472,13 +700,15 @@ static void reset_device(struct device_drivers * active_device_drivers, struct d
   mvprintw(LINES-1,0, "Please wait - resetting soft cores");
   attroff(COLOR_PAIR(2));
   refresh();
-  sem_wait(&device_semaphore);
+  lock_device();
   check_device_status(active_device_drivers->device_reset());
-  continuePoll=false;
+  invalidate_upload_cache();
+  set_uart_polling(false);
   // Reinitialise the drivers as the user will probably want to do more interaction
   check_device_status(active_device_drivers->device_initialise());
-  sem_post(&device_semaphore);
-  for (int i=0;i<device_config->number_cores;i++) device_status->cores_active[i]=false;
+  unlock_device();
+  if (device_status->running) end_energy_run();
+  clear_core_set(&device_status->cores_active);
   display_message("Reset successful, cores all idle");
 }
 
@@ -504,13 +734,22 @@ static void display_help_screen() {
   printw("Escape key to enter command mode, the following commands apply:\n");
   printw(":status      - Display current soft core status including active and enabled cores\n");
   printw(":config      - Display soft core CPU and board configuration and status\n");
+  printw(":stats       - Display UART pipeline statistics, per core throughput, polling and display (also shown on quit)\n");
   printw(":clear       - Clears the output screen\n");
+  printw(":tile        - Show a pane of output for each enabled core, as many as fit the terminal\n");
+  printw(":focus c     - Show the output of core c alone, using the whole terminal\n");
+  printw(":scroll n    - Whilst focused on a core, show its output from n lines back (0 returns to the latest)\n");
+  printw(":stream      - Return to the single stream of output from all cores\n");
+  printw(":grep text   - List the lines of each core's scrollback that contain text\n");
   printw(":stop        - Stop all cores\n");
   printw(":start       - Start all enabled cores\n");
   printw(":exe, :bin   - Specify the binary executable that cores should run\n");
+  printw(":data spec   - Add a dataset staged into data memory on start, spec is [cores=]file[@offset], %%d in file is the core\n");
+  printw(":shard spec  - Add a single file dataset split into one slice per core, :data lists and :data clear removes all\n");
   printw(":e, :enable  - Enables core(s) provided as a singleton, list or range (does not start)\n");
   printw(":c, :cores   - Sets core(s) provided as a singleton, list or range as the active set (does not start)\n");
   printw(":d, :disable - Disables core(s) provided as a singleton, list or range (does not stop)\n");
+  printw(":telemetry f - Write the board temperature and power samples to the CSV file f\n");
   printw(":reset       - Reset device and stop all cores\n");
   printw(":h, :help    - Display this help message\n");
   printw(":q, :quit    - Quit Launchpad\n");
@@ -533,15 +772,74 @@ static void display_status_screen(struct launchpad_configuration * config, struc
     printw("Soft cores currently stopped");
   }
   for (int i=0;i<device_config->number_cores;i++) {
-    printw("Core %d: %s (%s)\n", i, device_status->cores_active[i] ? "active" : "inactive", config->active_cores[i] ? "enabled" : "disabled");
+    uint64_t dropped=atomic_load(&get_uart_output_ring(i)->dropped_bytes);
+    char core_name[BOARD_CORE_NAME_SIZE];
+    describe_core(i, core_name);
+    printw("Core %s: %s (%s)", core_name, is_core_in_set(&device_status->cores_active, i) ? "active" : "inactive",
+      is_core_in_set(&config->active_cores, i) ? "enabled" : "disabled");
+    if (dropped > 0) printw(", %ld bytes of UART output dropped", dropped);
+    printw("\n");
   }
   printw("Executable: %s\n", config->executable_filename);
+  char energy_summary[TELEMETRY_MESSAGE_SIZE];
+  describe_energy(energy_summary);
+  printw("%s\n", energy_summary);
+  if (is_mailbox_enabled()) {
+    char mailbox_summary[MAILBOX_MESSAGE_SIZE];
+    describe_mailboxes(mailbox_summary);
+    printw("%s\n", mailbox_summary);
+  }
+  if (is_file_proxy_enabled()) {
+    char file_proxy_summary[FILE_PROXY_MESSAGE_SIZE];
+    describe_file_proxy(file_proxy_summary);
+    printw("%s\n", file_proxy_summary);
+  }
+  display_poll_statistics(config);
   refresh();
   getyx(stdscr, main_screen_row, main_screen_col);
   main_screen_col=0;
   move(row, col);
 }
 
+static void display_uart_statistics(struct launchpad_configuration * config, struct device_configuration * device_config) {
+  int row, col;
+  getyx(stdscr, row, col);
+  move(main_screen_row+1, 0);
+  printw("Launchpad UART Statistics\n");
+  printw("-------------------------\n");
+  char * statistics=generate_uart_statistics(config, device_config);
+  printw("%s", statistics);
+  free(statistics);
+  refresh();
+  getyx(stdscr, main_screen_row, main_screen_col);
+  main_screen_col=0;
+  move(row, col);
+}
+
+/**
+ * The pollers' statistics followed by the display's, freed by the caller
+ */
+static char * generate_uart_statistics(struct launchpad_configuration * config, struct device_configuration * device_config) {
+  char * statistics=(char*) malloc(sizeof(char) * UART_STATISTICS_LINE_SIZE * (device_config->number_cores + 4));
+  describe_uart_statistics(config, device_config, statistics);
+  uint64_t frames=render_stats.frames;
+  sprintf(&statistics[strlen(statistics)], "Display: %ld refreshes taking %.3fms mean and %.3fms max to render, %ld bytes dropped whilst paused and %ld whilst displaying, %ld long lines split\n",
+    frames, frames > 0 ? (render_stats.total_render_ns / frames) / 1e6 : 0.0, render_stats.max_render_ns / 1e6, (uint64_t) render_stats.dropped_whilst_paused,
+    (uint64_t) render_stats.dropped_whilst_displaying, (uint64_t) render_stats.lines_split);
+  return statistics;
+}
+
+static void display_poll_statistics(struct launchpad_configuration * config) {
+  struct uart_poll_statistics statistics;
+  get_uart_poll_statistics(config, &statistics);
+  printw("UART poll rate when idle: %dHz after %d spin sweeps, %d poller thread(s)\n", config->poll_rate_hz, config->poll_spin_sweeps, config->poll_threads);
+  printw("UART poller CPU usage: %.2f%% of one host core\n", statistics.cpu_usage);
+  if (statistics.wakes_after_sleep > 0) {
+    printw("UART poller added latency: mean %ldus, max %ldus over %ld wakes from sleep\n", statistics.total_wake_latency_us / statistics.wakes_after_sleep,
+      statistics.max_wake_latency_us, statistics.wakes_after_sleep);
+  }
+}
+
 static bool check_command_portion(char * buffer, char * command) {
   if (strncmp(buffer, command, strlen(command)) != 0) return false;
   // This ensures there is whitespace next, i.e. this is the command portion and not just part of the command
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <ncurses.h>
+#include "uart_panes.h"
+#include "scrollback.h"
+#include "uart_poll.h"
+#include "uart_ring.h"
+#include "core_set.h"
+#include "board.h"
+
+/**
+ * Split pane views of the UART output, as an alternative to the single interleaved stream. Every core's output is kept
+ * in its own fixed size scrollback, whichever view is shown, so it can be searched. The tiled view gives each enabled
+ * core a pane (as many as fit the terminal) and the focus view gives one core the whole terminal, which can be scrolled
+ * back. A frame redraws only the panes of cores with new output, and a pane never draws more than its own height of
+ * lines, so the cost of a frame is bounded by the size of the terminal rather than by the number of cores or the rate
+ * of their output. All calls, other than get_pane_view, are made holding the display lock
+ */
+
+struct pane {
+  WINDOW * window;
+  int core_id, height, width;
+};
+
+static struct scrollback * scrollbacks;
+static bool * dirty_cores;
+static int number_pane_cores;
+static struct pane * panes=NULL;
+static int number_panes=0, focus_core=0, layout_lines=0, layout_cols=0;
+// Also read by the render thread outside of the display lock, to decide whether output is drained whilst paused
+static _Atomic enum pane_view current_view=PANE_VIEW_STREAM;
+static uint64_t scroll_lines=0;
+static bool layout_stale=true;
+
+static void layout_panes(struct launchpad_configuration*);
+static void draw_pane(struct pane*);
+
+void initialise_panes(struct launchpad_configuration * config, struct device_configuration * device_config) {
+  number_pane_cores=device_config->number_cores;
+  scrollbacks=(struct scrollback*) malloc(sizeof(struct scrollback) * number_pane_cores);
+  dirty_cores=(bool*) malloc(sizeof(bool) * number_pane_cores);
+  for (int i=0;i<number_pane_cores;i++) {
+    initialise_scrollback(&scrollbacks[i], (uint64_t) config->scrollback_kb * 1024);
+    dirty_cores[i]=false;
+  }
+  current_view=config->tile_view ? PANE_VIEW_TILE : PANE_VIEW_STREAM;
+}
+
+void append_pane_output(int core_id, const char * data, uint64_t length) {
+  append_scrollback(&scrollbacks[core_id], data, length);
+  dirty_cores[core_id]=true;
+}
+
+void mark_pane_dirty(int core_id) {
+  dirty_cores[core_id]=true;
+}
+
+void set_pane_view(enum pane_view view, int core_id) {
+  current_view=view;
+  if (view == PANE_VIEW_FOCUS) focus_core=core_id;
+  scroll_lines=0;
+  layout_stale=true;
+}
+
+enum pane_view get_pane_view() {
+  return current_view;
+}
+
+void set_pane_scroll(uint64_t lines_back) {
+  scroll_lines=lines_back;
+  dirty_cores[focus_core]=true;
+}
+
+void redraw_all_panes() {
+  layout_stale=true;
+}
+
+/**
+ * Draws the panes of cores with new output and updates the terminal once, returning whether anything was drawn
+ */
+bool render_panes(struct launchpad_configuration * config) {
+  if (current_view == PANE_VIEW_STREAM) return false;
+  bool drawn=false;
+  if (layout_stale || LINES != layout_lines || COLS != layout_cols) {
+    layout_panes(config);
+    drawn=true;
+  }
+  for (int i=0;i<number_panes;i++) {
+    if (drawn || dirty_cores[panes[i].core_id]) draw_pane(&panes[i]);
+  }
+  for (int i=0;i<number_panes;i++) {
+    if (dirty_cores[panes[i].core_id]) drawn=true;
+  }
+  memset(dirty_cores, 0, sizeof(bool) * number_pane_cores);
+  if (drawn) doupdate();
+  return drawn;
+}
+
+/**
+ * Searches the scrollback of every core for lines containing the pattern, returning a description of those found
+ * with up to the maximum number of matching lines each cut to the width, freed by the caller
+ */
+char * generate_scrollback_matches(char * pattern, unsigned int max_matches, unsigned int width) {
+  unsigned int entry_size=width + 1;
+  char * matches=(char*) malloc(sizeof(char) * (entry_size * (max_matches + 1) + 1));
+  char line[PANE_LINE_SIZE], entry[PANE_LINE_SIZE + BOARD_CORE_NAME_SIZE + 8];
+  uint64_t number_matches=0, length=0;
+  int cores_matched=0;
+  for (int i=0;i<number_pane_cores;i++) {
+    struct scrollback * scrollback=&scrollbacks[i];
+    uint64_t position=0, core_matches=0;
+    while (read_scrollback_line(scrollback, &position, line, PANE_LINE_SIZE)) {
+      if (strstr(line, pattern) == NULL) continue;
+      core_matches++;
+      if (number_matches + core_matches > max_matches) continue;
+      char core_name[BOARD_CORE_NAME_SIZE];
+      describe_core(i, core_name);
+      snprintf(entry, sizeof(entry), "[%s]: %s", core_name, line);
+      if (width < sizeof(entry)) entry[width]='\0';
+      length+=sprintf(&matches[length], "%s\n", entry);
+    }
+    if (core_matches > 0) cores_matched++;
+    number_matches+=core_matches;
+  }
+  char summary[PANE_LINE_SIZE];
+  int summary_length=snprintf(summary, sizeof(summary), "%ld lines from %d cores match '%s'", number_matches, cores_matched, pattern);
+  if (number_matches > max_matches) snprintf(&summary[summary_length], sizeof(summary) - summary_length, ", the first %d are shown", max_matches);
+  if (width < sizeof(summary)) summary[width]='\0';
+  char * description=(char*) malloc(sizeof(char) * (strlen(summary) + length + 2));
+  sprintf(description, "%s\n%s", summary, matches);
+  free(matches);
+  return description;
+}
+
+/**
+ * Tiles the panes over all but the bottom line, which is left for commands. Character cells are about twice as tall
+ * as they are wide, so the number of panes across is chosen to keep them roughly square on screen, and cores beyond
+ * the number of panes of the minimum size that fit are not shown
+ */
+static void layout_panes(struct launchpad_configuration * config) {
+  for (int i=0;i<number_panes;i++) delwin(panes[i].window);
+  free(panes);
+  int area_rows=LINES - 1, area_cols=COLS, across=1, down=1;
+  int * cores=(int*) malloc(sizeof(int) * number_pane_cores);
+  int count;
+  if (current_view == PANE_VIEW_FOCUS) {
+    cores[0]=focus_core;
+    count=1;
+  } else {
+    count=get_cores_in_set(&config->active_cores, cores);
+    int max_across=area_cols / PANE_MIN_WIDTH > 0 ? area_cols / PANE_MIN_WIDTH : 1;
+    int max_down=area_rows / PANE_MIN_HEIGHT > 0 ? area_rows / PANE_MIN_HEIGHT : 1;
+    if (count > max_across * max_down) count=max_across * max_down;
+    while (across < max_across && across * across * area_rows * 2 < count * area_cols) across++;
+    down=count > 0 ? (count + across - 1) / across : 1;
+    if (down > max_down) {
+      down=max_down;
+      across=(count + down - 1) / down;
+    }
+  }
+  int pane_height=area_rows / down, pane_width=area_cols / across;
+  panes=(struct pane*) malloc(sizeof(struct pane) * (count > 0 ? count : 1));
+  for (int i=0;i<count;i++) {
+    int row=i / across, column=i % across;
+    // Panes side by side are separated by a blank column
+    panes[i].core_id=cores[i];
+    panes[i].height=pane_height;
+    panes[i].width=pane_width - (column < across - 1 ? 1 : 0);
+    panes[i].window=newwin(panes[i].height, panes[i].width, row * pane_height, column * pane_width);
+  }
+  free(cores);
+  number_panes=count;
+  layout_lines=LINES;
+  layout_cols=COLS;
+  layout_stale=false;
+  // Whatever was on the screen before is cleared from around the panes
+  erase();
+  wnoutrefresh(stdscr);
+}
+
+static void draw_pane(struct pane * pane) {
+  struct scrollback * scrollback=&scrollbacks[pane->core_id];
+  char core_name[BOARD_CORE_NAME_SIZE], title[PANE_LINE_SIZE], line[PANE_LINE_SIZE];
+  describe_core(pane->core_id, core_name);
+  uint64_t dropped=atomic_load(&get_uart_output_ring(pane->core_id)->dropped_bytes);
+  int length=snprintf(title, sizeof(title), " [%s] %ld lines", core_name, scrollback->total_lines);
+  if (dropped > 0) length+=snprintf(&title[length], sizeof(title) - length, ", %ld bytes dropped", dropped);
+  if (current_view == PANE_VIEW_FOCUS && scroll_lines > 0) snprintf(&title[length], sizeof(title) - length, ", %ld lines back", scroll_lines);
+  werase(pane->window);
+  wattron(pane->window, A_REVERSE);
+  mvwhline(pane->window, 0, 0, ' ', pane->width);
+  mvwaddnstr(pane->window, 0, 0, title, pane->width);
+  wattroff(pane->window, A_REVERSE);
+
+  int content_rows=pane->height - 1;
+  uint64_t lines_back=content_rows - 1 + (current_view == PANE_VIEW_FOCUS ? scroll_lines : 0);
+  uint64_t position=find_scrollback_line(scrollback, lines_back);
+  unsigned int line_size=pane->width + 1 < PANE_LINE_SIZE ? pane->width + 1 : PANE_LINE_SIZE;
+  for (int row=1;row<=content_rows && read_scrollback_line(scrollback, &position, line, line_size);row++) {
+    // Control characters such as tabs would spill over the pane's edge
+    for (char * c=line;*c != '\0';c++) {
+      if ((unsigned char) *c < ' ') *c=' ';
+    }
+    mvwaddstr(pane->window, row, 0, line);
+  }
+  wnoutrefresh(pane->window);
+}
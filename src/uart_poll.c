@@ -0,0 +1,472 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include "uart_poll.h"
+#include "uart_ring.h"
+#include "launchpad_common.h"
+#include "configuration.h"
+#include "util.h"
+#include "core_set.h"
+#include "driver_fallback.h"
+#include "device_lock.h"
+#include "board.h"
+#include "uart_capture.h"
+#include "uart_frame.h"
+#include "counter.h"
+
+#define UART_READ_CHUNK_SIZE 256
+#define POLL_MIN_SLEEP_US 10
+
+/**
+ * UART pollers, each thread owns a shard of the polled cores and drains their UART into per core rings. Consumers (the
+ * interactive display or headless output) read from these rings on their own thread, so the device side never
+ * waits on terminal or file I/O
+ */
+
+_Atomic bool continuePoll;
+
+// Idle pollers sleep on this condition, which is signalled whenever there is likely to be new UART activity
+static pthread_mutex_t poll_wakeup_mutex=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poll_wakeup_cond=PTHREAD_COND_INITIALIZER;
+static unsigned long poll_wakeup_generation=0;
+
+// Consumers sleep on this condition, which is signalled by pollers when they have pushed data into a ring
+static pthread_mutex_t output_mutex=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t output_cond=PTHREAD_COND_INITIALIZER;
+static unsigned long output_generation=0, output_consumed_generation=0;
+
+struct poller_statistics {
+  _Atomic uint64_t wakes_after_sleep, total_wake_latency_us, max_wake_latency_us;
+  struct timespec start_time;
+  clockid_t * cpu_clocks;
+  bool * cpu_clocks_valid;
+};
+
+static struct poller_statistics poll_stats;
+
+// Counters of the UART pipeline, each has a single writer (the poller holding the core's lock, or the poller itself) and sits
+// on its own cache line so pollers never share one
+struct core_uart_counters {
+  _Alignas(64) _Atomic uint64_t bytes_received;
+  _Atomic uint64_t lines_received, polls, empty_polls, lock_wait_ns;
+};
+
+struct poller_counters {
+  _Alignas(64) _Atomic uint64_t sweeps;
+};
+
+static struct core_uart_counters * core_counters;
+static struct poller_counters * poller_counters;
+static struct uart_ring * output_rings;
+// Cores polled alongside the enabled cores, such as those running queued jobs, guarded by their mutex
+static struct core_set extra_poll_cores;
+static pthread_mutex_t extra_poll_mutex=PTHREAD_MUTEX_INITIALIZER;
+
+struct ThreadArgsStruct {
+  struct launchpad_configuration * config;
+  struct device_configuration * device_config;
+  struct device_drivers * active_device_drivers;
+  int poller_id;
+};
+
+static void * poll_uart_thread(void*);
+static void assign_poll_shard(struct core_set*, int, int, struct core_set*);
+static void pin_poller_thread(pthread_t, int);
+static void uart_event_handler(int);
+static void wait_for_uart_activity(struct launchpad_configuration*, bool, unsigned int*, unsigned int*);
+static uint64_t get_elapsed_us(struct timespec*);
+static unsigned int poll_core_for_uart(int, struct device_drivers*);
+static int describe_core_statistics(char*, char*, struct uart_core_statistics*, double);
+
+void start_uart_pollers(struct launchpad_configuration * config, struct device_configuration * device_config,
+      struct device_drivers * active_device_drivers, bool polling) {
+  continuePoll=polling;
+  memset(&poll_stats, 0, sizeof(struct poller_statistics));
+  clock_gettime(CLOCK_MONOTONIC, &poll_stats.start_time);
+  poll_stats.cpu_clocks=(clockid_t*) malloc(sizeof(clockid_t) * config->poll_threads);
+  poll_stats.cpu_clocks_valid=(bool*) malloc(sizeof(bool) * config->poll_threads);
+
+  // Rings are allocated for every core as the enabled cores can be changed whilst the pollers are running
+  output_rings=(struct uart_ring*) malloc(sizeof(struct uart_ring) * device_config->number_cores);
+  for (int i=0;i<device_config->number_cores;i++) {
+    initialise_uart_ring(&output_rings[i], (uint64_t) config->uart_buffer_kb * 1024);
+  }
+  core_counters=(struct core_uart_counters*) aligned_alloc(64, sizeof(struct core_uart_counters) * device_config->number_cores);
+  memset(core_counters, 0, sizeof(struct core_uart_counters) * device_config->number_cores);
+  poller_counters=(struct poller_counters*) aligned_alloc(64, sizeof(struct poller_counters) * config->poll_threads);
+  memset(poller_counters, 0, sizeof(struct poller_counters) * config->poll_threads);
+  initialise_core_set(&extra_poll_cores, device_config->number_cores);
+
+  if (active_device_drivers->device_set_uart_event_handler != NULL) {
+    // Backends that can raise an event on UART data wake an idle poller immediately
+    check_device_status(active_device_drivers->device_set_uart_event_handler(uart_event_handler));
+  }
+
+  for (int i=0;i<config->poll_threads;i++) {
+    struct ThreadArgsStruct * threadArgs=(struct ThreadArgsStruct*) malloc(sizeof(struct ThreadArgsStruct));
+    threadArgs->config=config;
+    threadArgs->device_config=device_config;
+    threadArgs->active_device_drivers=active_device_drivers;
+    threadArgs->poller_id=i;
+    pthread_t threadId;
+    int err = pthread_create(&threadId, NULL, &poll_uart_thread, threadArgs);
+    if (err) {
+      fprintf(stderr, "Error calling device function\n");
+      raise(SIGABRT);
+      exit(-1);
+    }
+    if (config->poll_pin_cpu >= 0) pin_poller_thread(threadId, config->poll_pin_cpu+i);
+    poll_stats.cpu_clocks_valid[i]=pthread_getcpuclockid(threadId, &poll_stats.cpu_clocks[i]) == 0;
+    pthread_detach(threadId);
+  }
+}
+
+void add_uart_poll_cores(struct core_set * cores) {
+  pthread_mutex_lock(&extra_poll_mutex);
+  union_core_sets(&extra_poll_cores, cores);
+  pthread_mutex_unlock(&extra_poll_mutex);
+  wake_uart_poller();
+}
+
+void remove_uart_poll_cores(struct core_set * cores) {
+  pthread_mutex_lock(&extra_poll_mutex);
+  subtract_core_sets(&extra_poll_cores, cores);
+  pthread_mutex_unlock(&extra_poll_mutex);
+}
+
+void set_uart_polling(bool polling) {
+  continuePoll=polling;
+  if (polling) wake_uart_poller();
+}
+
+/**
+ * Sets the target to the cores being polled, the enabled cores and any polled alongside them
+ */
+void get_uart_poll_cores(struct launchpad_configuration * config, struct core_set * target) {
+  copy_core_set(target, &config->active_cores);
+  pthread_mutex_lock(&extra_poll_mutex);
+  // Before the pollers start there are no extra cores
+  if (extra_poll_cores.words != NULL) union_core_sets(target, &extra_poll_cores);
+  pthread_mutex_unlock(&extra_poll_mutex);
+}
+
+/**
+ * Blocks until each of the cores has been polled and found empty since the call, so once the cores are stopped
+ * everything they sent has reached the rings and polling can be stopped without losing their trailing output
+ */
+void flush_uart_poll_cores(struct launchpad_configuration * config, struct core_set * cores) {
+  if (!continuePoll) return;
+  uint64_t * marks=(uint64_t*) malloc(sizeof(uint64_t) * cores->number_cores);
+  for (int i=next_core_in_set(cores, 0);i>=0;i=next_core_in_set(cores, i+1)) {
+    marks[i]=atomic_load_explicit(&core_counters[i].empty_polls, memory_order_acquire);
+  }
+  struct core_set polled_cores;
+  initialise_core_set(&polled_cores, cores->number_cores);
+  bool flushed=false;
+  while (!flushed && continuePoll) {
+    wake_uart_poller();
+    usleep(POLL_MIN_SLEEP_US);
+    get_uart_poll_cores(config, &polled_cores);
+    flushed=true;
+    for (int i=next_core_in_set(cores, 0);i>=0;i=next_core_in_set(cores, i+1)) {
+      // A poll already under way at the call might have read the core before it stopped, so the second empty poll is
+      // the first known to have started after it. Cores no longer polled have nothing more to give
+      if (is_core_in_set(&polled_cores, i) && atomic_load_explicit(&core_counters[i].empty_polls, memory_order_acquire) < marks[i] + 2) flushed=false;
+    }
+  }
+  free_core_set(&polled_cores);
+  free(marks);
+}
+
+bool is_uart_polling() {
+  return continuePoll;
+}
+
+struct uart_ring * get_uart_output_ring(int core_id) {
+  return &output_rings[core_id];
+}
+
+/**
+ * Blocks the consumer until a poller has pushed new data into any ring or the timeout (in milliseconds) expires,
+ * returns whether there is new data
+ */
+bool wait_for_uart_output(unsigned int timeout_ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec+=timeout_ms / 1000;
+  deadline.tv_nsec+=(long) (timeout_ms % 1000) * 1000000;
+  deadline.tv_sec+=deadline.tv_nsec / 1000000000;
+  deadline.tv_nsec=deadline.tv_nsec % 1000000000;
+  pthread_mutex_lock(&output_mutex);
+  int rc=0;
+  while (output_consumed_generation == output_generation && rc != ETIMEDOUT) {
+    rc=pthread_cond_timedwait(&output_cond, &output_mutex, &deadline);
+  }
+  bool new_output=output_consumed_generation != output_generation;
+  output_consumed_generation=output_generation;
+  pthread_mutex_unlock(&output_mutex);
+  return new_output;
+}
+
+void get_uart_poll_statistics(struct launchpad_configuration * config, struct uart_poll_statistics * statistics) {
+  statistics->wakes_after_sleep=poll_stats.wakes_after_sleep;
+  statistics->total_wake_latency_us=poll_stats.total_wake_latency_us;
+  statistics->max_wake_latency_us=poll_stats.max_wake_latency_us;
+  uint64_t wall_us=get_elapsed_us(&poll_stats.start_time), cpu_us=0;
+  for (int i=0;i<config->poll_threads;i++) {
+    if (poll_stats.cpu_clocks_valid[i]) {
+      struct timespec cpu_time;
+      clock_gettime(poll_stats.cpu_clocks[i], &cpu_time);
+      cpu_us+=(cpu_time.tv_sec * 1000000) + (cpu_time.tv_nsec / 1000);
+    }
+  }
+  statistics->cpu_usage=wall_us > 0 ? ((double) cpu_us / wall_us) * 100.0 : 0.0;
+  statistics->wall_us=wall_us;
+  statistics->sweeps=0;
+  for (int i=0;i<config->poll_threads;i++) statistics->sweeps+=atomic_load_explicit(&poller_counters[i].sweeps, memory_order_relaxed);
+}
+
+void get_uart_core_statistics(int core_id, struct uart_core_statistics * statistics) {
+  struct core_uart_counters * counters=&core_counters[core_id];
+  statistics->bytes_received=atomic_load_explicit(&counters->bytes_received, memory_order_relaxed);
+  statistics->lines_received=atomic_load_explicit(&counters->lines_received, memory_order_relaxed);
+  statistics->polls=atomic_load_explicit(&counters->polls, memory_order_relaxed);
+  statistics->empty_polls=atomic_load_explicit(&counters->empty_polls, memory_order_relaxed);
+  statistics->lock_wait_ns=atomic_load_explicit(&counters->lock_wait_ns, memory_order_relaxed);
+  statistics->dropped_bytes=atomic_load(&output_rings[core_id].dropped_bytes);
+  statistics->capture_dropped_bytes=get_capture_dropped_bytes(core_id);
+  get_uart_frame_statistics(core_id, &statistics->frames_received, &statistics->frame_bytes, &statistics->frame_errors);
+}
+
+/**
+ * Describes the pipeline from the device to the rings, the poller sweeps and then each core that has been polled with
+ * what it sent, how often polls found nothing and how long its poller waited on the device lock. Rates are averages
+ * since the pollers started, the target needs a line of UART_STATISTICS_LINE_SIZE for each core plus two
+ */
+void describe_uart_statistics(struct launchpad_configuration * config, struct device_configuration * device_config, char * target) {
+  struct uart_poll_statistics statistics;
+  get_uart_poll_statistics(config, &statistics);
+  double wall_sec=statistics.wall_us > 0 ? statistics.wall_us / 1e6 : 1.0;
+  int length=sprintf(target, "UART pipeline over %.3fs: %ld poller sweeps (%.0f/s) by %d thread(s) using %.2f%% of one host core\n", wall_sec,
+    statistics.sweeps, statistics.sweeps / wall_sec, config->poll_threads, statistics.cpu_usage);
+  struct uart_core_statistics total;
+  memset(&total, 0, sizeof(struct uart_core_statistics));
+  for (int i=0;i<device_config->number_cores;i++) {
+    struct uart_core_statistics core;
+    get_uart_core_statistics(i, &core);
+    if (core.polls == 0 && core.dropped_bytes == 0 && core.capture_dropped_bytes == 0) continue;
+    char core_name[BOARD_CORE_NAME_SIZE];
+    describe_core(i, core_name);
+    char label[BOARD_CORE_NAME_SIZE + 8];
+    sprintf(label, "Core %s", core_name);
+    length+=describe_core_statistics(&target[length], label, &core, wall_sec);
+    total.bytes_received+=core.bytes_received;
+    total.lines_received+=core.lines_received;
+    total.polls+=core.polls;
+    total.empty_polls+=core.empty_polls;
+    total.lock_wait_ns+=core.lock_wait_ns;
+    total.dropped_bytes+=core.dropped_bytes;
+    total.capture_dropped_bytes+=core.capture_dropped_bytes;
+    total.frames_received+=core.frames_received;
+    total.frame_bytes+=core.frame_bytes;
+    total.frame_errors+=core.frame_errors;
+  }
+  describe_core_statistics(&target[length], "All cores", &total, wall_sec);
+}
+
+static int describe_core_statistics(char * target, char * label, struct uart_core_statistics * statistics, double wall_sec) {
+  int length=sprintf(target, "%s: %ld bytes (%.0fB/s), %ld lines, %ld polls (%.1f%% empty), %.3fms waiting on the device lock, %ld bytes dropped",
+    label, statistics->bytes_received, statistics->bytes_received / wall_sec, statistics->lines_received, statistics->polls,
+    statistics->polls > 0 ? (100.0 * statistics->empty_polls) / statistics->polls : 0.0, statistics->lock_wait_ns / 1e6, statistics->dropped_bytes);
+  if (is_uart_capture_enabled()) length+=sprintf(&target[length], ", %ld from the capture", statistics->capture_dropped_bytes);
+  if (is_uart_frame_decoding_enabled()) {
+    length+=sprintf(&target[length], ", %ld frames (%ld bytes, %ld bad)", statistics->frames_received, statistics->frame_bytes, statistics->frame_errors);
+  }
+  return length+sprintf(&target[length], "\n");
+}
+
+static void * poll_uart_thread(void * args) {
+  struct ThreadArgsStruct * threadArgs = (struct ThreadArgsStruct*) args;
+
+  // Each sweep only visits this poller's shard of the polled cores, which is reassigned whenever those cores change
+  struct core_set polled_cores, sharded_cores, sweep_cores;
+  initialise_core_set(&polled_cores, threadArgs->device_config->number_cores);
+  initialise_core_set(&sharded_cores, threadArgs->device_config->number_cores);
+  initialise_core_set(&sweep_cores, threadArgs->device_config->number_cores);
+  unsigned int idle_sweeps=0, sleep_us=0;
+  while (1==1) {
+    bool data_received=false;
+    if (continuePoll) {
+      get_uart_poll_cores(threadArgs->config, &polled_cores);
+      if (!are_core_sets_equal(&polled_cores, &sharded_cores)) {
+        copy_core_set(&sharded_cores, &polled_cores);
+        assign_poll_shard(&sharded_cores, threadArgs->config->poll_threads, threadArgs->poller_id, &sweep_cores);
+      }
+      add_to_counter(&poller_counters[threadArgs->poller_id].sweeps, 1);
+      for (int i=next_core_in_set(&sweep_cores, 0);i>=0;i=next_core_in_set(&sweep_cores, i+1)) {
+        if (poll_core_for_uart(i, threadArgs->active_device_drivers) > 0) {
+          data_received=true;
+        }
+      }
+    }
+    if (data_received) {
+      notify_uart_output();
+      if (sleep_us > 0) {
+        // The previous sleep is the worst case latency that backing off added to this data
+        poll_stats.wakes_after_sleep++;
+        poll_stats.total_wake_latency_us+=sleep_us;
+        if (sleep_us > poll_stats.max_wake_latency_us) poll_stats.max_wake_latency_us=sleep_us;
+      }
+      idle_sweeps=0;
+      sleep_us=0;
+    } else {
+      wait_for_uart_activity(threadArgs->config, continuePoll, &idle_sweeps, &sleep_us);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * The polled cores are grouped by lock domain and then split into contiguous shards, one per poller thread, so the
+ * pollers share the cores actually being polled evenly and, where the driver allows concurrent access, mostly contend
+ * on distinct locks. Sets the target to the shard of the given poller
+ */
+static void assign_poll_shard(struct core_set * polled_cores, int num_pollers, int poller_id, struct core_set * shard) {
+  clear_core_set(shard);
+  int count=count_cores_in_set(polled_cores);
+  if (count == 0) return;
+  int shard_size=(count + num_pollers - 1) / num_pollers, number_domains=get_number_lock_domains();
+  // A counting sort by domain, which keeps the cores of each domain in order
+  int * domain_positions=(int*) calloc(number_domains + 1, sizeof(int));
+  for (int i=next_core_in_set(polled_cores, 0);i>=0;i=next_core_in_set(polled_cores, i+1)) domain_positions[get_core_lock_domain(i)+1]++;
+  for (int domain=0;domain<number_domains;domain++) domain_positions[domain+1]+=domain_positions[domain];
+  for (int i=next_core_in_set(polled_cores, 0);i>=0;i=next_core_in_set(polled_cores, i+1)) {
+    if (domain_positions[get_core_lock_domain(i)]++ / shard_size == poller_id) add_core_to_set(shard, i);
+  }
+  free(domain_positions);
+}
+
+static void pin_poller_thread(pthread_t thread, int cpu) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu % sysconf(_SC_NPROCESSORS_ONLN), &cpu_set);
+  if (pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpu_set) != 0) {
+    fprintf(stderr, "Warning, unable to pin UART poller thread to CPU %d\n", cpu);
+  }
+}
+
+void wake_uart_poller() {
+  pthread_mutex_lock(&poll_wakeup_mutex);
+  poll_wakeup_generation++;
+  pthread_cond_broadcast(&poll_wakeup_cond);
+  pthread_mutex_unlock(&poll_wakeup_mutex);
+}
+
+static void uart_event_handler(int core_id) {
+  wake_uart_poller();
+}
+
+void notify_uart_output() {
+  pthread_mutex_lock(&output_mutex);
+  output_generation++;
+  pthread_cond_broadcast(&output_cond);
+  pthread_mutex_unlock(&output_mutex);
+}
+
+/**
+ * Called by the poller after a sweep that found no data. Initially spins for a configurable number of sweeps, then
+ * backs off with exponentially increasing sleeps capped by the poll rate. If polling is disabled (e.g. cores stopped)
+ * then blocks until woken. Any wakeup resets the backoff
+ */
+static void wait_for_uart_activity(struct launchpad_configuration * config, bool polling, unsigned int * idle_sweeps, unsigned int * sleep_us) {
+  if (polling && *idle_sweeps < config->poll_spin_sweeps) {
+    (*idle_sweeps)++;
+    return;
+  }
+  pthread_mutex_lock(&poll_wakeup_mutex);
+  unsigned long generation=poll_wakeup_generation;
+  if (!polling) {
+    while (generation == poll_wakeup_generation) pthread_cond_wait(&poll_wakeup_cond, &poll_wakeup_mutex);
+  } else {
+    unsigned int max_sleep_us=config->poll_rate_hz > 0 ? 1000000 / config->poll_rate_hz : 0;
+    *sleep_us=*sleep_us == 0 ? POLL_MIN_SLEEP_US : *sleep_us * 2;
+    if (*sleep_us > max_sleep_us) *sleep_us=max_sleep_us;
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec+=(long) *sleep_us * 1000;
+    deadline.tv_sec+=deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec=deadline.tv_nsec % 1000000000;
+    int rc=0;
+    while (generation == poll_wakeup_generation && rc != ETIMEDOUT) {
+      rc=pthread_cond_timedwait(&poll_wakeup_cond, &poll_wakeup_mutex, &deadline);
+    }
+  }
+  if (generation != poll_wakeup_generation) {
+    *idle_sweeps=0;
+    *sleep_us=0;
+  }
+  pthread_mutex_unlock(&poll_wakeup_mutex);
+}
+
+static uint64_t get_elapsed_us(struct timespec * start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((now.tv_sec - start->tv_sec) * 1000000) + ((now.tv_nsec - start->tv_nsec) / 1000);
+}
+
+/**
+ * Everything done with what was read stays under the core's lock, as when the polled cores change two pollers can
+ * briefly both hold a core in their shards whilst the ring, frame decoder, capture record and counters of a core only
+ * allow a single writer. The frame consumer is called under the lock too
+ */
+static unsigned int poll_core_for_uart(int core_id, struct device_drivers * active_device_drivers) {
+  // Drain as much of the core's UART FIFO as possible with a single lock acquisition and driver call
+  char data[UART_READ_CHUNK_SIZE];
+  unsigned int bytes_read=0;
+  struct timespec lock_requested, lock_acquired;
+  clock_gettime(CLOCK_MONOTONIC, &lock_requested);
+  lock_device_core(core_id);
+  clock_gettime(CLOCK_MONOTONIC, &lock_acquired);
+  if (!continuePoll) {
+    // Polling was stopped whilst waiting, the device may since have been reset or finalised under the lock
+    unlock_device_core(core_id);
+    return 0;
+  }
+  check_device_status(driver_read_uart_bulk(active_device_drivers, core_id, data, UART_READ_CHUNK_SIZE, &bytes_read));
+
+  struct core_uart_counters * counters=&core_counters[core_id];
+  add_to_counter(&counters->polls, 1);
+  add_to_counter(&counters->lock_wait_ns, ((lock_acquired.tv_sec - lock_requested.tv_sec) * 1000000000) + (lock_acquired.tv_nsec - lock_requested.tv_nsec));
+  if (bytes_read > 0) {
+    // Binary frames are taken out here, so only text carries on to the ring and capture
+    char frame_text[UART_READ_CHUNK_SIZE + 1];
+    char * text=data;
+    unsigned int text_length=bytes_read;
+    if (is_uart_frame_decoding_enabled()) {
+      text=frame_text;
+      text_length=decode_uart_frames(core_id, data, bytes_read, frame_text, &lock_acquired);
+    }
+    unsigned int lines=0;
+    if (text_length > 0) {
+      uart_ring_push(&output_rings[core_id], text, text_length);
+      capture_uart_data(core_id, text, text_length, &lock_acquired);
+      for (unsigned int i=0;i<text_length;i++) {
+        if (text[i] == '\n') lines++;
+      }
+    }
+    add_to_counter(&counters->bytes_received, bytes_read);
+    if (lines > 0) add_to_counter(&counters->lines_received, lines);
+  } else {
+    // Released so that a flush seeing the count also sees everything pushed before it
+    atomic_store_explicit(&counters->empty_polls, atomic_load_explicit(&counters->empty_polls, memory_order_relaxed) + 1, memory_order_release);
+  }
+  unlock_device_core(core_id);
+  return bytes_read;
+}
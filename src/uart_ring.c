@@ -0,0 +1,63 @@
+#include <stdlib.h>
+#include <string.h>
+#include "uart_ring.h"
+
+static void copy_into_ring(struct uart_ring*, uint64_t, const char*, uint64_t);
+static void copy_from_ring(struct uart_ring*, uint64_t, char*, uint64_t);
+
+void initialise_uart_ring(struct uart_ring * ring, uint64_t capacity) {
+  ring->buffer=(char*) malloc(sizeof(char) * capacity);
+  ring->capacity=capacity;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->dropped_bytes, 0);
+}
+
+/**
+ * Pushes as much of the data as there is space for, never blocking the producer. Anything that does not fit
+ * is dropped and accounted for in the ring's dropped bytes counter. Returns the number of bytes pushed
+ */
+uint64_t uart_ring_push(struct uart_ring * ring, const char * data, uint64_t length) {
+  uint64_t head=atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint64_t tail=atomic_load_explicit(&ring->tail, memory_order_acquire);
+  uint64_t space=ring->capacity - (head - tail);
+  uint64_t to_push=length < space ? length : space;
+  copy_into_ring(ring, head, data, to_push);
+  atomic_store_explicit(&ring->head, head + to_push, memory_order_release);
+  if (to_push < length) atomic_fetch_add_explicit(&ring->dropped_bytes, length - to_push, memory_order_relaxed);
+  return to_push;
+}
+
+uint64_t uart_ring_pop(struct uart_ring * ring, char * data, uint64_t max_length) {
+  uint64_t tail=atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint64_t head=atomic_load_explicit(&ring->head, memory_order_acquire);
+  uint64_t to_pop=(head - tail) < max_length ? (head - tail) : max_length;
+  copy_from_ring(ring, tail, data, to_pop);
+  atomic_store_explicit(&ring->tail, tail + to_pop, memory_order_release);
+  return to_pop;
+}
+
+uint64_t uart_ring_discard(struct uart_ring * ring) {
+  uint64_t tail=atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint64_t head=atomic_load_explicit(&ring->head, memory_order_acquire);
+  atomic_store_explicit(&ring->tail, head, memory_order_release);
+  return head - tail;
+}
+
+uint64_t uart_ring_used(struct uart_ring * ring) {
+  return atomic_load_explicit(&ring->head, memory_order_acquire) - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+static void copy_into_ring(struct uart_ring * ring, uint64_t position, const char * data, uint64_t length) {
+  uint64_t offset=position % ring->capacity;
+  uint64_t first_part=ring->capacity - offset < length ? ring->capacity - offset : length;
+  memcpy(&ring->buffer[offset], data, first_part);
+  if (first_part < length) memcpy(ring->buffer, &data[first_part], length - first_part);
+}
+
+static void copy_from_ring(struct uart_ring * ring, uint64_t position, char * data, uint64_t length) {
+  uint64_t offset=position % ring->capacity;
+  uint64_t first_part=ring->capacity - offset < length ? ring->capacity - offset : length;
+  memcpy(data, &ring->buffer[offset], first_part);
+  if (first_part < length) memcpy(&data[first_part], ring->buffer, length - first_part);
+}
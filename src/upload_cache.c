@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "upload_cache.h"
+#include "launchpad_common.h"
+#include "async_transfer.h"
+
+#define HASH_PRIME_1 0x9e3779b185ebca87ULL
+#define HASH_PRIME_2 0xc2b2ae3d27d4eb4fULL
+#define HASH_PRIME_3 0x165667b19e3779f9ULL
+#define HASH_PRIME_4 0x85ebca77c2b2ae63ULL
+
+/**
+ * Host side record of what was last written to each core's instruction space (and the shared instruction space) as a
+ * 128 bit hash per aligned block of device memory. Uploads only write the blocks whose contents differ from the
+ * record, so restarting an unchanged executable transfers only what the cores can have modified and a rebuilt one
+ * only its changed pages. A hash of zero means the block's contents are unknown, blocks that are only partially
+ * covered by a write are recorded as unknown. Cores can write to their own instruction memory once they run (such as
+ * the .data and .bss of a flat binary), so only blocks of read only ELF segments are ever recorded, everything else
+ * is recorded as unknown and always rewritten. The record is dropped on device reset
+ */
+
+struct cached_space {
+  struct upload_block_hash * block_hashes;
+  uint64_t num_blocks;
+};
+
+static struct cached_space * cached_spaces=NULL;
+static int number_cores=0;
+static bool cache_enabled=false;
+
+static struct cached_space * get_cached_space(int);
+static void ensure_cached_blocks(struct cached_space*, uint64_t);
+static void hash_block(char*, struct upload_block_hash*);
+static bool is_same_block_hash(struct upload_block_hash*, struct upload_block_hash*);
+static bool is_unknown_block_hash(struct upload_block_hash*);
+static uint64_t mix_hash_lane(uint64_t);
+static uint64_t write_instruction_range(struct transfer_queue*, int, uint64_t, uint64_t, char*, uint64_t);
+static void write_core_set_instruction_range(struct transfer_queue*, uint64_t*, uint64_t, uint64_t, char*, uint64_t);
+
+void initialise_upload_cache(struct device_configuration * device_config, bool enabled) {
+  number_cores=device_config->number_cores;
+  cache_enabled=enabled;
+  // The final entry holds the shared instruction space
+  cached_spaces=(struct cached_space*) calloc(number_cores + 1, sizeof(struct cached_space));
+}
+
+bool is_upload_cache_enabled() {
+  return cache_enabled;
+}
+
+void invalidate_upload_cache() {
+  if (cached_spaces == NULL) return;
+  for (int i=0;i<=number_cores;i++) {
+    if (cached_spaces[i].block_hashes != NULL) memset(cached_spaces[i].block_hashes, 0, sizeof(struct upload_block_hash) * cached_spaces[i].num_blocks);
+  }
+}
+
+/**
+ * Hashes each block of device memory touched by writing data to address, these are shared by every core that the
+ * data is written to. Blocks only partially covered by the data, or that the cores might write to, have no hash
+ */
+void hash_upload_blocks(uint64_t address, char * data, uint64_t length, bool read_only, struct upload_block_hash * hashes) {
+  if (length == 0) return;
+  uint64_t first_block=address / UPLOAD_CACHE_BLOCK_SIZE, last_block=(address + length - 1) / UPLOAD_CACHE_BLOCK_SIZE;
+  for (uint64_t block=first_block;block<=last_block;block++) {
+    uint64_t block_start=block * UPLOAD_CACHE_BLOCK_SIZE;
+    if (read_only && block_start >= address && block_start + UPLOAD_CACHE_BLOCK_SIZE <= address + length) {
+      hash_block(&data[block_start - address], &hashes[block - first_block]);
+    } else {
+      memset(&hashes[block - first_block], 0, sizeof(struct upload_block_hash));
+    }
+  }
+}
+
+/**
+ * Submits writes of data to a core's instruction space (or the shared space if the core is UPLOAD_CACHE_SHARED_SPACE),
+ * skipping blocks that already hold the same contents and coalescing consecutive changed blocks into a single transfer.
+ * Returns the number of bytes that will be written to the device, the caller waits for the transfers on its queue
+ */
+uint64_t write_cached_instructions(struct transfer_queue * queue, int core_id, uint64_t address, char * data,
+      uint64_t length, struct upload_block_hash * hashes) {
+  if (length == 0) return 0;
+  struct cached_space * space=get_cached_space(core_id);
+  uint64_t first_block=address / UPLOAD_CACHE_BLOCK_SIZE, last_block=(address + length - 1) / UPLOAD_CACHE_BLOCK_SIZE;
+  ensure_cached_blocks(space, last_block + 1);
+
+  uint64_t bytes_written=0, run_start=0;
+  bool in_run=false;
+  for (uint64_t block=first_block;block<=last_block;block++) {
+    struct upload_block_hash * hash=&hashes[block - first_block];
+    bool changed=is_unknown_block_hash(hash) || !is_same_block_hash(&space->block_hashes[block], hash);
+    space->block_hashes[block]=*hash;
+    uint64_t block_start=block * UPLOAD_CACHE_BLOCK_SIZE;
+    if (changed && !in_run) {
+      run_start=block_start > address ? block_start : address;
+      in_run=true;
+    } else if (!changed && in_run) {
+      bytes_written+=write_instruction_range(queue, core_id, address, run_start, data, block_start);
+      in_run=false;
+    }
+  }
+  if (in_run) bytes_written+=write_instruction_range(queue, core_id, address, run_start, data, address + length);
+  return bytes_written;
+}
+
+/**
+ * As write_cached_instructions but with one multicast transfer to every core in the set, a block is skipped only if
+ * it is unchanged on all of the cores. Returns the total number of bytes that will be written across the cores
+ */
+uint64_t write_cached_core_set_instructions(struct transfer_queue * queue, int * cores, int num_cores, uint64_t * core_mask, uint64_t address,
+      char * data, uint64_t length, struct upload_block_hash * hashes) {
+  if (length == 0) return 0;
+  uint64_t first_block=address / UPLOAD_CACHE_BLOCK_SIZE, last_block=(address + length - 1) / UPLOAD_CACHE_BLOCK_SIZE;
+  for (int i=0;i<num_cores;i++) ensure_cached_blocks(get_cached_space(cores[i]), last_block + 1);
+
+  uint64_t bytes_written=0, run_start=0;
+  bool in_run=false;
+  for (uint64_t block=first_block;block<=last_block;block++) {
+    struct upload_block_hash * hash=&hashes[block - first_block];
+    bool changed=is_unknown_block_hash(hash);
+    for (int i=0;i<num_cores;i++) {
+      struct cached_space * space=get_cached_space(cores[i]);
+      if (!is_same_block_hash(&space->block_hashes[block], hash)) changed=true;
+      space->block_hashes[block]=*hash;
+    }
+    uint64_t block_start=block * UPLOAD_CACHE_BLOCK_SIZE;
+    if (changed && !in_run) {
+      run_start=block_start > address ? block_start : address;
+      in_run=true;
+    } else if (!changed && in_run) {
+      write_core_set_instruction_range(queue, core_mask, address, run_start, data, block_start);
+      bytes_written+=(block_start - run_start) * num_cores;
+      in_run=false;
+    }
+  }
+  if (in_run) {
+    write_core_set_instruction_range(queue, core_mask, address, run_start, data, address + length);
+    bytes_written+=(address + length - run_start) * num_cores;
+  }
+  return bytes_written;
+}
+
+static struct cached_space * get_cached_space(int core_id) {
+  return core_id == UPLOAD_CACHE_SHARED_SPACE ? &cached_spaces[number_cores] : &cached_spaces[core_id];
+}
+
+/**
+ * Grows the record of a space to cover the number of blocks, each space is only ever accessed by one loader thread at
+ * a time so this needs no locking
+ */
+static void ensure_cached_blocks(struct cached_space * space, uint64_t num_blocks) {
+  if (num_blocks <= space->num_blocks) return;
+  space->block_hashes=(struct upload_block_hash*) realloc(space->block_hashes, sizeof(struct upload_block_hash) * num_blocks);
+  if (space->block_hashes == NULL) {
+    fprintf(stderr, "Error allocating memory for the upload cache\n");
+    exit(-1);
+  }
+  memset(&space->block_hashes[space->num_blocks], 0, sizeof(struct upload_block_hash) * (num_blocks - space->num_blocks));
+  space->num_blocks=num_blocks;
+}
+
+/**
+ * Two independent lanes over 64 bit words, each an add, multiply and rotate round (as in xxHash) so that every bit of a
+ * word reaches every bit of the lane, and each finished with a full avalanche. Changes to several words can not cancel
+ * each other out as they can when words are only xored into the hash. Zero is reserved for unknown blocks
+ */
+static void hash_block(char * data, struct upload_block_hash * hash) {
+  uint64_t low=HASH_PRIME_1 + HASH_PRIME_2, high=HASH_PRIME_3, word;
+  for (int i=0;i<UPLOAD_CACHE_BLOCK_SIZE;i+=sizeof(uint64_t)) {
+    memcpy(&word, &data[i], sizeof(uint64_t));
+    low+=word * HASH_PRIME_2;
+    low=((low << 31) | (low >> 33)) * HASH_PRIME_1;
+    high^=word * HASH_PRIME_4;
+    high=((high << 27) | (high >> 37)) * HASH_PRIME_3;
+  }
+  hash->low=mix_hash_lane(low);
+  hash->high=mix_hash_lane(high ^ hash->low);
+  if (is_unknown_block_hash(hash)) hash->low=1;
+}
+
+static uint64_t mix_hash_lane(uint64_t lane) {
+  lane^=lane >> 33;
+  lane*=HASH_PRIME_2;
+  lane^=lane >> 29;
+  lane*=HASH_PRIME_3;
+  return lane ^ (lane >> 32);
+}
+
+static bool is_same_block_hash(struct upload_block_hash * first, struct upload_block_hash * second) {
+  return first->low == second->low && first->high == second->high;
+}
+
+static bool is_unknown_block_hash(struct upload_block_hash * hash) {
+  return hash->low == 0 && hash->high == 0;
+}
+
+static uint64_t write_instruction_range(struct transfer_queue * queue, int core_id, uint64_t data_address,
+      uint64_t start, char * data, uint64_t end) {
+  struct device_transfer_request request;
+  request.type=core_id == UPLOAD_CACHE_SHARED_SPACE ? LP_TRANSFER_WRITE_INSTRUCTIONS : LP_TRANSFER_WRITE_CORE_INSTRUCTIONS;
+  request.core_id=core_id;
+  request.core_mask=NULL;
+  request.address=start;
+  request.size=end - start;
+  request.buffer=&data[start - data_address];
+  request.tag=start;
+  submit_transfer(queue, &request);
+  return end - start;
+}
+
+static void write_core_set_instruction_range(struct transfer_queue * queue, uint64_t * core_mask, uint64_t data_address,
+      uint64_t start, char * data, uint64_t end) {
+  struct device_transfer_request request;
+  request.type=LP_TRANSFER_WRITE_CORE_SET_INSTRUCTIONS;
+  request.core_id=-1;
+  request.core_mask=core_mask;
+  request.address=start;
+  request.size=end - start;
+  request.buffer=&data[start - data_address];
+  request.tag=start;
+  submit_transfer(queue, &request);
+}
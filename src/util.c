@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <fcntl.h>
@@ -9,51 +10,75 @@
 #include "util.h"
 #include "launchpad_common.h"
 #include "configuration.h"
+#include "loader.h"
+#include "elf_loader.h"
+#include "driver_fallback.h"
+#include "board.h"
+#include "telemetry.h"
+#include "device_lock.h"
+#include "file_proxy.h"
 
-static void load_executable_file(struct launchpad_configuration*, char**, uint64_t*);
-static bool are_all_cores_active(struct launchpad_configuration*, struct device_configuration*);
+static void open_executable_file(struct launchpad_configuration*, struct load_stream*);
 static char* parse_seconds_to_days(uint64_t, char*);
 
 void generate_device_configuration(struct device_configuration* device_config, struct device_drivers * active_device_drivers, char * target) {
   struct host_board_status board_status;
-  check_device_status(active_device_drivers->device_get_host_board_status(&board_status));
+  lock_device_board_status();
+  LP_STATUS_CODE status=active_device_drivers->device_get_host_board_status(&board_status);
+  unlock_device_board_status();
+  check_device_status(status);
 
-  sprintf(target, "Device: '%s', version %x revision %d\n", device_config->device_name, device_config->version, device_config->revision);
-  sprintf(target, "%sCPU configuration: %d cores of %s\n", target, device_config->number_cores, device_config->cpu_name);
+  int length=sprintf(target, "Device: '%s', version %x revision %d\n", device_config->device_name, device_config->version, device_config->revision);
+  length+=sprintf(&target[length], "CPU configuration: %d cores of %s\n", device_config->number_cores, device_config->cpu_name);
+  if (get_number_boards() > 1) {
+    length+=sprintf(&target[length], "Boards: %d, cores numbered from", get_number_boards());
+    for (int i=0;i<get_number_boards();i++) length+=sprintf(&target[length], " %d", get_board_first_core(i));
+    length+=sprintf(&target[length], "\n");
+  }
   if (device_config->architecture_type == LP_ARCH_TYPE_SHARED_NOTHING) {
-    sprintf(target,"%sArchitecture type: Split instruction memory, split data memory\n", target);
+    length+=sprintf(&target[length], "Architecture type: Split instruction memory, split data memory\n");
   } else if (device_config->architecture_type == LP_ARCH_TYPE_SHARED_INSTR_ONLY) {
-    sprintf(target,"%sArchitecture type: Shared instruction memory, split data memory\n", target);
+    length+=sprintf(&target[length], "Architecture type: Shared instruction memory, split data memory\n");
   } else if (device_config->architecture_type == LP_ARCH_TYPE_SHARED_DATA_ONLY) {
-    sprintf(target,"%sArchitecture type: Split instruction memory, shared data memory\n", target);
+    length+=sprintf(&target[length], "Architecture type: Split instruction memory, shared data memory\n");
   } else if (device_config->architecture_type == LP_ARCH_TYPE_SHARED_EVERYTHING) {
-    sprintf(target,"%sArchitecture type: Shared instruction memory, shared data memory\n", target);
+    length+=sprintf(&target[length], "Architecture type: Shared instruction memory, shared data memory\n");
   }
-  sprintf(target, "%sClock frequency: %dMHz\n", target, device_config->clock_frequency_mhz);
-  sprintf(target, "%sPCIe control BAR window: %d\n", target, device_config->pcie_bar_ctrl_window_index);
-  sprintf(target, "%sMemory configuration: %dMB instruction, %dMB data per core, %dKB shared data\n", target, device_config->instruction_space_size_mb,
+  length+=sprintf(&target[length], "Clock frequency: %dMHz\n", device_config->clock_frequency_mhz);
+  length+=sprintf(&target[length], "PCIe control BAR window: %d\n", device_config->pcie_bar_ctrl_window_index);
+  length+=sprintf(&target[length], "Memory configuration: %dMB instruction, %dMB data per core, %dKB shared data\n", device_config->instruction_space_size_mb,
     device_config->per_core_data_space_mb, device_config->shared_data_space_kb);
 
-  bool ddr_inuse[2]={false, false};
+  int num_banks=2;
+  for (int i=0;i<device_config->number_cores;i++) {
+    if (device_config->ddr_bank_mapping[i] >= num_banks) num_banks=device_config->ddr_bank_mapping[i]+1;
+  }
+  bool ddr_inuse[num_banks];
+  for (int i=0;i<num_banks;i++) ddr_inuse[i]=false;
   for (int i=0;i<device_config->number_cores;i++) {
     ddr_inuse[device_config->ddr_bank_mapping[i]]=true;
   }
 
-  sprintf(target, "%s\nDDR bank 0 in use: %s, DDR bank 1 in use: %s\n", target, ddr_inuse[0] ? "yes" : "no", ddr_inuse[1] ? "yes" : "no");
+  length+=sprintf(&target[length], "\n");
+  for (int i=0;i<num_banks;i++) {
+    length+=sprintf(&target[length], "DDR bank %d in use: %s%s", i, ddr_inuse[i] ? "yes" : "no", i == num_banks-1 ? "\n" : ", ");
+  }
 
   for (int i=0;i<device_config->number_cores;i++) {
-    sprintf(target, "%sCore %d: DDR bank %d, host-side base data address 0x%lx\n", target, i, device_config->ddr_bank_mapping[i], device_config->ddr_base_addr_mapping[i]);
+    char core_name[BOARD_CORE_NAME_SIZE];
+    describe_core(i, core_name);
+    length+=sprintf(&target[length], "Core %s: DDR bank %d, host-side base data address 0x%lx\n", core_name, device_config->ddr_bank_mapping[i], device_config->ddr_base_addr_mapping[i]);
   }
   if (board_status.board_type == LP_PA100) {
-    sprintf(target, "%s\nHost FPGA board type is PA100, serial number %d\n", target, board_status.board_serial_number);
+    length+=sprintf(&target[length], "\nHost FPGA board type is PA100, serial number %d\n", board_status.board_serial_number);
   } else if (board_status.board_type == LP_PA101) {
-    sprintf(target, "%s\nHost FPGA board type is PA101, serial number %d\n", target, board_status.board_serial_number);
+    length+=sprintf(&target[length], "\nHost FPGA board type is PA101, serial number %d\n", board_status.board_serial_number);
   } else {
-    sprintf(target, "%s\nHost FPGA board type is unknown, serial number %d\n", target, board_status.board_serial_number);
+    length+=sprintf(&target[length], "\nHost FPGA board type is unknown, serial number %d\n", board_status.board_serial_number);
   }
-  sprintf(target, "%sFPGA temperature %.2f C, power draw %.2f Watts\n", target, board_status.temp, board_status.power_draw);
+  length+=sprintf(&target[length], "FPGA temperature %.2f C, power draw %.2f Watts\n", board_status.temp, board_status.power_draw);
   char display_buffer[512];
-  sprintf(target, "%sFPGA has had %ld power cycles, with a total alive time of %s\n", target, board_status.num_power_cycles, parse_seconds_to_days(board_status.time_alive_sec, display_buffer));
+  sprintf(&target[length], "FPGA has had %ld power cycles, with a total alive time of %s\n", board_status.num_power_cycles, parse_seconds_to_days(board_status.time_alive_sec, display_buffer));
 }
 
 static char* parse_seconds_to_days(uint64_t seconds, char * buffer) {
@@ -77,23 +102,24 @@ static char* parse_seconds_to_days(uint64_t seconds, char * buffer) {
 }
 
 void transfer_executable_to_device(struct launchpad_configuration * config, struct device_configuration * device_config, struct device_drivers * active_device_drivers) {
-  char * executable_bytes;
-  uint64_t code_size;
-  load_executable_file(config, &executable_bytes, &code_size);
-  if (device_config->architecture_type == LP_ARCH_TYPE_SHARED_NOTHING || device_config->architecture_type == LP_ARCH_TYPE_SHARED_DATA_ONLY) {
-    for (int i=0;i<device_config->number_cores;i++) {
-      if (config->active_cores[i]) {
-        check_device_status(active_device_drivers->device_write_core_instructions(i, 0x0, executable_bytes, code_size));
-      }
-    }
+  struct load_stream stream;
+  open_executable_file(config, &stream);
+  int * cores=(int*) malloc(sizeof(int) * device_config->number_cores);
+  int num_cores=get_cores_in_set(&config->active_cores, cores);
+  reset_load_statistics();
+  if (is_elf_file(&stream)) {
+    // ELF executables have only their loadable segments transferred, each to its target address
+    transfer_elf_to_device(config, device_config, active_device_drivers, &stream, cores, num_cores);
   } else {
-    // Otherwise there is a shared instruction space
-    check_device_status(active_device_drivers->device_write_instructions(0x0, executable_bytes, code_size));
+    // Otherwise this is a flat binary which is placed at the start of instruction memory
+    set_load_stream_target(&stream, device_config, true, cores, num_cores);
+    stream_to_device(device_config, active_device_drivers, &stream);
   }
-  free(executable_bytes);
+  free(cores);
+  close(stream.file_handle);
 }
 
-static void load_executable_file(struct launchpad_configuration * config, char **exec_buffer, uint64_t * code_size) {
+static void open_executable_file(struct launchpad_configuration * config, struct load_stream * stream) {
   int handle=open(config->executable_filename, O_RDONLY);
   if (handle == -1) {
     fprintf(stderr, "Error opening executable file '%s', check it exists\n", config->executable_filename);
@@ -106,48 +132,26 @@ static void load_executable_file(struct launchpad_configuration * config, char *
     close(handle);
     exit(-1);
   }
-
-  *code_size = (uint64_t) st.st_size;
-  *exec_buffer=(char*) malloc(*code_size);
-  err=read(handle, *exec_buffer, *code_size);
-  if (err == -1) {
-    fprintf(stderr, "Error reading executable file '%s'\n", config->executable_filename);
-    close(handle);
-    exit(-1);
-  }
-  close(handle);
+  memset(stream, 0, sizeof(struct load_stream));
+  stream->file_handle=handle;
+  stream->filename=config->executable_filename;
+  stream->length=(uint64_t) st.st_size;
+  stream->device_address=0x0;
 }
 
+/**
+ * Starts every active core with a single core set call, so they begin executing together rather than staggered by a
+ * call per core
+ */
 int start_cores(struct launchpad_configuration * config, struct device_configuration * device_config,
                           struct device_drivers * active_device_drivers, struct current_device_status * device_status) {
-  if (are_all_cores_active(config, device_config)) {
-    check_device_status(active_device_drivers->device_start_allcores());
-    for (int i=0;i<device_config->number_cores;i++) device_status->cores_active[i]=true;
-    device_status->running=true;
-    return device_config->number_cores;
-  } else {
-    int num_active=0;
-    for (int i=0;i<device_config->number_cores;i++) {
-      if (config->active_cores[i]) {
-        check_device_status(active_device_drivers->device_start_core(i));
-        device_status->cores_active[i]=true;
-        num_active++;
-      } else {
-        device_status->cores_active[i]=false;
-      }
-    }
-    device_status->running=true;
-    return num_active;
-  }
-}
-
-static bool are_all_cores_active(struct launchpad_configuration * config, struct device_configuration * device_config) {
-  for (int i=0;i<device_config->number_cores;i++) {
-    if (!config->active_cores[i]) {
-      return false;
-    }
-  }
-  return true;
+  copy_core_set(&device_status->cores_active, &config->active_cores);
+  close_file_proxy_files(&config->active_cores);
+  // The set's words are laid out as a driver core mask
+  check_device_status(driver_start_core_set(active_device_drivers, config->active_cores.words, device_config->number_cores));
+  begin_energy_run();
+  device_status->running=true;
+  return count_cores_in_set(&config->active_cores);
 }
 
 void check_device_status(LP_STATUS_CODE status_code) {